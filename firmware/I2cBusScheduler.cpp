@@ -0,0 +1,137 @@
+/* Particle I2cMaster Library
+ * Copyright (C) 2016 by William Greiman
+ *
+ * This file is part of the Particle I2cMaster Library
+ *
+ * This Library is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This Library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with the Particle I2cMaster Library.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+#include "application.h"
+#include "I2cBusScheduler.h"
+
+bool I2cBusScheduler::before(const I2cTransaction* a,
+                             const I2cTransaction* b) const {
+  if (m_policy == EARLIEST_DEADLINE && (a->deadlineMicros || b->deadlineMicros)) {
+    if (!b->deadlineMicros) {
+      return true;
+    }
+    if (!a->deadlineMicros) {
+      return false;
+    }
+    if (a->deadline != b->deadline) {
+      return (int32_t)(a->deadline - b->deadline) < 0;
+    }
+  }
+  if (a->priority != b->priority) {
+    return a->priority > b->priority;
+  }
+  return (int32_t)(a->seq - b->seq) < 0;
+}
+
+bool I2cBusScheduler::poll() {
+  uint32_t primask = __get_PRIMASK();
+  __disable_irq();
+  if (m_count == 0) {
+    __set_PRIMASK(primask);
+    return false;
+  }
+  size_t best = 0;
+  for (size_t i = 1; i < m_count; i++) {
+    if (before(m_queue[i], m_queue[best])) {
+      best = i;
+    }
+  }
+  I2cTransaction* t = m_queue[best];
+  __set_PRIMASK(primask);
+
+  size_t n = t->count - t->done;
+  if (t->chunkSize && n > t->chunkSize) {
+    n = t->chunkSize;
+  }
+  int rtn = runChunk(t, n);
+  if (rtn == 0 || rtn > (int)n) {
+    // Zero would never finish and too many would overrun buf.
+    rtn = CHUNK_ERROR;
+  }
+  if (rtn < 0) {
+    t->rtn = rtn;
+  } else {
+    t->done += rtn;
+    t->rtn = t->done;
+  }
+  if (rtn >= 0 && t->done < t->count) {
+    return true;
+  }
+  t->missed = t->deadlineMicros && (int32_t)(micros() - t->deadline) > 0;
+  if (t->missed) {
+    m_misses++;
+  }
+  primask = __get_PRIMASK();
+  __disable_irq();
+  /* Only poll() removes transactions so best is still valid. */
+  m_queue[best] = m_queue[--m_count];
+  t->state = I2cTransaction::DONE;
+  __set_PRIMASK(primask);
+  return true;
+}
+
+int I2cBusScheduler::runChunk(I2cTransaction* t, size_t n) {
+  uint8_t* buf = (uint8_t*)t->buf + t->done;
+  if (t->chunkFunction) {
+    return t->chunkFunction(m_i2c, t, t->done, n);
+  }
+  uint16_t memAddress = t->memAddress + t->done;
+  uint8_t mem[2];
+  if (t->memAddressSize == 2) {
+    mem[0] = memAddress >> 8;
+    mem[1] = memAddress;
+  } else {
+    mem[0] = memAddress;
+  }
+  bool ok;
+  if (t->read) {
+    ok = t->memAddressSize ?
+         m_i2c->transfer(t->address, mem, t->memAddressSize, buf, n) :
+         m_i2c->read(t->address, buf, n);
+  } else if (t->memAddressSize) {
+    i2c_segment seg[2] = {{t->address, 0, mem, t->memAddressSize},
+                          {t->address, I2C_SEG_NOSTART, buf, n}};
+    ok = m_i2c->transfer(seg, 2);
+  } else {
+    ok = m_i2c->write(t->address, buf, n);
+  }
+  return ok ? (int)n : m_i2c->rtn();
+}
+
+bool I2cBusScheduler::submit(I2cTransaction* t) {
+  if (!t || t->count == 0 || t->memAddressSize > 2 ||
+      t->state == I2cTransaction::QUEUED) {
+    return false;
+  }
+  uint32_t primask = __get_PRIMASK();
+  __disable_irq();
+  if (m_count == I2C_BUS_SCHED_MAX) {
+    __set_PRIMASK(primask);
+    return false;
+  }
+  t->state = I2cTransaction::QUEUED;
+  t->missed = false;
+  t->rtn = 0;
+  t->done = 0;
+  t->deadline = micros() + t->deadlineMicros;
+  t->seq = m_seq++;
+  m_queue[m_count++] = t;
+  __set_PRIMASK(primask);
+  return true;
+}
\ No newline at end of file
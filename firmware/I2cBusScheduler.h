@@ -0,0 +1,172 @@
+/* Particle I2cMaster Library
+ * Copyright (C) 2016 by William Greiman
+ *
+ * This file is part of the Particle I2cMaster Library
+ *
+ * This Library is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This Library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with the Particle I2cMaster Library.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+#ifndef I2cBusScheduler_h
+#define I2cBusScheduler_h
+#include "I2cMaster.h"
+
+#ifndef I2C_BUS_SCHED_MAX
+/** Maximum number of queued transactions in an I2cBusScheduler. */
+#define I2C_BUS_SCHED_MAX 8
+#endif  // I2C_BUS_SCHED_MAX
+
+struct I2cTransaction;
+
+/** Function to run one chunk of a transaction that needs device specific
+ *  setup for each chunk, for example selecting a memory bank.
+ *
+ * @param[in] i2c The bus.
+ * @param[in] t The transaction.
+ * @param[in] offset Offset of the chunk in t->buf.
+ * @param[in] count Number of bytes in the chunk.
+ *
+ * A short chunk is continued from the first byte not transferred.  A
+ * return of zero or more than count ends the transaction with
+ * I2cBusScheduler::CHUNK_ERROR.
+ *
+ * @returns Number of bytes transferred or a negative error code.
+ */
+typedef int (*I2cChunkFunction)(I2cMaster* i2c, I2cTransaction* t,
+                                size_t offset, size_t count);
+
+/**
+ * @struct I2cTransaction
+ * @brief A read or write run by I2cBusScheduler.
+ *
+ * Long transfers are split into chunks of chunkSize bytes.  Each chunk is
+ * a separate bus transfer so higher priority transactions can run between
+ * chunks.  If memAddressSize is nonzero, the memory address of the chunk is
+ * sent before the chunk so chunks of a memory or auto-increment register
+ * transfer are independent.
+ */
+struct I2cTransaction {
+  I2cTransaction() : address(0), read(false), memAddressSize(0), priority(0),
+    memAddress(0), buf(0), count(0), chunkSize(0), deadlineMicros(0),
+    chunkFunction(0), arg(0), state(0), missed(false), rtn(0), done(0),
+    deadline(0), seq(0) {}
+
+  /** Check for transaction done.  Result is in rtn. */
+  bool isDone() const {return state == DONE;}
+
+  /** Right justified 7-bit address. */
+  uint8_t address;
+  /** true for a read, false for a write. */
+  bool read;
+  /** Number of memory address bytes sent before each chunk, zero to two. */
+  uint8_t memAddressSize;
+  /** Higher priority transactions run first. */
+  uint8_t priority;
+  /** Memory or register address of buf[0]. */
+  uint16_t memAddress;
+  /** Data to send or buffer for read data. */
+  void* buf;
+  /** Number of bytes to transfer. */
+  size_t count;
+  /** Maximum bytes per bus transfer.  Zero for a single transfer. */
+  size_t chunkSize;
+  /** Deadline in microseconds after submit().  Zero for no deadline. */
+  uint32_t deadlineMicros;
+  /** Optional function to run each chunk. */
+  I2cChunkFunction chunkFunction;
+  /** Application data for chunkFunction. */
+  void* arg;
+
+  // Set by I2cBusScheduler.
+  static const uint8_t QUEUED = 1;
+  static const uint8_t DONE = 2;
+  /** Queued or done. */
+  volatile uint8_t state;
+  /** true if the transaction finished after its deadline. */
+  bool missed;
+  /** Bytes transferred or a negative error code. */
+  int rtn;
+  /** Bytes transferred so far. */
+  size_t done;
+  /** Absolute deadline. */
+  uint32_t deadline;
+  /** Submit order. */
+  uint32_t seq;
+};
+/**
+ * @class I2cBusScheduler
+ * @brief Runs transactions on a bus in priority or deadline order.
+ *
+ * Transactions are owned by the caller and must not change until done.
+ * submit() may be called from an interrupt.  poll() runs one chunk with
+ * polled I/O so a long write only delays an urgent read by one chunk.
+ */
+class I2cBusScheduler {
+ public:
+  /** Highest priority first.  Equal priority in submit order. */
+  static const uint8_t FIXED_PRIORITY = 0;
+  /** Earliest deadline first.  Transactions without a deadline run last
+   *  in priority order.
+   */
+  static const uint8_t EARLIEST_DEADLINE = 1;
+  /** rtn for a chunk function that made no progress or returned more
+   *  than the chunk size.
+   */
+  static const int CHUNK_ERROR = -1;
+
+  /** Create a scheduler for a bus.
+   *
+   * @param[in] i2c The bus.
+   * @param[in] policy FIXED_PRIORITY or EARLIEST_DEADLINE.
+   */
+  explicit I2cBusScheduler(I2cMaster* i2c, uint8_t policy = FIXED_PRIORITY)
+    : m_i2c(i2c), m_policy(policy), m_count(0), m_seq(0), m_misses(0) {}
+
+  /** @returns Number of transactions that finished after their deadline. */
+  uint32_t misses() const {return m_misses;}
+
+  /** @returns Number of queued transactions. */
+  size_t pending() const {return m_count;}
+
+  /** Run one chunk of the most urgent transaction.
+   *
+   * @returns true if a chunk was run, false if the queue is empty.
+   */
+  bool poll();
+
+  /** Run transactions until the queue is empty. */
+  void run() {
+    while (poll()) {}
+  }
+
+  /** Queue a transaction.
+   *
+   * @param[in] t The transaction.
+   *
+   * @returns true for success else false if the queue is full, the
+   *          transaction is queued or arguments are invalid.
+   */
+  bool submit(I2cTransaction* t);
+
+ private:
+  bool before(const I2cTransaction* a, const I2cTransaction* b) const;
+  int runChunk(I2cTransaction* t, size_t n);
+
+  I2cMaster* m_i2c;
+  uint8_t m_policy;
+  I2cTransaction* m_queue[I2C_BUS_SCHED_MAX];
+  volatile size_t m_count;
+  uint32_t m_seq;
+  uint32_t m_misses;
+};
+#endif  // I2cBusScheduler_h
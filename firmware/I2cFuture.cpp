@@ -0,0 +1,229 @@
+/* Particle I2cMaster Library
+ * Copyright (C) 2016 by William Greiman
+ *
+ * This file is part of the Particle I2cMaster Library
+ *
+ * This Library is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This Library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with the Particle I2cMaster Library.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+#include "application.h"
+#include "I2cFuture.h"
+
+// Number of interfaces with a request queue.
+#if PLATFORM_ID == 10
+const size_t ASYNC_IF_COUNT = 3;
+#else  // PLATFORM_ID == 10
+const size_t ASYNC_IF_COUNT = 1;
+#endif  // PLATFORM_ID == 10
+
+// Request state.
+const uint8_t REQ_QUEUED = 1;
+const uint8_t REQ_ACTIVE = 2;
+const uint8_t REQ_DONE = 3;
+
+// Returned for requests that are not done or have been reused.
+const int REQ_ERROR = -1;
+
+struct AsyncRequest {
+  void*    buf;
+  size_t   count;
+  uint8_t  address;
+  uint8_t  read;
+  uint8_t  stop;
+  volatile uint8_t  state;
+  volatile uint16_t seq;
+  volatile int      rtn;
+  uint32_t startMicros;
+};
+
+// Requests head to head + count - 1 are queued or active.
+struct AsyncQueue {
+  AsyncRequest req[I2C_ASYNC_QUEUE_SIZE];
+  uint8_t  head;
+  uint8_t  count;
+  uint16_t seq;
+  bool     callbackSet;
+};
+
+static AsyncQueue asyncQueue[ASYNC_IF_COUNT];
+//-----------------------------------------------------------------------------
+// Called with interrupts disabled.
+static void finishHead(AsyncQueue* q, int rtn) {
+  AsyncRequest* r = &q->req[q->head];
+  r->rtn = rtn;
+  r->state = REQ_DONE;
+  q->head = (q->head + 1) % I2C_ASYNC_QUEUE_SIZE;
+  q->count--;
+}
+//-----------------------------------------------------------------------------
+// Start the head request if it is queued and no transfer is active.
+// Requests that fail to start finish with the error.  The request is
+// claimed with interrupts disabled and started with them restored, so
+// the wait for a previous stop does not block interrupts.
+static void startHead(HAL_I2C_Interface i2cIf) {
+  AsyncQueue* q = &asyncQueue[i2cIf];
+  for (;;) {
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+    AsyncRequest* r = &q->req[q->head];
+    if (q->count == 0 || r->state != REQ_QUEUED || i2c_done(i2cIf) != 1) {
+      __set_PRIMASK(primask);
+      return;
+    }
+    /* The callback finishes an active request. */
+    r->state = REQ_ACTIVE;
+    r->startMicros = micros();
+    uint16_t seq = r->seq;
+    __set_PRIMASK(primask);
+
+    int rtn = r->read ?
+              i2c_start_read(i2cIf, r->address, r->buf, r->count, r->stop) :
+              i2c_start_write(i2cIf, r->address, r->buf, r->count, r->stop);
+    if (rtn >= 0) {
+      return;
+    }
+    primask = __get_PRIMASK();
+    __disable_irq();
+    if (r->seq == seq && r->state == REQ_ACTIVE) {
+      finishHead(q, rtn);
+    }
+    __set_PRIMASK(primask);
+  }
+}
+//-----------------------------------------------------------------------------
+// Called by the I2C interrupt when a transfer finishes.
+static void asyncCallback(HAL_I2C_Interface i2cIf, int rtn) {
+  if ((size_t)i2cIf >= ASYNC_IF_COUNT) {
+    return;
+  }
+  AsyncQueue* q = &asyncQueue[i2cIf];
+  /* Transfers started by I2cMaster::startRead/startWrite leave the head
+     queued.  It starts after them. */
+  if (q->count && q->req[q->head].state == REQ_ACTIVE) {
+    finishHead(q, rtn);
+  }
+  /* Don't wait in the interrupt for a stop.  pollQueue() starts the next. */
+  if (i2c_stop_pending(i2cIf) == 0) {
+    startHead(i2cIf);
+  }
+}
+//-----------------------------------------------------------------------------
+// Start a request left queued by the callback or finish a hung transfer.
+static void pollQueue(HAL_I2C_Interface i2cIf) {
+  /* Aborts a transfer that has run past its timeout. */
+  if (i2c_done(i2cIf) == 1) {
+    startHead(i2cIf);
+  }
+}
+//-----------------------------------------------------------------------------
+I2cFuture I2cFuture::queue(HAL_I2C_Interface i2cIf, uint8_t address,
+                           bool read, void* buf, size_t count, bool stop) {
+  if ((size_t)i2cIf >= ASYNC_IF_COUNT) {
+    return I2cFuture();
+  }
+  AsyncQueue* q = &asyncQueue[i2cIf];
+  if (!q->callbackSet) {
+    if (i2c_set_callback(i2cIf, asyncCallback) < 0) {
+      return I2cFuture();
+    }
+    q->callbackSet = true;
+  }
+  uint32_t primask = __get_PRIMASK();
+  __disable_irq();
+  if (q->count == I2C_ASYNC_QUEUE_SIZE) {
+    __set_PRIMASK(primask);
+    /* Start a head left for a stop so a caller that retries makes progress. */
+    startHead(i2cIf);
+    return I2cFuture();
+  }
+  uint8_t slot = (q->head + q->count) % I2C_ASYNC_QUEUE_SIZE;
+  AsyncRequest* r = &q->req[slot];
+  /* Zero marks an invalid future */
+  if (++q->seq == 0) {
+    q->seq = 1;
+  }
+  r->buf = buf;
+  r->count = count;
+  r->address = address;
+  r->read = read;
+  r->stop = stop;
+  r->rtn = REQ_ERROR;
+  r->seq = q->seq;
+  r->state = REQ_QUEUED;
+  q->count++;
+  uint16_t seq = r->seq;
+  __set_PRIMASK(primask);
+  startHead(i2cIf);
+  return I2cFuture(i2cIf, slot, seq);
+}
+//-----------------------------------------------------------------------------
+bool I2cFuture::ready() const {
+  if (!valid()) {
+    return true;
+  }
+  const AsyncRequest* r = &asyncQueue[m_i2cIf].req[m_slot];
+  if (r->seq == m_seq && r->state != REQ_DONE) {
+    pollQueue(m_i2cIf);
+  }
+  return r->seq != m_seq || r->state == REQ_DONE;
+}
+//-----------------------------------------------------------------------------
+int I2cFuture::result() const {
+  if (!valid()) {
+    return REQ_ERROR;
+  }
+  const AsyncRequest* r = &asyncQueue[m_i2cIf].req[m_slot];
+  uint32_t primask = __get_PRIMASK();
+  __disable_irq();
+  int rtn = r->seq == m_seq && r->state == REQ_DONE ? r->rtn : REQ_ERROR;
+  __set_PRIMASK(primask);
+  return rtn;
+}
+//-----------------------------------------------------------------------------
+bool I2cFuture::startMicros(uint32_t* micros) const {
+  if (!valid()) {
+    return false;
+  }
+  const AsyncRequest* r = &asyncQueue[m_i2cIf].req[m_slot];
+  uint32_t primask = __get_PRIMASK();
+  __disable_irq();
+  bool started = r->seq == m_seq && r->state != REQ_QUEUED;
+  if (started) {
+    *micros = r->startMicros;
+  }
+  __set_PRIMASK(primask);
+  return started;
+}
+//-----------------------------------------------------------------------------
+bool I2cFuture::wait(uint32_t timeoutMicros) {
+  uint32_t m = micros();
+  while (!ready()) {
+    if ((micros() - m) > timeoutMicros) {
+      break;
+    }
+  }
+  if (!ready()) {
+    AsyncRequest* r = &asyncQueue[m_i2cIf].req[m_slot];
+    if (r->state != REQ_ACTIVE) {
+      return false;
+    }
+    /* The callback finishes the request and leaves the next queued. */
+    if (i2c_abort(m_i2cIf) == 1) {
+      /* Recovers the bus only if automatic recovery is enabled. */
+      i2c_wait(m_i2cIf);
+    }
+    pollQueue(m_i2cIf);
+  }
+  return result() >= 0;
+}
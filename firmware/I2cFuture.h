@@ -0,0 +1,101 @@
+/* Particle I2cMaster Library
+ * Copyright (C) 2016 by William Greiman
+ *
+ * This file is part of the Particle I2cMaster Library
+ *
+ * This Library is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This Library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with the Particle I2cMaster Library.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+#ifndef I2cFuture_h
+#define I2cFuture_h
+#include "application.h"
+#include "i2c_lld.h"
+
+#ifndef I2C_ASYNC_QUEUE_SIZE
+/** Number of requests in the asynchronous request queue of an interface. */
+#define I2C_ASYNC_QUEUE_SIZE 4
+#endif  // I2C_ASYNC_QUEUE_SIZE
+/**
+ * @class I2cFuture
+ * @brief Handle for a request started by I2cMaster::readAsync() or
+ *        I2cMaster::writeAsync().
+ *
+ * Requests are queued in a fixed size queue for each interface and run in
+ * order by the I2C interrupt.  A request that would wait in the interrupt
+ * for a stop condition is started by the next call to ready() or wait().
+ * No memory is allocated.  The result of a request is available until
+ * I2C_ASYNC_QUEUE_SIZE more requests have been queued.
+ *
+ * The first request on an interface installs the queue's callback with
+ * i2c_set_callback().  This replaces a callback set by the application.
+ * Do not call i2c_set_callback() after that, or active requests never
+ * finish.
+ */
+class I2cFuture {
+ public:
+  /** Create an invalid future. */
+  I2cFuture() : m_i2cIf(HAL_I2C_INTERFACE1), m_slot(0), m_seq(0) {}
+
+  /** Check for request done.
+   *
+   * @returns true if the request is done or the future is invalid.
+   */
+  bool ready() const;
+
+  /** Return the result of a request.
+   *
+   * @returns Number of bytes transferred or a negative error code if the
+   *          request failed, is not done, or the future is invalid.
+   */
+  int result() const;
+
+  /** Get the time the transfer of a request was started on the bus.
+   *
+   * @param[out] micros Value of micros() when the request was started.
+   *
+   * @returns false if the request has not started or the future is
+   *          invalid or reused.
+   */
+  bool startMicros(uint32_t* micros) const;
+
+  /** Check for a queued request.
+   *
+   * @returns false if the queue was full or arguments were invalid.
+   */
+  bool valid() const {return m_seq != 0;}
+
+  /** Wait for a request to finish.
+   *
+   * If the request is still in progress when the timeout expires, the
+   * transfer is aborted with i2c_abort().  The bus is recovered only if
+   * automatic recovery is enabled, see i2c_auto_recover().  Call
+   * I2cMaster::recoverBus() if a slave may still hold the bus.
+   *
+   * @param[in] timeoutMicros Maximum time to wait in microseconds.
+   *
+   * @returns true if the request is done and successful else false.
+   */
+  bool wait(uint32_t timeoutMicros = I2C_BUSY_TIMEOUT_MICROS);
+
+ private:
+  friend class I2cMaster;
+  I2cFuture(HAL_I2C_Interface i2cIf, uint8_t slot, uint16_t seq)
+    : m_i2cIf(i2cIf), m_slot(slot), m_seq(seq) {}
+  static I2cFuture queue(HAL_I2C_Interface i2cIf, uint8_t address,
+                         bool read, void* buf, size_t count, bool stop);
+  HAL_I2C_Interface m_i2cIf;
+  uint8_t m_slot;
+  uint16_t m_seq;
+};
+#endif  // I2cFuture_h
@@ -25,6 +25,11 @@ bool I2cMaster::begin(uint32_t hz) {
   return m_rtn >= 0;
 }
 
+bool I2cMaster::dmaWait() {
+  m_rtn = i2c_dma_wait(m_i2cIf);
+  return m_rtn >= 0;
+}
+
 bool I2cMaster::end() {
   m_rtn = i2c_end(m_i2cIf);
   return m_rtn >= 0;
@@ -35,16 +40,134 @@ bool I2cMaster::frequency(uint32_t hz) {
   return m_rtn >= 0;
 }
 
+bool I2cMaster::lock() {
+  m_rtn = i2c_lock(m_i2cIf);
+  return m_rtn >= 0;
+}
+
 bool I2cMaster::read(uint8_t address, void* buf, size_t count, bool stop) {
   m_rtn = i2c_read(m_i2cIf, address, buf, count, stop);
   return m_rtn >= 0;
 }
 
+I2cFuture I2cMaster::readAsync(uint8_t address, void* buf, size_t count, bool stop) {
+  return I2cFuture::queue(m_i2cIf, address, true, buf, count, stop);
+}
+
+bool I2cMaster::readDma(uint8_t address, void* buf, size_t count, bool stop) {
+  m_rtn = i2c_read_dma(m_i2cIf, address, buf, count, stop);
+  return m_rtn >= 0;
+}
+
+bool I2cMaster::recoverBus() {
+  m_rtn = i2c_recover(m_i2cIf);
+  return m_rtn >= 0;
+}
+
+bool I2cMaster::resetStats() {
+  m_rtn = i2c_reset_stats(m_i2cIf);
+  return m_rtn >= 0;
+}
+
+// The key covers the interface and the candidate list so a cache written
+// by one scan is not used for a scan of other addresses.
+static uint32_t scanKey(HAL_I2C_Interface i2cIf, const I2cScanOptions& options) {
+  uint32_t key = 0X5343414E ^ i2cIf;
+  if (options.candidates) {
+    key = (key << 5 | key >> 27) ^ options.count;
+    for (size_t i = 0; i < options.count; i++) {
+      key = (key << 5 | key >> 27) ^ options.candidates[i];
+    }
+  }
+  return key;
+}
+
+static uint32_t scanCheck(const I2cScanCache* cache) {
+  uint32_t check = cache->key;
+  for (size_t i = 0; i < sizeof(cache->bitmap); i++) {
+    check = (check << 5 | check >> 27) ^ cache->bitmap[i];
+  }
+  return ~check;
+}
+
+bool I2cMaster::scan(uint8_t bitmap[16], const I2cScanOptions& options) {
+  I2cScanCache* cache = options.cache;
+  uint32_t key = scanKey(m_i2cIf, options);
+  if (cache && !options.rescan &&
+      cache->key == key && cache->check == scanCheck(cache)) {
+    m_rtn = 0;
+    for (size_t i = 0; i < sizeof(cache->bitmap); i++) {
+      bitmap[i] = cache->bitmap[i];
+      m_rtn += __builtin_popcount(bitmap[i]);
+    }
+    return true;
+  }
+  m_rtn = i2c_scan(m_i2cIf, bitmap, options.candidates, options.count);
+  if (cache && m_rtn >= 0) {
+    cache->key = key;
+    memcpy(cache->bitmap, bitmap, sizeof(cache->bitmap));
+    cache->check = scanCheck(cache);
+  }
+  return m_rtn >= 0;
+}
+
+bool I2cMaster::setTimeout(uint32_t flagUs, uint32_t busyUs) {
+  m_rtn = i2c_timeout(m_i2cIf, flagUs, busyUs);
+  return m_rtn >= 0;
+}
+
+bool I2cMaster::startRead(uint8_t address, void* buf, size_t count, bool stop) {
+  m_rtn = i2c_start_read(m_i2cIf, address, buf, count, stop);
+  return m_rtn >= 0;
+}
+
+bool I2cMaster::startStream(uint8_t address, uint8_t reg,
+                            void* buf, size_t frameSize, size_t frameCount) {
+  m_rtn = i2c_stream_start(m_i2cIf, address, reg, buf, frameSize, frameCount);
+  return m_rtn >= 0;
+}
+
+bool I2cMaster::startWrite(uint8_t address, const void* buf, size_t count, bool stop) {
+  m_rtn = i2c_start_write(m_i2cIf, address, buf, count, stop);
+  return m_rtn >= 0;
+}
+
+bool I2cMaster::stats(i2c_stats* stats) {
+  m_rtn = i2c_get_stats(m_i2cIf, stats);
+  return m_rtn >= 0;
+}
+
 bool I2cMaster::stop() {
   m_rtn =  i2c_stop(m_i2cIf);
   return m_rtn >= 0;  
 }
 
+bool I2cMaster::stopStream() {
+  m_rtn = i2c_stream_stop(m_i2cIf);
+  return m_rtn >= 0;
+}
+
+bool I2cMaster::transfer(uint8_t address, const void* txBuf, size_t txCount,
+                         void* rxBuf, size_t rxCount, bool stop) {
+  m_rtn = i2c_write_read(m_i2cIf, address, txBuf, txCount, rxBuf, rxCount, stop);
+  return m_rtn >= 0;
+}
+
+bool I2cMaster::transfer(const i2c_segment* seg, size_t count, bool stop) {
+  m_rtn = i2c_transfer(m_i2cIf, seg, count, stop);
+  return m_rtn >= 0;
+}
+
+bool I2cMaster::unlock() {
+  m_rtn = i2c_unlock(m_i2cIf);
+  return m_rtn >= 0;
+}
+
+bool I2cMaster::wait() {
+  m_rtn = i2c_wait(m_i2cIf);
+  return m_rtn >= 0;
+}
+
 bool I2cMaster::write(uint8_t data, bool stop) {
   m_rtn =  i2c_write_data(m_i2cIf, &data, 1, stop);
   return m_rtn >= 0;
@@ -58,4 +181,13 @@ bool I2cMaster::write(const void* buf, size_t count, bool stop) {
 bool I2cMaster::write(uint8_t address, const void* buf, size_t count, bool stop) {
   m_rtn = i2c_write(m_i2cIf, address, buf, count, stop);
   return m_rtn >= 0;
+}
+
+I2cFuture I2cMaster::writeAsync(uint8_t address, const void* buf, size_t count, bool stop) {
+  return I2cFuture::queue(m_i2cIf, address, false, (void*)buf, count, stop);
+}
+
+bool I2cMaster::writeDma(uint8_t address, const void* buf, size_t count, bool stop) {
+  m_rtn = i2c_write_dma(m_i2cIf, address, buf, count, stop);
+  return m_rtn >= 0;
 }
\ No newline at end of file
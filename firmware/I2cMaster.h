@@ -21,10 +21,48 @@
 #define I2cMaster_h
 #include "application.h"
 #include "i2c_lld.h"
+#include "I2cFuture.h"
 #include "WireMaster.h"
+/**
+ * @struct I2cScanCache
+ * @brief Result of the last scan.
+ *
+ * Declare with the retained keyword and enable FEATURE_RETAINED_MEMORY
+ * so a warm boot can skip the scan.
+ */
+struct I2cScanCache {
+  /** Marks a valid cache for one interface and candidate list. */
+  uint32_t key;
+  /** Presence bitmap.  See i2c_scan(). */
+  uint8_t bitmap[16];
+  /** Check value for key and bitmap. */
+  uint32_t check;
+};
+/**
+ * @struct I2cScanOptions
+ * @brief Options for I2cMaster::scan().
+ */
+struct I2cScanOptions {
+  I2cScanOptions() : candidates(nullptr), count(0),
+                     cache(nullptr), rescan(false) {}
+  /** Addresses to probe.  If nullptr, probe all addresses not reserved. */
+  const uint8_t* candidates;
+  /** Number of candidates. */
+  size_t count;
+  /** If not nullptr, a valid cache is used instead of the bus and
+   *  the cache is updated after a successful scan. */
+  I2cScanCache* cache;
+  /** Scan the bus even if the cache is valid. */
+  bool rescan;
+};
 /**
  * @class I2cMaster
  * @brief I2C polled master class.
+ *
+ * The interface is selected at run time.  See I2cMasterT in I2cMasterT.h
+ * for an interface selected at compile time.  Polled transfers run the
+ * same register sequence as I2cMasterT, through the low level driver so
+ * they are recorded in statistics and the trace buffer.
  */
 class I2cMaster {
  public:
@@ -43,6 +81,26 @@ class I2cMaster {
    */
   bool begin(uint32_t hz = 100000);
 
+  /** Enable or disable automatic bus recovery after a timeout or bus error.
+   *
+   * @param[in] enable true to enable automatic recovery.
+   *
+   * @returns true for success else false.
+   */
+  bool autoRecover(bool enable) {return i2c_auto_recover(m_i2cIf, enable) >= 0;}
+
+  /** Check for DMA transfer done.
+   *
+   * @returns true if dmaWait() will not block for data else false.
+   */
+  bool dmaDone() {return i2c_dma_done(m_i2cIf) != 0;}
+
+  /** Wait for a DMA transfer started by readDma() or writeDma() to finish.
+   *
+   * @returns true for success else false.
+   */
+  bool dmaWait();
+
   /** Disable the I2C interface.
    *
    * @returns true for success else false.
@@ -56,6 +114,43 @@ class I2cMaster {
    * @returns true for success else false.
    */
   bool frequency(uint32_t hz);
+
+  /** Lock the bus.  See i2c_lock().
+   *
+   * Hold the lock across sequences of calls, for example a write without
+   * stop followed by a read.  Not recursive.  See I2cBusGuard.
+   *
+   * @returns true for success else false.
+   */
+  bool lock();
+
+  /** Lock the bus, giving up after a timeout.  See i2c_lock_timeout().
+   *
+   * @param[in] ms Maximum wait in milliseconds.
+   *
+   * @returns true for success else false.
+   */
+  bool lock(uint32_t ms) {
+    m_rtn = i2c_lock_timeout(m_i2cIf, ms);
+    return m_rtn >= 0;
+  }
+
+  /** Get bus lock statistics.
+   *
+   * @param[out] stats Location for statistics.
+   *
+   * @returns true for success else false.
+   */
+  bool lockStats(i2c_lock_stats* stats) {
+    return i2c_get_lock_stats(m_i2cIf, stats) >= 0;
+  }
+
+  /** Check for interrupt driven transfer done.
+   *
+   * @returns true if the transfer started by startRead() or startWrite()
+   *          is done else false.
+   */
+  bool isDone() {return i2c_done(m_i2cIf) != 0;}
   
   /** Read from an I2C slave
    *
@@ -68,18 +163,165 @@ class I2cMaster {
    */
   bool read(uint8_t address, void* buf, size_t count, bool stop = true);
 
+  /** Queue an interrupt driven read from an I2C slave.
+   *
+   * The read starts when earlier queued requests and a transfer started
+   * by startRead() or startWrite() finish.  The queue replaces a callback
+   * set with i2c_set_callback().  See I2cFuture.
+   *
+   * @param[in] address Right justified 7-bit address.
+   * @param[out] buf Buffer for read data.
+   * @param[in] count Number of bytes to read.
+   * @param[in] stop Generate stop if true.
+   *
+   * @returns Handle for the request.  Check valid() for a full queue.
+   */
+  I2cFuture readAsync(uint8_t address, void* buf, size_t count, bool stop = true);
+
+  /** Start a DMA read from an I2C slave.  Call dmaWait() to finish.
+   *
+   * @param[in] address Right justified 7-bit address.
+   * @param[out] buf Buffer for read data.
+   * @param[in] count Number of bytes to read.
+   * @param[in] stop Generate stop if true.
+   *
+   * @returns true for success else false.
+   */
+  bool readDma(uint8_t address, void* buf, size_t count, bool stop = true);
+
+  /** Recover a bus held low by a slave.  Hold the bus lock if other
+   * threads use the bus.  See i2c_recover().
+   *
+   * @returns true for success else false.
+   */
+  bool recoverBus();
+
+  /** Get bus recovery counts.
+   *
+   * @param[out] recoveries Number of successful recoveries.  May be NULL.
+   * @param[out] failures Number of failed recoveries.  May be NULL.
+   *
+   * @returns true for success else false.
+   */
+  bool recoverCounts(uint32_t* recoveries, uint32_t* failures) {
+    return i2c_recover_counts(m_i2cIf, recoveries, failures) >= 0;
+  }
+
   /** Return low level driver info.
    *
    * @returns See low level driver.
    */
   int rtn() {return m_rtn;}
 
+  /** Find devices on the bus.  See i2c_scan().
+   *
+   * rtn() returns the number of devices found.
+   *
+   * @param[out] bitmap Presence bitmap.
+   * @param[in] options Candidate list and scan cache.
+   *
+   * @returns true for success else false.
+   */
+  bool scan(uint8_t bitmap[16], const I2cScanOptions& options = I2cScanOptions());
+
+  /** Remove the oldest frame from the stream ring buffer.
+   *
+   * @param[out] frame Location for frameSize bytes.
+   *
+   * @returns true if a frame was copied else false.
+   */
+  bool popFrame(void* frame) {return i2c_stream_pop(m_i2cIf, frame) == 1;}
+
+  /** Start an interrupt driven read from an I2C slave.
+   *
+   * @param[in] address Right justified 7-bit address.
+   * @param[out] buf Buffer for read data.
+   * @param[in] count Number of bytes to read.
+   * @param[in] stop Generate stop if true.
+   *
+   * @returns true for success else false.
+   */
+  bool startRead(uint8_t address, void* buf, size_t count, bool stop = true);
+
+  /** Start streaming register reads into a ring buffer.
+   *  See i2c_stream_start().
+   *
+   * @param[in] address Right justified 7-bit address.
+   * @param[in] reg Register written before each frame.
+   * @param[in] buf Ring buffer of frameSize*frameCount bytes.
+   * @param[in] frameSize Number of bytes in a frame.
+   * @param[in] frameCount Number of frames.  Must be a power of two.
+   *
+   * @returns true for success else false.
+   */
+  bool startStream(uint8_t address, uint8_t reg,
+                   void* buf, size_t frameSize, size_t frameCount);
+
+  /** Start an interrupt driven write to an I2C slave.
+   *
+   * @param[in] address Right justified 7-bit address.
+   * @param[in] buf Data to send.
+   * @param[in] count Number of bytes to send.
+   * @param[in] stop Generate stop if true.
+   *
+   * @returns true for success else false.
+   */
+  bool startWrite(uint8_t address, const void* buf, size_t count, bool stop = true);
+
+  /** Clear statistics.
+   *
+   * @returns true for success else false.
+   */
+  bool resetStats();
+
+  /** Set timeouts.
+   *
+   * @param[in] flagUs Time to wait for a bus event in microseconds.
+   *                   Zero selects I2C_FLAG_TIMEOUT_MICROS.
+   * @param[in] busyUs Time to wait for the bus to be free in microseconds.
+   *                   Zero selects I2C_BUSY_TIMEOUT_MICROS.
+   *
+   * @returns true for success else false.
+   */
+  bool setTimeout(uint32_t flagUs, uint32_t busyUs = 0);
+
+  /** Stop streaming.  Frames in the ring remain available to popFrame().
+   *
+   * @returns true for success else false.
+   */
+  bool stopStream();
+
+  /** @returns Number of stream frames dropped because the ring buffer
+   *           was full.  See i2c_stream_overruns().
+   */
+  int streamOverruns() {return i2c_stream_overruns(m_i2cIf);}
+
   /** Creates a stop condition.
    *
    * @returns true for success else false.
    */
   bool stop();
   
+  /** Get statistics.  Requires I2C_STATS_ENABLE nonzero.
+   *
+   * @param[out] stats Location for statistics.
+   *
+   * @returns true for success else false.
+   */
+  bool stats(i2c_stats* stats);
+
+  /** Lock the bus if it is free.
+   *
+   * @returns true if the bus was locked else false.
+   */
+  bool tryLock() {return i2c_try_lock(m_i2cIf) == 1;}
+
+  /** Unlock the bus.
+   *
+   * @returns true for success else false.
+   */
+  bool unlock();
+
   /** Write single byte to a selected slave.
    *
    * @param[in] data data to write out on bus
@@ -88,6 +330,36 @@ class I2cMaster {
    * @param[in] stop Generate stop if true.   
    */
   bool write(uint8_t data, bool stop);
+
+  /** Write then read with a repeated start between the two phases.
+   *
+   * @param[in] address Right justified 7-bit address.
+   * @param[in] txBuf Data to send, typically a register address.
+   * @param[in] txCount Number of bytes to send.
+   * @param[out] rxBuf Buffer for read data.
+   * @param[in] rxCount Number of bytes to read.
+   * @param[in] stop Generate stop if true.
+   *
+   * @returns true for success else false.
+   */
+  bool transfer(uint8_t address, const void* txBuf, size_t txCount,
+                void* rxBuf, size_t rxCount, bool stop = true);
+
+  /** Run a list of segments with a repeated start between segments.
+   *
+   * @param[in] seg Array of segments.
+   * @param[in] count Number of segments.
+   * @param[in] stop Generate stop after the last segment if true.
+   *
+   * @returns true for success else false.
+   */
+  bool transfer(const i2c_segment* seg, size_t count, bool stop = true);
+
+  /** Wait for an interrupt driven transfer to finish.
+   *
+   * @returns true for success else false.
+   */
+  bool wait();
   
   /** Write to a selected slave.
    *
@@ -112,8 +384,67 @@ class I2cMaster {
    */
   bool write(uint8_t address, const void* buf, size_t count, bool stop = true);
 
+  /** Queue an interrupt driven write to an I2C slave.
+   *
+   * The write starts when earlier queued requests and a transfer started
+   * by startRead() or startWrite() finish.  The queue replaces a callback
+   * set with i2c_set_callback().  See I2cFuture.
+   *
+   * @param[in] address Right justified 7-bit address.
+   * @param[in] buf Data to send.
+   * @param[in] count Number of bytes to send.
+   * @param[in] stop Generate stop if true.
+   *
+   * @returns Handle for the request.  Check valid() for a full queue.
+   */
+  I2cFuture writeAsync(uint8_t address, const void* buf, size_t count, bool stop = true);
+
+  /** Start a DMA write to an I2C slave.  Call dmaWait() to finish.
+   *
+   * @param[in] address Right justified 7-bit address.
+   * @param[in] buf Data to send.
+   * @param[in] count Number of bytes to send.
+   * @param[in] stop Generate stop if true.
+   *
+   * @returns true for success else false.
+   */
+  bool writeDma(uint8_t address, const void* buf, size_t count, bool stop = true);
+
  private:
   int m_rtn;
   HAL_I2C_Interface m_i2cIf;
 };
+/**
+ * @class I2cBusGuard
+ * @brief Holds the bus lock of an I2cMaster for the life of the object.
+ */
+class I2cBusGuard {
+ public:
+  /** Lock the bus.  Check locked() before using the bus.
+   *
+   * @param[in] i2c The bus.
+   * @param[in] ms Maximum wait in milliseconds.
+   */
+  explicit I2cBusGuard(I2cMaster& i2c, uint32_t ms = I2C_LOCK_FOREVER)
+    : m_i2c(i2c), m_locked(i2c.lock(ms)) {}
+
+  /** Unlock the bus if it was locked. */
+  ~I2cBusGuard() {
+    if (m_locked) {
+      m_i2c.unlock();
+    }
+  }
+
+  /** @return true if the bus is locked else false.  I2cMaster::rtn()
+   *          has the error.
+   */
+  bool locked() const {return m_locked;}
+
+  I2cBusGuard(const I2cBusGuard&) = delete;
+  I2cBusGuard& operator=(const I2cBusGuard&) = delete;
+
+ private:
+  I2cMaster& m_i2c;
+  bool m_locked;
+};
 #endif  // I2cMaster_h
\ No newline at end of file
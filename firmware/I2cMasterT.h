@@ -0,0 +1,220 @@
+/* Particle I2cMaster Library
+ * Copyright (C) 2016 by William Greiman
+ *
+ * This file is part of the Particle I2cMaster Library
+ *
+ * This Library is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This Library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with the Particle I2cMaster Library.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+#ifndef I2cMasterT_h
+#define I2cMasterT_h
+#include "application.h"
+#include "i2c_lld_stm32.h"
+//-----------------------------------------------------------------------------
+/**
+ * @struct I2cMasterTraits
+ * @brief Compile time peripheral of an I2C interface.
+ */
+template <HAL_I2C_Interface i2cIf> struct I2cMasterTraits;
+
+/** Photon, Electron or Core D0/D1. */
+template <> struct I2cMasterTraits<HAL_I2C_INTERFACE1> {
+  static I2C_TypeDef* i2c() {return I2C1;}
+};
+
+#if PLATFORM_ID == 10
+/** Electron C4/C5. */
+template <> struct I2cMasterTraits<HAL_I2C_INTERFACE2> {
+  static I2C_TypeDef* i2c() {return I2C1;}
+};
+
+#if defined(PM_SDA_UC) && defined(PM_SCL_UC)
+/** Electron power management I2C3. */
+template <> struct I2cMasterTraits<HAL_I2C_INTERFACE3> {
+  static I2C_TypeDef* i2c() {return I2C3;}
+};
+#endif  // defined(PM_SDA_UC) && defined(PM_SCL_UC)
+#endif  // PLATFORM_ID == 10
+//-----------------------------------------------------------------------------
+/**
+ * @class I2cMasterT
+ * @brief I2C polled master class for an interface selected at compile time.
+ *
+ * The peripheral address is a constant so the polling loops inline with
+ * a constant register address.  begin(), end() and frequency() call the
+ * low level driver.  Use I2cMaster if the interface is selected at run
+ * time.
+ *
+ * Transfers by this class are not recorded in statistics or the trace
+ * buffer and do not trigger automatic bus recovery.  Interrupt and DMA
+ * transfers are only available in I2cMaster.
+ */
+template <HAL_I2C_Interface i2cIf>
+class I2cMasterT {
+ public:
+  I2cMasterT() : m_rtn(0), m_flagTimeout(I2C_FLAG_TIMEOUT_MICROS) {}
+
+  /** Initialize the I2C interface.
+   *
+   * @param hz The bus frequency in hertz
+   *
+   * @returns true for success else false.
+   */
+  bool begin(uint32_t hz = 100000) {
+    m_rtn = i2c_begin(i2cIf, hz);
+    return m_rtn >= 0;
+  }
+
+  /** Disable the I2C interface.
+   *
+   * @returns true for success else false.
+   */
+  bool end() {
+    m_rtn = i2c_end(i2cIf);
+    return m_rtn >= 0;
+  }
+
+  /** Set scl frequency.
+   *
+   * @param[in] hz The bus frequency in Hz.
+   *
+   * @returns true for success else false.
+   */
+  bool frequency(uint32_t hz) {
+    m_rtn = i2c_frequency(i2cIf, hz);
+    return m_rtn >= 0;
+  }
+
+  /** Read from an I2C slave
+   *
+   * @param[in] address Right justified 7-bit address.
+   * @param[out] buf Buffer for read data.
+   * @param[in] count Number of bytes to read.
+   * @param[in] stop Generate stop if true.
+   *
+   * @returns true for success else false.
+   */
+  bool read(uint8_t address, void* buf, size_t count, bool stop = true) {
+    m_rtn = i2c_ll_master_read(i2c(), address, buf, count, stop, m_flagTimeout);
+    return m_rtn >= 0;
+  }
+
+  /** Recover a bus held low by a slave.  See i2c_recover().
+   *
+   * @returns true for success else false.
+   */
+  bool recoverBus() {
+    m_rtn = i2c_recover(i2cIf);
+    return m_rtn >= 0;
+  }
+
+  /** Return low level driver info.
+   *
+   * @returns See low level driver.
+   */
+  int rtn() {return m_rtn;}
+
+  /** Set timeouts.
+   *
+   * @param[in] flagUs Time to wait for a bus event in microseconds.
+   *                   Zero selects I2C_FLAG_TIMEOUT_MICROS.
+   * @param[in] busyUs Time to wait for the bus to be free in microseconds.
+   *                   Zero selects I2C_BUSY_TIMEOUT_MICROS.
+   *
+   * @returns true for success else false.
+   */
+  bool setTimeout(uint32_t flagUs, uint32_t busyUs = 0) {
+    m_flagTimeout = flagUs ? flagUs : I2C_FLAG_TIMEOUT_MICROS;
+    m_rtn = i2c_timeout(i2cIf, flagUs, busyUs);
+    return m_rtn >= 0;
+  }
+
+  /** Creates a stop condition.
+   *
+   * @returns true for success else false.
+   */
+  bool stop() {
+    m_rtn = i2c_ll_master_stop(i2c(), m_flagTimeout);
+    return m_rtn >= 0;
+  }
+
+  /** Write then read with a repeated start between the two phases.
+   *
+   * @param[in] address Right justified 7-bit address.
+   * @param[in] txBuf Data to send, typically a register address.
+   * @param[in] txCount Number of bytes to send.
+   * @param[out] rxBuf Buffer for read data.
+   * @param[in] rxCount Number of bytes to read.
+   * @param[in] stop Generate stop if true.
+   *
+   * @returns true for success else false.
+   */
+  bool transfer(uint8_t address, const void* txBuf, size_t txCount,
+                void* rxBuf, size_t rxCount, bool stop = true) {
+    if (!write(address, txBuf, txCount, false) ||
+        !read(address, rxBuf, rxCount, stop)) {
+      i2c_ll_release_bus(i2c());
+      return false;
+    }
+    return true;
+  }
+
+  /** Write single byte to a selected slave.
+   *
+   * @param[in] data data to write out on bus
+   * @param[in] stop Generate stop if true.
+   *
+   * @returns true for success else false.
+   */
+  bool write(uint8_t data, bool stop) {
+    return write(&data, 1, stop);
+  }
+
+  /** Write to a selected slave.
+   *
+   * Continue after a write without a stop.
+   *
+   * @param[in] buf Data to send.
+   * @param[in] count Number of bytes to send.
+   * @param[in] stop Generate stop if true.
+   *
+   * @returns true for success else false.
+   */
+  bool write(const void* buf, size_t count, bool stop) {
+    m_rtn = i2c_ll_write_data(i2c(), buf, count, stop, m_flagTimeout);
+    return m_rtn >= 0;
+  }
+
+  /** Write to an I2C slave
+   *
+   * @param[in] address Right justified 7-bit address.
+   * @param[in] buf Data to send.
+   * @param[in] count Number of bytes to send.
+   * @param[in] stop Generate stop if true.
+   *
+   * @returns true for success else false.
+   */
+  bool write(uint8_t address, const void* buf, size_t count, bool stop = true) {
+    m_rtn = i2c_ll_master_write(i2c(), address, buf, count, stop, m_flagTimeout);
+    return m_rtn >= 0;
+  }
+
+ private:
+  typedef I2cMasterTraits<i2cIf> Traits;
+
+  static I2C_TypeDef* i2c() {return Traits::i2c();}
+  int m_rtn;
+  uint32_t m_flagTimeout;
+};
+#endif  // I2cMasterT_h
@@ -0,0 +1,133 @@
+/* Particle I2cMaster Library
+ * Copyright (C) 2016 by William Greiman
+ *
+ * This file is part of the Particle I2cMaster Library
+ *
+ * This Library is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This Library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with the Particle I2cMaster Library.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+#include "application.h"
+#include "I2cSampler.h"
+
+bool I2cSampler::addJob(I2cSampleJob* job) {
+  if (m_jobCount == I2C_SAMPLER_MAX_JOBS || !job->buffer ||
+      job->count == 0 || job->periodTicks == 0) {
+    return false;
+  }
+  job->countdown = 1;
+  job->front = 0;
+  job->busy = false;
+  job->stopPending = false;
+  memset(&job->stats, 0, sizeof(job->stats));
+  m_job[m_jobCount++] = job;
+  return true;
+}
+
+void I2cSampler::finish(I2cSampleJob* job) {
+  int rtn = job->read.result();
+  uint32_t m;
+  job->busy = false;
+  if (rtn != job->count || !job->read.startMicros(&m)) {
+    job->stats.errors++;
+    /* The next interval would span the failed sample. */
+    job->lastStartMicros = 0;
+    return;
+  }
+  job->front ^= 1;
+  job->sampleMicros = m;
+  job->stats.samples++;
+
+  /* Jitter is measured between the bus starts of consecutive reads. */
+  if (job->lastStartMicros) {
+    uint32_t interval = m - job->lastStartMicros;
+    uint32_t period = job->periodTicks*m_tickMicros;
+    uint32_t jitter = interval > period ? interval - period : period - interval;
+    if (job->stats.minIntervalMicros == 0 || interval < job->stats.minIntervalMicros) {
+      job->stats.minIntervalMicros = interval;
+    }
+    if (interval > job->stats.maxIntervalMicros) {
+      job->stats.maxIntervalMicros = interval;
+    }
+    if (jitter > job->stats.maxJitterMicros) {
+      job->stats.maxJitterMicros = jitter;
+    }
+  }
+  job->lastStartMicros = m;
+}
+
+uint32_t I2cSampler::read(I2cSampleJob* job, void* dst, uint32_t* micros) {
+  uint32_t primask = __get_PRIMASK();
+  __disable_irq();
+  uint32_t n = job->stats.samples;
+  if (n) {
+    memcpy(dst, job->buffer + job->front*job->count, job->count);
+    if (micros) {
+      *micros = job->sampleMicros;
+    }
+  }
+  __set_PRIMASK(primask);
+  return n;
+}
+
+void I2cSampler::start(I2cSampleJob* job) {
+  uint8_t* back = job->buffer + (job->front ^ 1)*job->count;
+
+  if (!m_i2c->writeAsync(job->address, &job->reg, 1, false).valid()) {
+    job->stats.errors++;
+    return;
+  }
+  job->read = m_i2c->readAsync(job->address, back, job->count);
+  if (!job->read.valid()) {
+    /* The write ends without a stop.  At the next tick queue an address
+       only write with stop to release the bus. */
+    job->stopPending = true;
+    job->stats.errors++;
+    return;
+  }
+  job->busy = true;
+}
+
+void I2cSampler::stats(I2cSampleJob* job, I2cSampleStats* stats) {
+  uint32_t primask = __get_PRIMASK();
+  __disable_irq();
+  *stats = job->stats;
+  __set_PRIMASK(primask);
+}
+
+void I2cSampler::tick() {
+  for (size_t i = 0; i < m_jobCount; i++) {
+    I2cSampleJob* job = m_job[i];
+    if (job->stopPending) {
+      /* read holds the stop request.  Polling it keeps the queue moving. */
+      if (!job->read.valid()) {
+        job->read = m_i2c->writeAsync(job->address, 0, 0);
+      }
+      job->stopPending = !job->read.valid() || !job->read.ready();
+    }
+    if (job->busy && job->read.ready()) {
+      finish(job);
+    }
+    if (--job->countdown) {
+      continue;
+    }
+    job->countdown = job->periodTicks;
+    if (job->busy || job->stopPending) {
+      job->stats.overruns++;
+      /* Missed starts are not jitter. */
+      job->lastStartMicros = 0;
+      continue;
+    }
+    start(job);
+  }
+}
\ No newline at end of file
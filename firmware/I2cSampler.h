@@ -0,0 +1,144 @@
+/* Particle I2cMaster Library
+ * Copyright (C) 2016 by William Greiman
+ *
+ * This file is part of the Particle I2cMaster Library
+ *
+ * This Library is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This Library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with the Particle I2cMaster Library.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+#ifndef I2cSampler_h
+#define I2cSampler_h
+#include "I2cMaster.h"
+
+#ifndef I2C_SAMPLER_MAX_JOBS
+/** Maximum number of jobs in an I2cSampler.  Each job queues two requests
+ *  so more jobs need a larger I2C_ASYNC_QUEUE_SIZE for the whole build.
+ */
+#define I2C_SAMPLER_MAX_JOBS (I2C_ASYNC_QUEUE_SIZE/2)
+#endif  // I2C_SAMPLER_MAX_JOBS
+static_assert(2*I2C_SAMPLER_MAX_JOBS <= I2C_ASYNC_QUEUE_SIZE,
+              "I2C_ASYNC_QUEUE_SIZE must be at least 2*I2C_SAMPLER_MAX_JOBS");
+
+/** Sampling statistics for a job. */
+struct I2cSampleStats {
+  /** Number of samples completed. */
+  uint32_t samples;
+  /** Samples skipped because the previous read was not done. */
+  uint32_t overruns;
+  /** Failed reads. */
+  uint32_t errors;
+  /** Minimum time between the bus starts of sample reads in microseconds. */
+  uint32_t minIntervalMicros;
+  /** Maximum time between the bus starts of sample reads in microseconds. */
+  uint32_t maxIntervalMicros;
+  /** Maximum difference between the start interval and the period. */
+  uint32_t maxJitterMicros;
+};
+
+/**
+ * @struct I2cSampleJob
+ * @brief A periodic register read.
+ *
+ * buffer must hold 2*count bytes.  One half holds the latest sample while
+ * the next sample is read into the other half.
+ */
+struct I2cSampleJob {
+  I2cSampleJob() : address(0), reg(0), count(0), periodTicks(1), buffer(0),
+    countdown(0), front(0), busy(false), stopPending(false), sampleMicros(0),
+    lastStartMicros(0) {
+    memset(&stats, 0, sizeof(stats));
+  }
+
+  /** Right justified 7-bit address. */
+  uint8_t address;
+  /** First register to read. */
+  uint8_t reg;
+  /** Number of bytes per sample. */
+  uint8_t count;
+  /** Sample period in ticks. */
+  uint16_t periodTicks;
+  /** Double buffer, 2*count bytes. */
+  uint8_t* buffer;
+
+  // Set by I2cSampler.
+  uint16_t countdown;
+  uint8_t front;
+  bool busy;
+  bool stopPending;
+  I2cFuture read;
+  uint32_t sampleMicros;
+  uint32_t lastStartMicros;
+  I2cSampleStats stats;
+};
+/**
+ * @class I2cSampler
+ * @brief Periodic register reads driven by a timer.
+ *
+ * Call tick() from a timer interrupt or timer callback with a fixed
+ * period.  Due jobs are started with I2cMaster::writeAsync() and
+ * readAsync() so the reads run in the I2C interrupt.  A finished sample
+ * is published at the next tick.  Sample times and interval statistics use
+ * the time the read started on the bus, not the time it was queued.  If the read can't be queued after the
+ * register write, a stop is queued at the following ticks to release the
+ * bus and the sample counts as an error.
+ */
+class I2cSampler {
+ public:
+  /** Create a sampler.
+   *
+   * @param[in] i2c The bus.
+   * @param[in] tickMicros Period of tick() calls in microseconds.
+   */
+  I2cSampler(I2cMaster* i2c, uint32_t tickMicros)
+    : m_i2c(i2c), m_tickMicros(tickMicros), m_jobCount(0) {}
+
+  /** Add a job.  Call before the timer is started.
+   *
+   * @param[in] job The job.
+   *
+   * @returns true for success else false.
+   */
+  bool addJob(I2cSampleJob* job);
+
+  /** Copy the latest sample of a job.
+   *
+   * @param[in] job The job.
+   * @param[out] dst Location for job->count bytes.
+   * @param[out] micros Time the sample read started on the bus.  May be
+   *                    NULL.
+   *
+   * @returns Number of samples completed.  Zero if no sample is available.
+   */
+  uint32_t read(I2cSampleJob* job, void* dst, uint32_t* micros = 0);
+
+  /** Get sampling statistics for a job.
+   *
+   * @param[in] job The job.
+   * @param[out] stats Location for statistics.
+   */
+  void stats(I2cSampleJob* job, I2cSampleStats* stats);
+
+  /** Publish finished samples and start due jobs. */
+  void tick();
+
+ private:
+  void finish(I2cSampleJob* job);
+  void start(I2cSampleJob* job);
+
+  I2cMaster* m_i2c;
+  uint32_t m_tickMicros;
+  I2cSampleJob* m_job[I2C_SAMPLER_MAX_JOBS];
+  size_t m_jobCount;
+};
+#endif  // I2cSampler_h
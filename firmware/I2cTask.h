@@ -0,0 +1,220 @@
+/* Particle I2cMaster Library
+ * Copyright (C) 2016 by William Greiman
+ *
+ * This file is part of the Particle I2cMaster Library
+ *
+ * This Library is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This Library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with the Particle I2cMaster Library.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+#ifndef I2cTask_h
+#define I2cTask_h
+/*
+ * C++20 coroutine tasks that await I2cFuture requests and delays.
+ *
+ * Only available if the compiler supports coroutines.
+ */
+#include "I2cMaster.h"
+#if defined(__cpp_impl_coroutine) && __cpp_impl_coroutine >= 201902L
+#include <coroutine>
+#include <exception>
+
+#ifndef I2C_TASK_MAX
+/** Maximum number of tasks in an I2cTaskScheduler. */
+#define I2C_TASK_MAX 8
+#endif  // I2C_TASK_MAX
+
+/**
+ * @class I2cTask
+ * @brief Coroutine return type for tasks run by I2cTaskScheduler.
+ *
+ * Tasks start when passed to I2cTaskScheduler::spawn().
+ */
+class I2cTask {
+ public:
+  struct promise_type {
+    I2cTask get_return_object() {
+      return I2cTask(std::coroutine_handle<promise_type>::from_promise(*this));
+    }
+    std::suspend_always initial_suspend() noexcept {return {};}
+    std::suspend_always final_suspend() noexcept {return {};}
+    void return_void() {}
+    // A task has no caller to rethrow to so an exception is fatal.
+    void unhandled_exception() {std::terminate();}
+  };
+  I2cTask(I2cTask&& task) : m_handle(task.m_handle) {task.m_handle = nullptr;}
+  I2cTask(const I2cTask&) = delete;
+  I2cTask& operator=(const I2cTask&) = delete;
+  ~I2cTask() {
+    if (m_handle) {
+      m_handle.destroy();
+    }
+  }
+
+ private:
+  friend class I2cTaskScheduler;
+  explicit I2cTask(std::coroutine_handle<promise_type> h) : m_handle(h) {}
+  std::coroutine_handle<promise_type> m_handle;
+};
+//-----------------------------------------------------------------------------
+/**
+ * @class I2cTaskScheduler
+ * @brief Cooperative scheduler for I2cTask coroutines.
+ *
+ * poll() resumes tasks whose request is done or whose delay has expired.
+ * Several device tasks can share one bus since a task waiting for a
+ * request does not block the others.
+ */
+class I2cTaskScheduler {
+ public:
+  I2cTaskScheduler() : m_current(0) {}
+
+  /** Awaitable delay.  Use co_await I2cTaskScheduler::delay(us). */
+  struct Delay {
+    uint32_t wakeMicros;
+    bool await_ready() const {
+      return (int32_t)(micros() - wakeMicros) >= 0;
+    }
+    void await_suspend(std::coroutine_handle<>) {
+      s_active->waitTime(wakeMicros);
+    }
+    void await_resume() {}
+  };
+
+  /** Awaitable request.  Use co_await on an I2cFuture. */
+  struct Request {
+    I2cFuture future;
+    bool await_ready() const {return future.ready();}
+    void await_suspend(std::coroutine_handle<>) {
+      s_active->waitFuture(future);
+    }
+    int await_resume() {return future.result();}
+  };
+
+  /** Suspend the task for a time.
+   *
+   * @param[in] us Delay in microseconds.
+   *
+   * @returns Awaitable object.
+   */
+  static Delay delay(uint32_t us) {return Delay{micros() + us};}
+
+  /** Suspend the task until a time.
+   *
+   * @param[in] wakeMicros Value of micros() to resume the task.
+   *
+   * @returns Awaitable object.
+   */
+  static Delay delayUntil(uint32_t wakeMicros) {return Delay{wakeMicros};}
+
+  /** Resume tasks that are ready to run.
+   *
+   * @returns Number of tasks that have not finished.
+   */
+  size_t poll() {
+    size_t n = 0;
+    for (size_t i = 0; i < I2C_TASK_MAX; i++) {
+      Slot* slot = &m_slot[i];
+      if (!slot->handle) {
+        continue;
+      }
+      if (isReady(slot)) {
+        I2cTaskScheduler* previous = s_active;
+        s_active = this;
+        m_current = i;
+        slot->wait = WAIT_NONE;
+        slot->handle.resume();
+        s_active = previous;
+        if (slot->handle.done()) {
+          slot->handle.destroy();
+          slot->handle = nullptr;
+          continue;
+        }
+      }
+      n++;
+    }
+    return n;
+  }
+
+  /** Run tasks until all have finished. */
+  void run() {
+    while (poll()) {}
+  }
+
+  /** Add a task.  The task runs in the next call to poll().
+   *
+   * @param[in] task The task.
+   *
+   * @returns true for success else false if I2C_TASK_MAX tasks are active.
+   */
+  bool spawn(I2cTask&& task) {
+    for (size_t i = 0; i < I2C_TASK_MAX; i++) {
+      if (!m_slot[i].handle) {
+        m_slot[i].handle = task.m_handle;
+        m_slot[i].wait = WAIT_NONE;
+        task.m_handle = nullptr;
+        return true;
+      }
+    }
+    return false;
+  }
+
+ private:
+  static const uint8_t WAIT_NONE = 0;
+  static const uint8_t WAIT_FUTURE = 1;
+  static const uint8_t WAIT_TIME = 2;
+
+  struct Slot {
+    Slot() : handle(nullptr), wakeMicros(0), wait(WAIT_NONE) {}
+    std::coroutine_handle<> handle;
+    I2cFuture future;
+    uint32_t wakeMicros;
+    uint8_t wait;
+  };
+
+  bool isReady(const Slot* slot) const {
+    switch (slot->wait) {
+      case WAIT_FUTURE:
+        return slot->future.ready();
+
+      case WAIT_TIME:
+        return (int32_t)(micros() - slot->wakeMicros) >= 0;
+
+      default:
+        return true;
+    }
+  }
+  void waitFuture(const I2cFuture& future) {
+    m_slot[m_current].future = future;
+    m_slot[m_current].wait = WAIT_FUTURE;
+  }
+  void waitTime(uint32_t wakeMicros) {
+    m_slot[m_current].wakeMicros = wakeMicros;
+    m_slot[m_current].wait = WAIT_TIME;
+  }
+  static inline I2cTaskScheduler* s_active = nullptr;
+  Slot m_slot[I2C_TASK_MAX];
+  size_t m_current;
+};
+//-----------------------------------------------------------------------------
+/** Allow co_await on requests from I2cMaster::readAsync()/writeAsync().
+ *
+ * @param[in] future Request to wait for.
+ *
+ * @returns Awaitable whose value is I2cFuture::result().
+ */
+inline I2cTaskScheduler::Request operator co_await(I2cFuture future) {
+  return I2cTaskScheduler::Request{future};
+}
+#endif  // defined(__cpp_impl_coroutine) && __cpp_impl_coroutine >= 201902L
+#endif  // I2cTask_h
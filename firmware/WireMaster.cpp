@@ -19,22 +19,27 @@
  */
 /* Arduino Wire Master functionality. */
 #include "WireMaster.h"
+#include <string.h>
 #include "i2c_lld.h"
 
-WireMaster::WireMaster(HAL_I2C_Interface i2cIf) {
+WireMasterBase::WireMasterBase(HAL_I2C_Interface i2cIf,
+                   uint8_t* rxBuffer, uint8_t* txBuffer, size_t bufferSize) {
   m_frequency = 100000;
   m_i2cIf = i2cIf;
+  m_rxBuffer = rxBuffer;
+  m_txBuffer = txBuffer;
+  m_bufferSize = bufferSize;
   m_rxBufferIndex = 0;
   m_rxBufferLength = 0;
   m_txBufferLength = 0;
   m_transmitting = 0;
 }
 
-int WireMaster::available() {
+int WireMasterBase::available() {
   return m_rxBufferLength - m_rxBufferIndex;
 }
 
-void WireMaster::begin() {
+void WireMasterBase::begin() {
   m_rxBufferIndex = 0;
   m_rxBufferLength = 0;
   m_txBufferLength = 0;
@@ -42,21 +47,21 @@ void WireMaster::begin() {
   i2c_begin(m_i2cIf, m_frequency);
 }
 
-void WireMaster::beginTransmission(uint8_t address) {
+void WireMasterBase::beginTransmission(uint8_t address) {
   m_txAddress = address;
   m_transmitting = 1; 
   m_txBufferLength = 0;
 }
 
-void WireMaster::beginTransmission(int address) {
+void WireMasterBase::beginTransmission(int address) {
   beginTransmission((uint8_t)address);
 }
 
-void WireMaster::end() {
+void WireMasterBase::end() {
   i2c_end(m_i2cIf);
 }
 
-uint8_t WireMaster::endTransmission(uint8_t stop) {
+uint8_t WireMasterBase::endTransmission(uint8_t stop) {
   uint8_t rtn = 1;
   if (m_transmitting) {
     m_rtn = i2c_write(m_i2cIf, m_txAddress, m_txBuffer, m_txBufferLength, stop);
@@ -67,49 +72,126 @@ uint8_t WireMaster::endTransmission(uint8_t stop) {
   return rtn;
 }
 
-uint8_t WireMaster::endTransmission() {
+uint8_t WireMasterBase::endTransmission() {
   return endTransmission(true);
 }
 
-void WireMaster::flush() {
+uint8_t WireMasterBase::endTransmission(const void* buf, size_t count, uint8_t stop) {
+  uint8_t rtn = 1;
+  if (m_transmitting) {
+    i2c_segment seg[2];
+    seg[0].addr = m_txAddress;
+    seg[0].flags = 0;
+    seg[0].buf = m_txBuffer;
+    seg[0].len = m_txBufferLength;
+    seg[1].addr = m_txAddress;
+    seg[1].flags = I2C_SEG_NOSTART;
+    seg[1].buf = (void*)buf;
+    seg[1].len = count;
+    m_rtn = m_txBufferLength ? i2c_transfer(m_i2cIf, seg, 2, stop)
+                             : i2c_transfer(m_i2cIf, seg + 1, 1, stop);
+    rtn = m_rtn < 0 ? 2 : 0;
+  }
+  m_txBufferLength = 0;
+  m_transmitting = 0;
+  return rtn;
+}
+
+void WireMasterBase::flush() {
   // to be implemented.
 }
 
-int WireMaster::peek() {
+bool WireMasterBase::lock() {
+  m_rtn = i2c_lock(m_i2cIf);
+  return m_rtn >= 0;
+}
+
+int WireMasterBase::peek() {
   if (m_rxBufferIndex < m_rxBufferLength){
     return m_rxBuffer[m_rxBufferIndex];
   }
   return -1;
 }
 
-int WireMaster::read() {
+int WireMasterBase::read() {
   if (m_rxBufferIndex < m_rxBufferLength){
     return m_rxBuffer[m_rxBufferIndex++];
   }
   return -1;
 }
 
-size_t WireMaster::requestFrom(uint8_t address, size_t quantity, uint8_t sendStop) {
+size_t WireMasterBase::readBytes(char* buffer, size_t length) {
+  size_t n = m_rxBufferLength - m_rxBufferIndex;
+  if (n > length) {
+    n = length;
+  }
+  memcpy(buffer, m_rxBuffer + m_rxBufferIndex, n);
+  m_rxBufferIndex += n;
+  return n;
+}
+
+size_t WireMasterBase::requestFrom(uint8_t address, size_t quantity, uint8_t sendStop) {
   // Follow Arduino if quantity too large.
-  if (quantity > WIRE_MASTER_BUFFER_LENGTH) {
-    quantity = WIRE_MASTER_BUFFER_LENGTH;
+  if (quantity > m_bufferSize) {
+    quantity = m_bufferSize;
   }
   m_rtn = i2c_read(m_i2cIf, address, m_rxBuffer, quantity, sendStop);
   m_rxBufferIndex = 0;
   m_rxBufferLength = m_rtn < 0 ? 0 : quantity;
   return m_rxBufferLength;
 }
-size_t WireMaster::requestFrom(uint8_t address, size_t quantity) {
+size_t WireMasterBase::requestFrom(uint8_t address, size_t quantity) {
   return requestFrom(address, quantity, 1);
 }
+
+size_t WireMasterBase::requestFrom(uint8_t address, size_t quantity,
+                                   uint32_t iaddress, uint8_t isize, uint8_t sendStop) {
+  uint8_t iaddr[4];
+  if (isize == 0) {
+    return requestFrom(address, quantity, sendStop);
+  }
+  if (isize > sizeof(iaddr)) {
+    isize = sizeof(iaddr);
+  }
+  for (uint8_t i = 0; i < isize; i++) {
+    iaddr[i] = iaddress >> (8*(isize - i - 1));
+  }
+  // Follow Arduino if quantity too large.
+  if (quantity > m_bufferSize) {
+    quantity = m_bufferSize;
+  }
+  m_rtn = i2c_write_read(m_i2cIf, address, iaddr, isize,
+                         m_rxBuffer, quantity, sendStop);
+  m_rxBufferIndex = 0;
+  m_rxBufferLength = m_rtn < 0 ? 0 : quantity;
+  return m_rxBufferLength;
+}
+
+size_t WireMasterBase::readFrom(uint8_t address, void* buf,
+                                size_t quantity, uint8_t sendStop) {
+  m_rtn = i2c_read(m_i2cIf, address, buf, quantity, sendStop);
+  m_rxBufferIndex = 0;
+  m_rxBufferLength = 0;
+  return m_rtn < 0 ? 0 : quantity;
+}
   
-void WireMaster::setClock(uint32_t frequency) {
+void WireMasterBase::setClock(uint32_t frequency) {
   m_frequency = frequency;
   i2c_frequency(m_i2cIf, m_frequency);
 }
 
-size_t WireMaster::write(uint8_t data) {
-  if (m_transmitting && m_txBufferLength < WIRE_MASTER_BUFFER_LENGTH){
+uint8_t WireMasterBase::transfer(const i2c_segment* seg, size_t count, uint8_t stop) {
+  m_rtn = i2c_transfer(m_i2cIf, seg, count, stop);
+  return m_rtn < 0 ? 2 : 0;
+}
+
+bool WireMasterBase::unlock() {
+  m_rtn = i2c_unlock(m_i2cIf);
+  return m_rtn >= 0;
+}
+
+size_t WireMasterBase::write(uint8_t data) {
+  if (m_transmitting && m_txBufferLength < m_bufferSize){
     m_txBuffer[m_txBufferLength++] = data;    
     return 1;
   }
@@ -118,12 +200,18 @@ size_t WireMaster::write(uint8_t data) {
   return 0;
 }
 
-size_t WireMaster::write(const uint8_t *data, size_t quantity) {
-  size_t n;
-  for (n = 0; n < quantity; n++){
-    if (1 != write(data[n])) {
-        break;
-    }
+size_t WireMasterBase::write(const uint8_t *data, size_t quantity) {
+  if (!m_transmitting) {
+    return 0;
+  }
+  size_t n = m_bufferSize - m_txBufferLength;
+  if (n >= quantity) {
+    n = quantity;
+  } else {
+    // Error so don't send data.
+    m_transmitting = 0;
   }
+  memcpy(m_txBuffer + m_txBufferLength, data, n);
+  m_txBufferLength += n;
   return n;
 }
@@ -24,23 +24,21 @@
 #define WireMaster_h
 
 #include "application.h"
+#include "i2c_lld.h"
 
+#ifndef WIRE_MASTER_BUFFER_LENGTH
+/** Default size of the receive and transmit buffers. */
 #define WIRE_MASTER_BUFFER_LENGTH 32
+#endif  // WIRE_MASTER_BUFFER_LENGTH
 
 // WIRE_HAS_END means Wire has end()
 #define WIRE_HAS_END 1
 /**
- * @class WireMaster
- * @brief Arduino Wire style class.
+ * @class WireMasterBase
+ * @brief Arduino Wire style class.  Buffers are supplied by WireMasterT.
  */
-class WireMaster : public Stream {
+class WireMasterBase : public Stream {
  public:
-  /** Create an I2cMaster object for a specified I2C interface.
-   *
-   * @param[in] i2cIf I2C interface.
-   */
-  explicit WireMaster(HAL_I2C_Interface i2cIf = HAL_I2C_INTERFACE1);
-  
   /**
    * @return Returns the number of bytes available for retrieval with read().
    */   
@@ -80,7 +78,25 @@ class WireMaster : public Stream {
    * @return zero for success else error code.
    */  
   uint8_t endTransmission(uint8_t stop);
+
+  /** Ends a transmission to a slave device that was begun by beginTransmission().
+   * Transmits the bytes that were queued by write() followed by count bytes
+   * from buf in a single write.  buf is not copied.
+   *
+   * @param[in] buf Data to send after the queued bytes.
+   * @param[in] count Number of bytes to send from buf.
+   * @param[in] stop Generate stop if true.
+   *
+   * @return zero for success else error code.
+   */
+  uint8_t endTransmission(const void* buf, size_t count, uint8_t stop = true);
  
+  /** Lock the bus.  See i2c_lock().
+   *
+   * @return true for success else false.
+   */
+  bool lock();
+
   /** Not implemented */
   virtual void flush();  
   
@@ -95,6 +111,33 @@ class WireMaster : public Stream {
    * @return Returns -1 if no data is available else the byte.
    */
   virtual int read();
+
+  /** Remove bytes from the receive buffer with a single copy.
+   *
+   * Bytes are available as soon as requestFrom() returns so there is
+   * no timeout.
+   *
+   * Stream::readBytes() is not virtual.  This hides it, so calls through
+   * a Stream pointer or reference use the Stream version that calls
+   * read() for each byte and applies the Stream timeout.
+   *
+   * @param[out] buffer Location for the bytes.
+   * @param[in] length Maximum number of bytes to remove.
+   *
+   * @return The number of bytes copied.
+   */
+  size_t readBytes(char* buffer, size_t length);
+
+  /** Remove bytes from the receive buffer with a single copy.
+   *
+   * @param[out] buffer Location for the bytes.
+   * @param[in] length Maximum number of bytes to remove.
+   *
+   * @return The number of bytes copied.
+   */
+  size_t readBytes(uint8_t* buffer, size_t length) {
+    return readBytes((char*)buffer, length);
+  }
    
   /** Request bytes from a slave device.
    *
@@ -114,6 +157,38 @@ class WireMaster : public Stream {
    * @returns The number of bytes returned from the slave device.
    */
   size_t requestFrom(uint8_t address, size_t quantity, uint8_t stop);
+
+  /** Write an internal address then request bytes from a slave device.
+   *
+   * The address write and the read are a single transfer with a
+   * repeated start.
+   *
+   * @param[in] address Right justified 7-bit address.
+   * @param[in] quantity Number of bytes to read.
+   * @param[in] iaddress Internal address, sent most significant byte first.
+   * @param[in] isize Number of internal address bytes, at most four.
+   *                  Zero sends no internal address.
+   * @param[in] stop Generate stop if true.
+   *
+   * @returns The number of bytes returned from the slave device.
+   */
+  size_t requestFrom(uint8_t address, size_t quantity,
+                     uint32_t iaddress, uint8_t isize, uint8_t stop);
+
+  /** Read bytes from a slave device directly into a caller buffer.
+   *
+   * quantity is not limited by the buffer size and the bytes are not
+   * available to read().  Not an overload of requestFrom() so that
+   * requestFrom(address, 0, stop) is not ambiguous.
+   *
+   * @param[in] address Right justified 7-bit address.
+   * @param[out] buf Location for the data.
+   * @param[in] quantity Number of bytes to read.
+   * @param[in] stop Generate stop if true.
+   *
+   * @returns The number of bytes returned from the slave device.
+   */
+  size_t readFrom(uint8_t address, void* buf, size_t quantity, uint8_t stop = 1);
   
   /** Return low level driver info.
    *
@@ -136,7 +211,24 @@ class WireMaster : public Stream {
    * @param[in] hz The bus frequency in Hz.
    */  
   void setSpeed(uint32_t hz) {setClock(hz);}
+
+  /** Run a list of segments with a repeated start between segments.
+   *  Data goes directly to and from the segment buffers.  See i2c_transfer().
+   *
+   * @param[in] seg Array of segments.
+   * @param[in] count Number of segments.
+   * @param[in] stop Generate stop after the last segment if true.
+   *
+   * @return zero for success else error code.
+   */
+  uint8_t transfer(const i2c_segment* seg, size_t count, uint8_t stop = true);
   
+  /** Unlock the bus.
+   *
+   * @return true for success else false.
+   */
+  bool unlock();
+
   /** Queues a byte for transmission from a master to slave device.
    *
    * @param[in] data The byte to be queued.
@@ -146,6 +238,9 @@ class WireMaster : public Stream {
   virtual size_t write(uint8_t data);
   
   /** Queues bytes for transmission from a master to slave device.
+   *
+   * The bytes are copied in one block.  If they do not fit, the bytes
+   * that fit are queued and the transmission is cancelled like write(data).
    *
    * @param[in] buf Location of data to be queued.
    * @param[in] quantity Number of bytes to queue.
@@ -188,18 +283,49 @@ class WireMaster : public Stream {
   
   using Print::write;
   
+ protected:
+  WireMasterBase(HAL_I2C_Interface i2cIf,
+                 uint8_t* rxBuffer, uint8_t* txBuffer, size_t bufferSize);
+
  private:
   uint32_t m_frequency;
   HAL_I2C_Interface m_i2cIf;
   int m_rtn;
-  uint8_t m_rxBuffer[WIRE_MASTER_BUFFER_LENGTH];
+  uint8_t* m_rxBuffer;
   size_t m_rxBufferIndex;
   size_t m_rxBufferLength;
   uint8_t m_txAddress;
-  uint8_t m_txBuffer[WIRE_MASTER_BUFFER_LENGTH];
+  uint8_t* m_txBuffer;
   size_t m_txBufferLength;
+  size_t m_bufferSize;
   uint8_t m_transmitting;  
 };
+/**
+ * @class WireMasterT
+ * @brief WireMasterBase with BUFFER_SIZE byte receive and transmit buffers.
+ */
+template<size_t BUFFER_SIZE = WIRE_MASTER_BUFFER_LENGTH>
+class WireMasterT : public WireMasterBase {
+ public:
+  /** Create a WireMasterT object for a specified I2C interface.
+   *
+   * @param[in] i2cIf I2C interface.
+   */
+  explicit WireMasterT(HAL_I2C_Interface i2cIf = HAL_I2C_INTERFACE1)
+    : WireMasterBase(i2cIf, m_rx, m_tx, BUFFER_SIZE) {}
+
+ private:
+  uint8_t m_rx[BUFFER_SIZE];
+  uint8_t m_tx[BUFFER_SIZE];
+};
+/**
+ * @class WireMaster
+ * @brief Wire style class with WIRE_MASTER_BUFFER_LENGTH byte buffers.
+ */
+class WireMaster : public WireMasterT<> {
+ public:
+  using WireMasterT<>::WireMasterT;
+};
 
 #endif  // WireMaster_h
 
@@ -0,0 +1,106 @@
+// Sample jitter with a bulk write sharing the bus.  Uses a DS1307.
+//
+// A seven byte time read is due every millisecond.  The 56 byte RAM is
+// written continuously at low priority, first as one transfer and then
+// split into eight byte chunks.
+#include "application.h"
+#include "I2cMaster/I2cMaster.h"
+#include "I2cMaster/I2cBusScheduler.h"
+
+const uint8_t DS1307_I2C_ADDRESS = 0X68;
+
+// Sample period and deadline in microseconds.
+const uint32_t SAMPLE_MICROS = 1000;
+const uint32_t DEADLINE_MICROS = 500;
+
+// Number of samples per test.
+const uint16_t NUM_SAMPLES = 2000;
+
+I2cMaster I2C;
+uint8_t sample[7];
+uint8_t ram[56];
+//-----------------------------------------------------------------------------
+void bench(const char* name, size_t chunkSize) {
+  I2cBusScheduler sched(&I2C);
+  I2cTransaction sampleTrans;
+  I2cTransaction bulkTrans;
+
+  sampleTrans.address = DS1307_I2C_ADDRESS;
+  sampleTrans.read = true;
+  sampleTrans.memAddressSize = 1;
+  sampleTrans.memAddress = 0;
+  sampleTrans.buf = sample;
+  sampleTrans.count = sizeof(sample);
+  sampleTrans.priority = 1;
+  sampleTrans.deadlineMicros = DEADLINE_MICROS;
+
+  bulkTrans.address = DS1307_I2C_ADDRESS;
+  bulkTrans.memAddressSize = 1;
+  bulkTrans.memAddress = 8;
+  bulkTrans.buf = ram;
+  bulkTrans.count = sizeof(ram);
+  bulkTrans.chunkSize = chunkSize;
+
+  uint32_t maxLate = 0;
+  uint32_t due = micros() + SAMPLE_MICROS;
+  uint32_t submitted = 0;
+  uint16_t n = 0;
+  sched.submit(&bulkTrans);
+  while (n < NUM_SAMPLES) {
+    if (submitted == 0 && (int32_t)(micros() - due) >= 0) {
+      sched.submit(&sampleTrans);
+      submitted = due;
+      due += SAMPLE_MICROS;
+    }
+    if (bulkTrans.isDone()) {
+      sched.submit(&bulkTrans);
+    }
+    sched.poll();
+    if (submitted && sampleTrans.isDone()) {
+      if (sampleTrans.rtn < 0) {
+        Serial.print(name);
+        Serial.print(" failed, rtn: ");
+        Serial.println(sampleTrans.rtn);
+        return;
+      }
+      uint32_t late = micros() - submitted;
+      if (late > maxLate) {
+        maxLate = late;
+      }
+      submitted = 0;
+      n++;
+    }
+  }
+  sched.run();
+  Serial.print(name);
+  Serial.print(": max sample latency ");
+  Serial.print(maxLate);
+  Serial.print(" usec, deadline misses ");
+  Serial.println(sched.misses());
+}
+//-----------------------------------------------------------------------------
+void setup() {
+  Serial.begin(9600);
+  while (!Serial.available()) {
+    Serial.println("Type any character");
+    for (int i = 0; !Serial.available() && i < 20; i++) {
+      delay(100);
+    }
+  }
+}
+//-----------------------------------------------------------------------------
+void loop() {
+  do {delay(10);} while (Serial.read() >= 0);
+  Serial.println("Type any character to run benchmark");
+  while (Serial.read() < 0) {
+    delay(10);
+  }
+  if (!I2C.begin(400000)) {
+    Serial.println("I2C.begin failed");
+    return;
+  }
+  bench("single transfer", 0);
+  bench("8 byte chunks", 8);
+  Serial.println();
+  I2C.end();
+}
@@ -0,0 +1,174 @@
+// Timing tests for I2cMaster transfer methods with a DS1307.
+#include "application.h"
+#include "I2cMaster/I2cMaster.h"
+
+const uint8_t DS1307_I2C_ADDRESS = 0X68;
+
+// Number of bytes to read.  DS1307 has 64 registers.
+const size_t READ_COUNT = 64;
+
+// Number of transfers to average.
+const uint16_t NUM_TRANSFERS = 100;
+
+I2cMaster I2C;
+uint8_t buf[READ_COUNT];
+//-----------------------------------------------------------------------------
+// Print fail message with return info.
+void failMsg(const char* msg) {
+  Serial.print(msg);
+  Serial.print(", rtn: ");
+  Serial.println(I2C.rtn());
+}
+//-----------------------------------------------------------------------------
+void printResult(const char* name, uint32_t total, uint32_t cpu) {
+  Serial.print(name);
+  Serial.print(": ");
+  Serial.print(total/NUM_TRANSFERS);
+  Serial.print(" usec, CPU busy ");
+  Serial.print(cpu/NUM_TRANSFERS);
+  Serial.println(" usec");
+}
+//-----------------------------------------------------------------------------
+// Register address write with stop then read.
+bool writeStopRead() {
+  uint8_t memAdd = 0;
+  return I2C.write(DS1307_I2C_ADDRESS, &memAdd, 1) &&
+         I2C.read(DS1307_I2C_ADDRESS, buf, READ_COUNT);
+}
+//-----------------------------------------------------------------------------
+// Register address write with repeated start read.
+bool transferRead() {
+  uint8_t memAdd = 0;
+  return I2C.transfer(DS1307_I2C_ADDRESS, &memAdd, 1, buf, READ_COUNT);
+}
+//-----------------------------------------------------------------------------
+void benchPolled(const char* name, bool (*fcn)()) {
+  uint32_t t = micros();
+  for (uint16_t i = 0; i < NUM_TRANSFERS; i++) {
+    if (!fcn()) {
+      failMsg(name);
+      return;
+    }
+  }
+  t = micros() - t;
+  printResult(name, t, t);
+}
+//-----------------------------------------------------------------------------
+// Time start call and wait call separately.  Time between the calls
+// is available to the application.
+void benchAsync(const char* name, bool dma) {
+  uint8_t memAdd = 0;
+  uint32_t cpu = 0;
+  uint32_t t = micros();
+  for (uint16_t i = 0; i < NUM_TRANSFERS; i++) {
+    uint32_t m = micros();
+    if (!I2C.write(DS1307_I2C_ADDRESS, &memAdd, 1, false) ||
+        !(dma ? I2C.readDma(DS1307_I2C_ADDRESS, buf, READ_COUNT)
+              : I2C.startRead(DS1307_I2C_ADDRESS, buf, READ_COUNT))) {
+      failMsg(name);
+      return;
+    }
+    cpu += micros() - m;
+    while (!(dma ? I2C.dmaDone() : I2C.isDone())) {}
+    m = micros();
+    if (!(dma ? I2C.dmaWait() : I2C.wait())) {
+      failMsg(name);
+      return;
+    }
+    cpu += micros() - m;
+  }
+  printResult(name, micros() - t, cpu);
+}
+//-----------------------------------------------------------------------------
+// Queue the register address write and the read.  The read starts
+// with a repeated start in the I2C interrupt.
+void benchFuture(const char* name) {
+  uint8_t memAdd = 0;
+  uint32_t cpu = 0;
+  uint32_t t = micros();
+  for (uint16_t i = 0; i < NUM_TRANSFERS; i++) {
+    uint32_t m = micros();
+    I2C.writeAsync(DS1307_I2C_ADDRESS, &memAdd, 1, false);
+    I2cFuture f = I2C.readAsync(DS1307_I2C_ADDRESS, buf, READ_COUNT);
+    cpu += micros() - m;
+    while (!f.ready()) {}
+    if (f.result() != (int)READ_COUNT) {
+      Serial.print(name);
+      Serial.print(" failed, rtn: ");
+      Serial.println(f.result());
+      return;
+    }
+  }
+  printResult(name, micros() - t, cpu);
+}
+//-----------------------------------------------------------------------------
+// Stream seven byte time frames for one second.
+void benchStream() {
+  const size_t FRAME_SIZE = 7;
+  const size_t FRAME_COUNT = 8;
+  static uint8_t ring[FRAME_SIZE*FRAME_COUNT];
+  uint8_t frame[FRAME_SIZE];
+  uint32_t n = 0;
+
+  if (!I2C.startStream(DS1307_I2C_ADDRESS, 0, ring, FRAME_SIZE, FRAME_COUNT)) {
+    failMsg("startStream");
+    return;
+  }
+  uint32_t m = millis();
+  while ((millis() - m) < 1000) {
+    if (I2C.popFrame(frame)) {
+      n++;
+    }
+  }
+  if (!I2C.stopStream()) {
+    failMsg("stopStream");
+  }
+  while (I2C.popFrame(frame)) {
+    n++;
+  }
+  Serial.print("stream: ");
+  Serial.print(n);
+  Serial.print(" frames/sec, ");
+  Serial.print(n*FRAME_SIZE);
+  Serial.print(" bytes/sec, overruns ");
+  Serial.println(I2C.streamOverruns());
+}
+//-----------------------------------------------------------------------------
+void runBench(uint32_t hz) {
+  if (!I2C.begin(hz)) {
+    failMsg("I2C.begin failed");
+    return;
+  }
+  Serial.print(READ_COUNT);
+  Serial.print(" byte reads at ");
+  Serial.print(hz/1000);
+  Serial.println(" kHz");
+  benchPolled("write, stop, read", writeStopRead);
+  benchPolled("transfer", transferRead);
+  benchAsync("interrupt", false);
+  benchAsync("DMA", true);
+  benchFuture("future");
+  benchStream();
+  Serial.println();
+  I2C.end();
+}
+//-----------------------------------------------------------------------------
+void setup() {
+  Serial.begin(9600);
+  while (!Serial.available()) {
+    Serial.println("Type any character");
+    for (int i = 0; !Serial.available() && i < 20; i++) {
+      delay(100);
+    }
+  }
+}
+//-----------------------------------------------------------------------------
+void loop() {
+  do {delay(10);} while (Serial.read() >= 0);
+  Serial.println("Type any character to run benchmark");
+  while (Serial.read() < 0) {
+    delay(10);
+  }
+  runBench(100000);
+  runBench(400000);
+}
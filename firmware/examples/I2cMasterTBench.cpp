@@ -0,0 +1,89 @@
+// Compare I2cMaster with the compile time specialised I2cMasterT.
+//
+// Prints DWT cycles per transfer for each class.  For code size,
+// set BENCH_CLASS to 1 or 2 and compare the size reported by the build.
+#include "application.h"
+#include "I2cMaster/I2cMaster.h"
+#include "I2cMaster/I2cMasterT.h"
+
+// 0 - both classes, 1 - I2cMaster only, 2 - I2cMasterT only.
+#define BENCH_CLASS 0
+
+const uint8_t DS1307_I2C_ADDRESS = 0X68;
+
+// Number of bytes to read.
+const size_t READ_COUNT = 8;
+
+// Number of transfers to average.
+const uint16_t NUM_TRANSFERS = 1000;
+
+#if BENCH_CLASS != 2
+I2cMaster I2C;
+#endif  // BENCH_CLASS != 2
+#if BENCH_CLASS != 1
+I2cMasterT<HAL_I2C_INTERFACE1> I2CT;
+#endif  // BENCH_CLASS != 1
+uint8_t buf[READ_COUNT];
+//-----------------------------------------------------------------------------
+template <class T>
+void bench(const char* name, T& i2c, uint32_t hz) {
+  uint8_t memAdd = 0;
+  if (!i2c.begin(hz)) {
+    Serial.print(name);
+    Serial.print(" begin failed, rtn: ");
+    Serial.println(i2c.rtn());
+    return;
+  }
+  uint32_t c = DWT->CYCCNT;
+  for (uint16_t i = 0; i < NUM_TRANSFERS; i++) {
+    if (!i2c.transfer(DS1307_I2C_ADDRESS, &memAdd, 1, buf, READ_COUNT)) {
+      Serial.print(name);
+      Serial.print(" transfer failed, rtn: ");
+      Serial.println(i2c.rtn());
+      return;
+    }
+  }
+  c = DWT->CYCCNT - c;
+  Serial.print(name);
+  Serial.print(": ");
+  Serial.print(c/NUM_TRANSFERS);
+  Serial.println(" cycles per transfer");
+  i2c.end();
+}
+//-----------------------------------------------------------------------------
+void runBench(uint32_t hz) {
+  Serial.print(READ_COUNT);
+  Serial.print(" byte register reads at ");
+  Serial.print(hz/1000);
+  Serial.println(" kHz");
+#if BENCH_CLASS != 2
+  bench("I2cMaster", I2C, hz);
+#endif  // BENCH_CLASS != 2
+#if BENCH_CLASS != 1
+  bench("I2cMasterT", I2CT, hz);
+#endif  // BENCH_CLASS != 1
+  Serial.println();
+}
+//-----------------------------------------------------------------------------
+void setup() {
+  Serial.begin(9600);
+  while (!Serial.available()) {
+    Serial.println("Type any character");
+    for (int i = 0; !Serial.available() && i < 20; i++) {
+      delay(100);
+    }
+  }
+  /* Enable cycle counter */
+  CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+  DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+}
+//-----------------------------------------------------------------------------
+void loop() {
+  do {delay(10);} while (Serial.read() >= 0);
+  Serial.println("Type any character to run benchmark");
+  while (Serial.read() < 0) {
+    delay(10);
+  }
+  runBench(100000);
+  runBench(400000);
+}
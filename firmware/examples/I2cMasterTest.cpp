@@ -5,6 +5,10 @@
 const uint8_t DS1307_I2C_ADDRESS = 0X68;
 I2cMaster I2C;
 
+// Scan result survives a warm boot.
+STARTUP(System.enableFeature(FEATURE_RETAINED_MEMORY));
+retained I2cScanCache scanCache;
+
 // Must use macro to avoid predefined Wire object.
 WireMaster WireAlt;
 #undef Wire
@@ -40,26 +44,28 @@ void printData(uint8_t* data, size_t count) {
 }
 //-----------------------------------------------------------------------------
 bool rtcRead(uint8_t memAdd, uint8_t* buf, size_t count) {
-  return I2C.write(DS1307_I2C_ADDRESS, &memAdd, 1) &&
-         I2C.read(DS1307_I2C_ADDRESS, buf, count);
+  return I2C.transfer(DS1307_I2C_ADDRESS, &memAdd, 1, buf, count);
 }
 //------------------------------------------------------------------------------
 bool rtcReadWire(uint8_t memAdd, uint8_t* buf, size_t count) {
-  Wire.beginTransmission(DS1307_I2C_ADDRESS);
-  if (Wire.write(memAdd) != 1 ||
-    Wire.endTransmission() != 0 ||
-    Wire.requestFrom(DS1307_I2C_ADDRESS, count) != count) {
+  if (Wire.requestFrom(DS1307_I2C_ADDRESS, count, memAdd, 1, true) != count) {
     return false;
   }
-  for (size_t i = 0; i < count; i++) {
-    buf[i] = Wire.read();
-  }
-  return true;
+  return Wire.readBytes(buf, count) == count;
+}
+//------------------------------------------------------------------------------
+// Read into buf without the Wire buffer so count is not limited.
+bool rtcReadWireDirect(uint8_t memAdd, uint8_t* buf, size_t count) {
+  Wire.beginTransmission(DS1307_I2C_ADDRESS);
+  return Wire.write(memAdd) == 1 &&
+         Wire.endTransmission(false) == 0 &&
+         Wire.readFrom(DS1307_I2C_ADDRESS, buf, count) == count;
 }
 //-----------------------------------------------------------------------------
 bool rtcWrite(uint8_t memAdd, uint8_t* buf, uint8_t count) {
-  return I2C.write(DS1307_I2C_ADDRESS, &memAdd, 1, false) &&
-         I2C.write(buf, count, true);
+  i2c_segment seg[2] = {{DS1307_I2C_ADDRESS, 0, &memAdd, 1},
+                        {DS1307_I2C_ADDRESS, I2C_SEG_NOSTART, buf, count}};
+  return I2C.transfer(seg, 2);
 }
 //-----------------------------------------------------------------------------
 void clearRam() {
@@ -111,33 +117,46 @@ void setRam() {
   Serial.println("Done");  
 }
 //-----------------------------------------------------------------------------
-void scanBus() {
-  I2C.begin(100000);
-  uint8_t tmp;
-  uint8_t add = 0;
-  bool found = false;
-  do {
-    bool wr = I2C.write(add, &tmp, 0);
-    bool rd = I2C.read(add, &tmp, 1);
-    
-    if (rd || wr) {
-      found = true;
+// Print devices in a scan bitmap.
+void printScan(const char* name, const I2cScanOptions& options) {
+  uint8_t bitmap[16];
+  uint32_t t = micros();
+  if (!I2C.scan(bitmap, options)) {
+    failMsg(name);
+    return;
+  }
+  t = micros() - t;
+  Serial.print(name);
+  Serial.print(": ");
+  Serial.print(I2C.rtn());
+  Serial.print(" found in ");
+  Serial.print(t);
+  Serial.println(" usec");
+  for (uint8_t add = 0; add < 0X80; add++) {
+    if (bitmap[add >> 3] & (1 << (add & 7))) {
       Serial.print("Device at address: 0X");
-      Serial.print(add, HEX);
-      Serial.print(" responds to ");
-      if (rd) Serial.print("Read");
-      if (rd && wr) Serial.print(" and ");
-      if (wr) Serial.print("Write");
-      Serial.println('.');
+      Serial.println(add, HEX);
     }
-    add += 1;
-  } while (add < 0X80);
-
-  if (!found) {
-    Serial.println("No devices found.");
   }
-  Serial.println("Done"); 
-  I2C.end();  
+}
+//-----------------------------------------------------------------------------
+void scanBus() {
+  I2C.begin(100000);
+  I2cScanOptions options;
+  options.cache = &scanCache;
+  printScan("cache or full scan", options);
+  options.rescan = true;
+  printScan("full scan", options);
+  options.rescan = false;
+  printScan("cached", options);
+
+  const uint8_t candidates[] = {0X50, DS1307_I2C_ADDRESS};
+  I2cScanOptions list;
+  list.candidates = candidates;
+  list.count = sizeof(candidates);
+  printScan("candidates", list);
+  Serial.println("Done");
+  I2C.end();
 }
 //-----------------------------------------------------------------------------
 void testWire(size_t n) {
@@ -150,9 +169,53 @@ void testWire(size_t n) {
     return;
   }
   printData(reg, n);
+
+  uint8_t all[64];
+  if (!rtcReadWireDirect(0, all, sizeof(all))) {
+    failMsg("rtcReadWireDirect failed");
+    return;
+  }
+  printData(all, sizeof(all));
   Wire.end();
 }
 //-----------------------------------------------------------------------------
+// Free a bus held low by a slave.
+void recoverBus() {
+  uint32_t recoveries;
+  uint32_t failures;
+  if (!I2C.recoverBus()) {
+    failMsg("I2C.recoverBus failed");
+  }
+  I2C.recoverCounts(&recoveries, &failures);
+  Serial.print("Recoveries: ");
+  Serial.print(recoveries);
+  Serial.print(", failures: ");
+  Serial.println(failures);
+}
+//-----------------------------------------------------------------------------
+// Dump the trace buffer.  Decode the output with host/I2cTraceDecode.
+void printTrace() {
+#if I2C_TRACE_ENABLE
+  i2c_trace_event ev;
+  Serial.print("I2C_TRACE HZ ");
+  Serial.println(SystemCoreClock);
+  while (i2c_trace_read(&ev, 1) == 1) {
+    Serial.print("I2C_TRACE ");
+    Serial.print(ev.cycles, HEX);
+    Serial.print(' ');
+    Serial.print(ev.type);
+    Serial.print(' ');
+    Serial.print(ev.bus);
+    Serial.print(' ');
+    Serial.println(ev.data, HEX);
+  }
+  Serial.print("I2C_TRACE DROPPED ");
+  Serial.println(i2c_trace_dropped());
+#else  // I2C_TRACE_ENABLE
+  Serial.println("Set I2C_TRACE_ENABLE nonzero in i2c_lld.h");
+#endif  // I2C_TRACE_ENABLE
+}
+//-----------------------------------------------------------------------------
 void setup() {
   Serial.begin(9600);
   while (!Serial.available()) {
@@ -161,13 +224,15 @@ void setup() {
       delay(100);
     }    
   }
+  I2C.autoRecover(true);
 }
 //-----------------------------------------------------------------------------
 void loop() {
   int c;
   do {delay(10);} while (Serial.read() >= 0);
   Serial.println("Type '1' scan bus, '2' dump all, '3' setRam");
-  Serial.println("     '4' clearRam, '5' testWire");
+  Serial.println("     '4' clearRam, '5' testWire, '6' printTrace");
+  Serial.println("     '7' recoverBus");
   while ((c = Serial.read()) < 0) {
     delay(10);
   }
@@ -191,6 +256,14 @@ void loop() {
     case '5':
       testWire(32);
       break;
+
+    case '6':
+      printTrace();
+      break;
+
+    case '7':
+      recoverBus();
+      break;
       
     default:
       Serial.println("Invalid selection");
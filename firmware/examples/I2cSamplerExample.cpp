@@ -0,0 +1,71 @@
+// Periodic reads of the DS1307 time registers with jitter statistics.
+#include "application.h"
+#include "I2cMaster/I2cMaster.h"
+#include "I2cMaster/I2cSampler.h"
+
+const uint8_t DS1307_I2C_ADDRESS = 0X68;
+
+// Tick period in milliseconds.
+const uint32_t TICK_MILLIS = 1;
+
+I2cMaster I2C;
+I2cSampler sampler(&I2C, 1000*TICK_MILLIS);
+I2cSampleJob timeJob;
+uint8_t timeBuffer[2*7];
+
+void tick() {
+  sampler.tick();
+}
+// Software timer.  A hardware timer interrupt may also call tick().
+Timer timer(TICK_MILLIS, tick);
+//-----------------------------------------------------------------------------
+void setup() {
+  Serial.begin(9600);
+  while (!Serial.available()) {
+    Serial.println("Type any character");
+    for (int i = 0; !Serial.available() && i < 20; i++) {
+      delay(100);
+    }
+  }
+  if (!I2C.begin(400000)) {
+    Serial.println("I2C.begin failed");
+  }
+  timeJob.address = DS1307_I2C_ADDRESS;
+  timeJob.reg = 0;
+  timeJob.count = 7;
+  timeJob.periodTicks = 10;
+  timeJob.buffer = timeBuffer;
+  sampler.addJob(&timeJob);
+  timer.start();
+}
+//-----------------------------------------------------------------------------
+void loop() {
+  uint8_t time[7];
+  uint32_t m;
+  I2cSampleStats stats;
+  delay(1000);
+  if (!sampler.read(&timeJob, time, &m)) {
+    Serial.println("No sample");
+    return;
+  }
+  sampler.stats(&timeJob, &stats);
+  Serial.print(time[2], HEX);
+  Serial.print(':');
+  Serial.print(time[1], HEX);
+  Serial.print(':');
+  Serial.print(time[0], HEX);
+  Serial.print(" at ");
+  Serial.print(m);
+  Serial.print(" samples ");
+  Serial.print(stats.samples);
+  Serial.print(" interval ");
+  Serial.print(stats.minIntervalMicros);
+  Serial.print('-');
+  Serial.print(stats.maxIntervalMicros);
+  Serial.print(" jitter ");
+  Serial.print(stats.maxJitterMicros);
+  Serial.print(" overruns ");
+  Serial.print(stats.overruns);
+  Serial.print(" errors ");
+  Serial.println(stats.errors);
+}
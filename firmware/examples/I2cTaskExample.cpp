@@ -0,0 +1,77 @@
+// Two coroutine tasks share the bus with a DS1307.
+// Requires a compiler with C++20 coroutines, for example -std=gnu++20.
+#include "application.h"
+#include "I2cMaster/I2cMaster.h"
+#include "I2cMaster/I2cTask.h"
+
+const uint8_t DS1307_I2C_ADDRESS = 0X68;
+
+I2cMaster I2C;
+
+#if defined(__cpp_impl_coroutine) && __cpp_impl_coroutine >= 201902L
+I2cTaskScheduler scheduler;
+
+// Number of RAM reads by ramTask.
+uint32_t ramReads = 0;
+//-----------------------------------------------------------------------------
+// Print the seconds register once a second.
+I2cTask clockTask() {
+  uint8_t memAdd = 0;
+  uint8_t sec;
+  uint32_t wake = micros();
+  for (;;) {
+    I2C.writeAsync(DS1307_I2C_ADDRESS, &memAdd, 1, false);
+    int rtn = co_await I2C.readAsync(DS1307_I2C_ADDRESS, &sec, 1);
+    if (rtn < 0) {
+      Serial.print("clockTask failed, rtn: ");
+      Serial.println(rtn);
+    } else {
+      Serial.print("seconds: ");
+      Serial.print(sec >> 4);
+      Serial.print(sec & 0XF);
+      Serial.print(", RAM reads: ");
+      Serial.println(ramReads);
+    }
+    wake += 1000000;
+    co_await I2cTaskScheduler::delayUntil(wake);
+  }
+}
+//-----------------------------------------------------------------------------
+// Read the 56 byte RAM every 10 ms.
+I2cTask ramTask() {
+  uint8_t memAdd = 8;
+  uint8_t ram[56];
+  for (;;) {
+    I2C.writeAsync(DS1307_I2C_ADDRESS, &memAdd, 1, false);
+    if (co_await I2C.readAsync(DS1307_I2C_ADDRESS, ram, sizeof(ram)) > 0) {
+      ramReads++;
+    }
+    co_await I2cTaskScheduler::delay(10000);
+  }
+}
+#endif  // defined(__cpp_impl_coroutine) && __cpp_impl_coroutine >= 201902L
+//-----------------------------------------------------------------------------
+void setup() {
+  Serial.begin(9600);
+  while (!Serial.available()) {
+    Serial.println("Type any character");
+    for (int i = 0; !Serial.available() && i < 20; i++) {
+      delay(100);
+    }
+  }
+  if (!I2C.begin(400000)) {
+    Serial.println("I2C.begin failed");
+  }
+#if defined(__cpp_impl_coroutine) && __cpp_impl_coroutine >= 201902L
+  scheduler.spawn(clockTask());
+  scheduler.spawn(ramTask());
+#else  // defined(__cpp_impl_coroutine) && __cpp_impl_coroutine >= 201902L
+  Serial.println("Coroutines are not supported by this compiler");
+#endif  // defined(__cpp_impl_coroutine) && __cpp_impl_coroutine >= 201902L
+}
+//-----------------------------------------------------------------------------
+void loop() {
+#if defined(__cpp_impl_coroutine) && __cpp_impl_coroutine >= 201902L
+  scheduler.poll();
+#endif  // defined(__cpp_impl_coroutine) && __cpp_impl_coroutine >= 201902L
+}
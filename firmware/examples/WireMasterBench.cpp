@@ -0,0 +1,100 @@
+// Per byte cost of WireMaster buffer access with a DS1307.
+//
+// Compares byte at a time access through Stream with the block
+// write() and readBytes() calls.  Only the buffer access is timed.
+#include "application.h"
+#include "I2cMaster/WireMaster.h"
+
+const uint8_t DS1307_I2C_ADDRESS = 0X68;
+
+// Number of bytes in each transfer.
+const size_t COUNT = 32;
+
+// Number of transfers to average.
+const uint16_t NUM_TRANSFERS = 100;
+
+WireMaster WireAlt;
+uint8_t buf[COUNT];
+//-----------------------------------------------------------------------------
+void printResult(const char* name, uint32_t cycles) {
+  Serial.print(name);
+  Serial.print(": ");
+  Serial.print(cycles/NUM_TRANSFERS);
+  Serial.print(" cycles per transfer, ");
+  Serial.print((float)cycles/(NUM_TRANSFERS*COUNT));
+  Serial.println(" cycles per byte");
+}
+//-----------------------------------------------------------------------------
+// Queue bytes.  The transmission is not sent.
+void benchWrite(bool bulk) {
+  Stream& s = WireAlt;
+  uint32_t cycles = 0;
+  for (uint16_t i = 0; i < NUM_TRANSFERS; i++) {
+    WireAlt.beginTransmission(DS1307_I2C_ADDRESS);
+    uint32_t c = DWT->CYCCNT;
+    if (bulk) {
+      WireAlt.write(buf, COUNT);
+    } else {
+      for (size_t n = 0; n < COUNT; n++) {
+        s.write(buf[n]);
+      }
+    }
+    cycles += DWT->CYCCNT - c;
+  }
+  printResult(bulk ? "write(buf, n)" : "write(byte)", cycles);
+}
+//-----------------------------------------------------------------------------
+void benchRead(bool bulk) {
+  Stream& s = WireAlt;
+  uint32_t cycles = 0;
+  for (uint16_t i = 0; i < NUM_TRANSFERS; i++) {
+    WireAlt.beginTransmission(DS1307_I2C_ADDRESS);
+    WireAlt.write((uint8_t)0);
+    if (WireAlt.endTransmission(false) != 0 ||
+        WireAlt.requestFrom(DS1307_I2C_ADDRESS, COUNT) != COUNT) {
+      Serial.print("requestFrom failed, rtn: ");
+      Serial.println(WireAlt.rtn());
+      return;
+    }
+    uint32_t c = DWT->CYCCNT;
+    if (bulk) {
+      WireAlt.readBytes(buf, COUNT);
+    } else {
+      for (size_t n = 0; n < COUNT; n++) {
+        buf[n] = s.read();
+      }
+    }
+    cycles += DWT->CYCCNT - c;
+  }
+  printResult(bulk ? "readBytes" : "read()", cycles);
+}
+//-----------------------------------------------------------------------------
+void setup() {
+  Serial.begin(9600);
+  while (!Serial.available()) {
+    Serial.println("Type any character");
+    for (int i = 0; !Serial.available() && i < 20; i++) {
+      delay(100);
+    }
+  }
+  /* Enable cycle counter */
+  CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+  DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+}
+//-----------------------------------------------------------------------------
+void loop() {
+  do {delay(10);} while (Serial.read() >= 0);
+  Serial.println("Type any character to run benchmark");
+  while (Serial.read() < 0) {
+    delay(10);
+  }
+  WireAlt.begin();
+  Serial.print(COUNT);
+  Serial.println(" byte transfers");
+  benchWrite(false);
+  benchWrite(true);
+  benchRead(false);
+  benchRead(true);
+  Serial.println();
+  WireAlt.end();
+}
@@ -25,10 +25,137 @@
 #include "pinmap_impl.h"
 #include <stddef.h>
 
+/** Nonzero if the DMA functions use DMA. Zero if they use polled I/O. */
+#define I2C_DMA_SUPPORT (PLATFORM_ID > 3)
+
+#ifndef I2C_FLAG_TIMEOUT_MICROS
+/** Default time to wait for a bus event flag in microseconds. */
+#define I2C_FLAG_TIMEOUT_MICROS 2000
+#endif  // I2C_FLAG_TIMEOUT_MICROS
+
+#ifndef I2C_BUSY_TIMEOUT_MICROS
+/** Default time to wait for the bus to be free in microseconds. */
+#define I2C_BUSY_TIMEOUT_MICROS 25000
+#endif  // I2C_BUSY_TIMEOUT_MICROS
+
+#ifndef I2C_STATS_ENABLE
+/** Set nonzero to collect per interface statistics. */
+#define I2C_STATS_ENABLE 0
+#endif  // I2C_STATS_ENABLE
+
+/** Timeout for i2c_lock_timeout() that never expires. */
+#define I2C_LOCK_FOREVER 0XFFFFFFFF
+
+/** Bus lock statistics. */
+typedef struct i2c_lock_stats {
+  /** Number of times the lock was taken. */
+  uint32_t locks;
+  /** Number of times a thread waited for the lock. */
+  uint32_t contended;
+  /** Maximum hold time in microseconds. */
+  uint32_t maxHoldMicros;
+  /** Sum of hold times in microseconds. */
+  uint64_t totalHoldMicros;
+} i2c_lock_stats;
+
+/** Number of log2 latency histogram buckets. */
+#define I2C_STATS_BUCKETS 16
+
+/** Per interface statistics.  Only collected if I2C_STATS_ENABLE is nonzero. */
+typedef struct i2c_stats {
+  /** Number of transfers. */
+  uint32_t transactions;
+  /** Number of bytes transferred by successful transfers. */
+  uint32_t bytes;
+  /** Number of NACK errors. */
+  uint32_t nacks;
+  /** Number of timeout errors. */
+  uint32_t timeouts;
+  /** Number of bus or arbitration errors. */
+  uint32_t busErrors;
+  /** Number of argument errors. */
+  uint32_t argErrors;
+  /** Minimum transfer time in microseconds. */
+  uint32_t minMicros;
+  /** Maximum transfer time in microseconds. */
+  uint32_t maxMicros;
+  /** Sum of transfer times in microseconds.  Mean is totalMicros/transactions. */
+  uint64_t totalMicros;
+  /** Bucket n counts transfers with time in [2^(n-1), 2^n) microseconds.
+   *  The last bucket also counts longer transfers.
+   */
+  uint32_t histogram[I2C_STATS_BUCKETS];
+} i2c_stats;
+
+#ifndef I2C_TRACE_ENABLE
+/** Set nonzero to record bus events in the trace buffer. */
+#define I2C_TRACE_ENABLE 0
+#endif  // I2C_TRACE_ENABLE
+
+#ifndef I2C_TRACE_SIZE
+/** Number of events in the trace buffer.  Must be a power of two. */
+#define I2C_TRACE_SIZE 256
+#endif  // I2C_TRACE_SIZE
+
+/** Trace event types. */
+/** Start or repeated start generated. */
+#define I2C_TRACE_START     1
+/** Address sent and acknowledged.  Data is address with R/W bit. */
+#define I2C_TRACE_ADDR_ACK  2
+/** Address sent and not acknowledged.  Data is address with R/W bit. */
+#define I2C_TRACE_ADDR_NACK 3
+/** Timeout in address phase.  Data is address with R/W bit. */
+#define I2C_TRACE_TIMEOUT   4
+/** Data phase done.  Data is the byte count. */
+#define I2C_TRACE_DATA      5
+/** Stop generated. */
+#define I2C_TRACE_STOP      6
+/** Transfer failed.  Data is the negated return value. */
+#define I2C_TRACE_ERROR     7
+
+/** Trace buffer entry. */
+typedef struct i2c_trace_event {
+  /** DWT cycle counter at the time of the event. */
+  uint32_t cycles;
+  /** Event type. */
+  uint8_t  type;
+  /** I2C peripheral number. */
+  uint8_t  bus;
+  /** Event data. */
+  uint16_t data;
+} i2c_trace_event;
+
+/** i2c_segment flag for a read segment.  Segments are writes by default. */
+#define I2C_SEG_READ    0X01
+
+/** i2c_segment flag to continue the previous write without a start.
+ *  Allows a register address and data to be sent from separate buffers.
+ */
+#define I2C_SEG_NOSTART 0X02
+
+/** One segment of a combined transfer, similar to Linux struct i2c_msg. */
+typedef struct i2c_segment {
+  /** Right justified 7-bit address. */
+  uint8_t addr;
+  /** Zero or more of I2C_SEG_READ and I2C_SEG_NOSTART. */
+  uint8_t flags;
+  /** Data to send or buffer for received data. */
+  void*   buf;
+  /** Number of bytes to transfer. */
+  size_t  len;
+} i2c_segment;
+
+/** Function called by the interrupt handler when an interrupt driven
+ *  transfer finishes.  rtn is the value i2c_wait() will return.
+ */
+typedef void (*i2c_callback)(HAL_I2C_Interface i2cIf, int rtn);
+
 #ifdef __cplusplus
 extern "C" {
 #endif
 
+//-----------------------------------------------------------------------------
+// Setup.
 /** Initialize the I2C peripheral. It sets the default parameters for I2C
  * peripheral, and configures its specifieds pins.
  *
@@ -39,7 +166,6 @@ extern "C" {
  */
 int i2c_begin(HAL_I2C_Interface i2cIf, uint32_t hz);
 
-
 int i2c_end(HAL_I2C_Interface i2cIf);
 
 /** Set the I2C frequency.
@@ -51,14 +177,23 @@ int i2c_end(HAL_I2C_Interface i2cIf);
  */
 int i2c_frequency(HAL_I2C_Interface i2cIf, uint32_t hz);
 
-/** Genetate a stop condition.
+/** Set timeouts.
+ *
+ * Timeouts are measured with the microsecond timer so they do not depend
+ * on CPU clock or compiler options.
  *
  * @param[in] i2cIf The I2C interface.
+ * @param[in] flagUs Time to wait for a bus event flag in microseconds.
+ *                   Zero selects I2C_FLAG_TIMEOUT_MICROS.
+ * @param[in] busyUs Time to wait for the bus to be free in microseconds.
+ *                   Zero selects I2C_BUSY_TIMEOUT_MICROS.
  *
  * @return Error if less than zero else success.
  */
-int  i2c_stop(HAL_I2C_Interface i2cIf);
+int i2c_timeout(HAL_I2C_Interface i2cIf, uint32_t flagUs, uint32_t busyUs);
 
+//-----------------------------------------------------------------------------
+// Polled transfers.
 /** Blocking reading data
  *
  * @param[in] i2cIf The I2C interface.
@@ -71,6 +206,22 @@ int  i2c_stop(HAL_I2C_Interface i2cIf);
  */
 int i2c_read(HAL_I2C_Interface i2cIf, uint8_t address, void *buf, size_t count, int stop);
 
+/** Genetate a stop condition.
+ *
+ * @param[in] i2cIf The I2C interface.
+ *
+ * @return Error if less than zero else success.
+ */
+int  i2c_stop(HAL_I2C_Interface i2cIf);
+
+/** Check for a stop condition that has not been sent.
+ *
+ * @param[in] i2cIf The I2C interface.
+ *
+ * @return One if stop is pending, zero if not, error if less than zero.
+ */
+int i2c_stop_pending(HAL_I2C_Interface i2cIf);
+
 /** Write with start.
  *
  * @param[in] i2cIf The I2C interface
@@ -93,6 +244,393 @@ int i2c_write(HAL_I2C_Interface i2cIf, uint8_t address, const void *buf, size_t
  * @return Error if less than zero else success.
  */
 int i2c_write_data(HAL_I2C_Interface i2cIf, const void* buf, size_t count, int stop);
+
+/** Run a list of segments with a repeated start between segments.
+ *
+ * @param[in] i2cIf The I2C interface.
+ * @param[in] seg Array of segments.
+ * @param[in] count Number of segments.
+ * @param[in] stop If non-zero, generate stop after the last segment.
+ *
+ * @return Error if less than zero else the total number of bytes transferred.
+ */
+int i2c_transfer(HAL_I2C_Interface i2cIf, const i2c_segment* seg, size_t count, int stop);
+
+/** Write then read with a repeated start between the two phases.
+ *
+ * Typically used to send a register address and read register data.
+ *
+ * @param[in] i2cIf The I2C interface.
+ * @param[in] address Right justified 7-bit address.
+ * @param[in] txBuf The buffer for sending.
+ * @param[in] txCount Number of bytes to write.
+ * @param[out] rxBuf The buffer for receiving.
+ * @param[in] rxCount Number of bytes to read.
+ * @param[in] stop If non-zero, generated after the read is done.
+ *
+ * @return Error if less than zero else the number of bytes read.
+ */
+int i2c_write_read(HAL_I2C_Interface i2cIf, uint8_t address,
+                   const void* txBuf, size_t txCount,
+                   void* rxBuf, size_t rxCount, int stop);
+
+/** Probe an address with a quick write, start, address and stop.
+ *
+ * A NACK ends the probe as soon as AF is set, so an absent device costs
+ * about one address byte on the bus instead of a flag timeout.
+ *
+ * @param[in] i2cIf The I2C interface.
+ * @param[in] address Right justified 7-bit address.
+ *
+ * @return Error if less than zero, one if the address was acknowledged
+ *         else zero.
+ */
+int i2c_probe(HAL_I2C_Interface i2cIf, uint8_t address);
+
+/** Probe addresses with i2c_probe() and set a bit for each device found.
+ *
+ * Bit (address & 7) of bitmap[address >> 3] is set if address responds.
+ *
+ * @param[in] i2cIf The I2C interface.
+ * @param[out] bitmap Presence bitmap, 16 bytes.  Cleared before the scan.
+ * @param[in] candidates Addresses to probe.  If NULL, probe 0X08 through
+ *                       0X77, all addresses that are not reserved.
+ * @param[in] count Number of candidates.
+ *
+ * @return Error if less than zero else the number of devices found.
+ */
+int i2c_scan(HAL_I2C_Interface i2cIf, uint8_t* bitmap,
+             const uint8_t* candidates, size_t count);
+
+//-----------------------------------------------------------------------------
+// Bus lock.
+/** Lock the bus.  Waiting threads block on a mutex, so the highest
+ * priority waiter gets the lock next and the holder inherits its priority.
+ *
+ * The lock is not recursive and must not be used in an interrupt.
+ * Interfaces that share a peripheral share a lock.  Without threading
+ * the lock fails if it is already held.
+ *
+ * @param[in] i2cIf The I2C interface.
+ *
+ * @return Error if less than zero else success.
+ */
+int i2c_lock(HAL_I2C_Interface i2cIf);
+
+/** Lock the bus, giving up after a timeout.  The lock is retried every
+ * millisecond, with the caller sleeping between attempts.
+ *
+ * @param[in] i2cIf The I2C interface.
+ * @param[in] ms Maximum wait in milliseconds.  I2C_LOCK_FOREVER is the
+ *               same as i2c_lock().
+ *
+ * @return Error if less than zero else success.  A timeout returns an
+ *         error in the I2C_ERROR_TIMEOUT class.
+ */
+int i2c_lock_timeout(HAL_I2C_Interface i2cIf, uint32_t ms);
+
+/** Get bus lock statistics.
+ *
+ * @param[in] i2cIf The I2C interface.
+ * @param[out] stats Location for statistics.
+ *
+ * @return Error if less than zero else success.
+ */
+int i2c_get_lock_stats(HAL_I2C_Interface i2cIf, i2c_lock_stats* stats);
+
+/** Lock the bus if it is free.
+ *
+ * @param[in] i2cIf The I2C interface.
+ *
+ * @return One if locked, zero if the bus is locked by another thread,
+ *         error if less than zero.
+ */
+int i2c_try_lock(HAL_I2C_Interface i2cIf);
+
+/** Unlock the bus.  Call from the thread that holds the lock.
+ *
+ * @param[in] i2cIf The I2C interface.
+ *
+ * @return Error if less than zero else success.
+ */
+int i2c_unlock(HAL_I2C_Interface i2cIf);
+
+//-----------------------------------------------------------------------------
+// Bus recovery.
+/** Enable or disable automatic bus recovery.  If enabled, i2c_recover()
+ * is called after a transfer fails with a timeout or bus error.
+ *
+ * @param[in] i2cIf The I2C interface.
+ * @param[in] enable Nonzero to enable automatic recovery.
+ *
+ * @return Error if less than zero else success.
+ */
+int i2c_auto_recover(HAL_I2C_Interface i2cIf, int enable);
+
+/** Recover a bus held low by a slave.  SCL is clocked as a GPIO pin
+ * until the slave releases SDA, then a stop is generated and the
+ * peripheral is reset.  Transfers in progress are aborted.  An interrupt
+ * driven transfer finishes with a bus error and its callback is called.
+ *
+ * Recovery does not take the bus lock.  If other threads use the
+ * interface, the caller must hold it.  Automatic recovery runs in the
+ * thread whose transfer failed.
+ *
+ * @param[in] i2cIf The I2C interface.
+ *
+ * @return Error if less than zero or the bus is still held low
+ *         else success.
+ */
+int i2c_recover(HAL_I2C_Interface i2cIf);
+
+/** Get bus recovery counts.
+ *
+ * @param[in] i2cIf The I2C interface.
+ * @param[out] recoveries Number of successful recoveries.  May be NULL.
+ * @param[out] failures Number of recoveries that left the bus held low.
+ *                      May be NULL.
+ *
+ * @return Error if less than zero else success.
+ */
+int i2c_recover_counts(HAL_I2C_Interface i2cIf,
+                       uint32_t* recoveries, uint32_t* failures);
+
+//-----------------------------------------------------------------------------
+// Statistics.
+/** Clear statistics.
+ *
+ * @param[in] i2cIf The I2C interface.
+ *
+ * @return Error if less than zero or I2C_STATS_ENABLE is zero else success.
+ */
+int i2c_reset_stats(HAL_I2C_Interface i2cIf);
+
+/** Get statistics.
+ *
+ * @param[in] i2cIf The I2C interface.
+ * @param[out] stats Location for statistics.
+ *
+ * @return Error if less than zero or I2C_STATS_ENABLE is zero else success.
+ */
+int i2c_get_stats(HAL_I2C_Interface i2cIf, i2c_stats* stats);
+
+//-----------------------------------------------------------------------------
+// Trace.
+/** Number of trace events lost because the trace buffer was full.
+ *
+ * @return Count of dropped events.
+ */
+uint32_t i2c_trace_dropped(void);
+
+/** Remove events from the trace buffer.
+ *
+ * The trace buffer has a single consumer.  It may be drained from any
+ * context while transfers are running.  Producers do not disable
+ * interrupts.  An event that is reserved but not yet written stops the
+ * read until its producer resumes.
+ *
+ * @param[out] buf Location for events.
+ * @param[in] count Maximum number of events to remove.
+ *
+ * @return The number of events returned.  Zero if I2C_TRACE_ENABLE is zero.
+ */
+size_t i2c_trace_read(i2c_trace_event* buf, size_t count);
+
+//-----------------------------------------------------------------------------
+// DMA transfers.
+/** Start a DMA read.
+ *
+ * The address phase is polled. Data is transferred by DMA and the
+ * LAST bit causes a NACK for the final byte.  Call i2c_dma_wait() to
+ * complete the transfer.  A one byte read is done with i2c_read().
+ *
+ * @param[in] i2cIf The I2C interface.
+ * @param[in] address Right justified 7-bit address.
+ * @param[out] buf The buffer for receiving.
+ * @param[in] count Number of bytes to read, at most 65535.
+ * @param[in] stop If non-zero, generated after the transfer is done.
+ *
+ * @return Error if less than zero else success.
+ */
+int i2c_read_dma(HAL_I2C_Interface i2cIf, uint8_t address, void *buf, size_t count, int stop);
+
+/** Start a DMA write.
+ *
+ * The address phase is polled.  Data is transferred by DMA.
+ * Call i2c_dma_wait() to complete the transfer.
+ *
+ * @param[in] i2cIf The I2C interface.
+ * @param[in] address Right justified 7-bit address.
+ * @param[in] buf The buffer for sending.
+ * @param[in] count Number of bytes to write, at most 65535.
+ * @param[in] stop If non-zero, generate stop condition.
+ *
+ * @return Error if less than zero else success.
+ */
+int i2c_write_dma(HAL_I2C_Interface i2cIf, uint8_t address, const void *buf, size_t count, int stop);
+
+/** Check for DMA transfer done.
+ *
+ * @param[in] i2cIf The I2C interface.
+ *
+ * @return One if i2c_dma_wait() will not block for data, zero if the
+ *         transfer is active, error if less than zero.
+ */
+int i2c_dma_done(HAL_I2C_Interface i2cIf);
+
+/** Wait for a DMA transfer to finish and generate stop if requested.
+ *
+ * @param[in] i2cIf The I2C interface.
+ *
+ * @return Error if less than zero else the number of bytes transferred.
+ */
+int i2c_dma_wait(HAL_I2C_Interface i2cIf);
+
+//-----------------------------------------------------------------------------
+// Interrupt driven transfers.
+/** Start an interrupt driven read.
+ *
+ * The transfer runs in the I2C event and error interrupts.
+ * Call i2c_done() to check for completion and i2c_wait() for the result.
+ *
+ * @param[in] i2cIf The I2C interface.
+ * @param[in] address Right justified 7-bit address.
+ * @param[out] buf The buffer for receiving.
+ * @param[in] count Number of bytes to read.
+ * @param[in] stop If non-zero, generated after the transfer is done.
+ *
+ * @return Error if less than zero else success.
+ */
+int i2c_start_read(HAL_I2C_Interface i2cIf, uint8_t address, void *buf, size_t count, int stop);
+
+/** Start an interrupt driven write.
+ *
+ * @param[in] i2cIf The I2C interface.
+ * @param[in] address Right justified 7-bit address.
+ * @param[in] buf The buffer for sending.
+ * @param[in] count Number of bytes to write.
+ * @param[in] stop If non-zero, generate stop condition.
+ *
+ * @return Error if less than zero else success.
+ */
+int i2c_start_write(HAL_I2C_Interface i2cIf, uint8_t address, const void *buf, size_t count, int stop);
+
+/** Abort an interrupt driven transfer without waiting.
+ *
+ * Interrupts for the transfer are disabled, stop is generated and the
+ * transfer finishes with a timeout error.  The callback is called with
+ * interrupts disabled.  A stream is stopped.
+ *
+ * @param[in] i2cIf The I2C interface.
+ *
+ * @return One if a transfer was aborted, zero if none was active,
+ *         error if less than zero.
+ */
+int i2c_abort(HAL_I2C_Interface i2cIf);
+
+/** Check for interrupt driven transfer done.
+ *
+ * A transfer that has run longer than its transfer timeout is aborted
+ * with i2c_abort() and reported done.
+ *
+ * @param[in] i2cIf The I2C interface.
+ *
+ * @return One if done, zero if active, error if less than zero.
+ */
+int i2c_done(HAL_I2C_Interface i2cIf);
+
+/** Set the function called when an interrupt driven transfer finishes.
+ *
+ * The callback runs in the I2C interrupt and may start the next transfer
+ * if i2c_stop_pending() is zero.  Otherwise the start would wait for the
+ * stop condition in the interrupt.  Transfers that time out are aborted
+ * by i2c_done() or i2c_wait() and the callback runs in the caller with
+ * I2C_ERROR_TIMEOUT.
+ *
+ * There is one callback for each interface.  I2cMaster::readAsync() and
+ * I2cMaster::writeAsync() install their own the first time they are used.
+ *
+ * @param[in] i2cIf The I2C interface.
+ * @param[in] callback The function or NULL for no callback.
+ *
+ * @return Error if less than zero else success.
+ */
+int i2c_set_callback(HAL_I2C_Interface i2cIf, i2c_callback callback);
+
+/** Wait for an interrupt driven transfer to finish.  A transfer or
+ *  stream that times out is stopped as by i2c_abort().
+ *
+ * @param[in] i2cIf The I2C interface.
+ *
+ * @return Error if less than zero else the number of bytes transferred.
+ */
+int i2c_wait(HAL_I2C_Interface i2cIf);
+
+//-----------------------------------------------------------------------------
+// Streaming.
+/** Start streaming frames into a ring buffer.
+ *
+ * The interrupt handler repeats a register write and a read of frameSize
+ * bytes with repeated starts between transfers.  If the ring is full the
+ * bus is released and streaming resumes when a frame is popped.  Frames
+ * that would have been read while the bus was released are counted by
+ * i2c_stream_overruns().  Other transfers on the interface fail while
+ * the stream is active.
+ *
+ * @param[in] i2cIf The I2C interface.
+ * @param[in] address Right justified 7-bit address.
+ * @param[in] reg Register written before each frame.
+ * @param[in] buf Ring buffer of frameSize*frameCount bytes.
+ * @param[in] frameSize Number of bytes in a frame.
+ * @param[in] frameCount Number of frames in the ring.  Must be a power of two.
+ *
+ * @return Error if less than zero else success.
+ */
+int i2c_stream_start(HAL_I2C_Interface i2cIf, uint8_t address, uint8_t reg,
+                     void* buf, size_t frameSize, size_t frameCount);
+
+/** Number of frames available to i2c_stream_pop().
+ *
+ * @param[in] i2cIf The I2C interface.
+ *
+ * @return Error if less than zero, for example if the stream stopped
+ *         with an error and the ring is empty, else the number of frames.
+ */
+int i2c_stream_available(HAL_I2C_Interface i2cIf);
+
+/** Number of frames dropped because the ring was full.
+ *
+ * Each pause counts the frame that was due when the ring filled and one
+ * more for each frame time, measured from the last frame, until a frame
+ * is popped or the stream is stopped.
+ *
+ * @param[in] i2cIf The I2C interface.
+ *
+ * @return Error if less than zero else the overrun count.
+ */
+int i2c_stream_overruns(HAL_I2C_Interface i2cIf);
+
+/** Remove the oldest frame from the ring.  Lock-free with a single consumer.
+ *
+ * If the stream is paused the bus is restarted.  The wait for the stop
+ * that released the bus runs with interrupts enabled.
+ *
+ * @param[in] i2cIf The I2C interface.
+ * @param[out] frame Location for frameSize bytes.
+ *
+ * @return One if a frame was copied, zero if the ring is empty,
+ *         error if less than zero.
+ */
+int i2c_stream_pop(HAL_I2C_Interface i2cIf, void* frame);
+
+/** Stop streaming after the current transfer.  Frames in the ring
+ *  remain available to i2c_stream_pop().
+ *
+ * @param[in] i2cIf The I2C interface.
+ *
+ * @return Error if less than zero else success.
+ */
+int i2c_stream_stop(HAL_I2C_Interface i2cIf);
 #ifdef __cplusplus
 }
 #endif  // __cplusplus
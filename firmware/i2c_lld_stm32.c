@@ -18,16 +18,17 @@
  * <http://www.gnu.org/licenses/>.
  */
 #include "i2c_lld.h"
+#include "interrupts_hal.h"
+#include <string.h>
+#if PLATFORM_THREADING
+#include "concurrent_hal.h"
+#include "delay_hal.h"
+#endif  // PLATFORM_THREADING
 
-#define I2C_ERROR_ARG         (-(10000 + __LINE__))
-#define I2C_ERROR_TIMEOUT     (-(20000 + __LINE__))
-#define I2C_ERROR_ACK_FAILURE (-(30000 + __LINE__))
-
-/* Timeout values for flags and events waiting loops. These timeouts are
-   not based on accurate values, they just guarantee that the application will
-   not remain stuck if the I2C communication is corrupted. */
-#define FLAG_TIMEOUT ((int)0x1000)
-#define LONG_TIMEOUT ((int)0x8000)
+/* Timeouts in microseconds for flags and events waiting loops.  A zero
+   value in the interface state selects the default. */
+#define FLAG_TIMEOUT(s) ((s)->flagTimeout ? (s)->flagTimeout : I2C_FLAG_TIMEOUT_MICROS)
+#define LONG_TIMEOUT(s) ((s)->busyTimeout ? (s)->busyTimeout : I2C_BUSY_TIMEOUT_MICROS)
 //-----------------------------------------------------------------------------
 typedef struct STM32_I2C_Info {
   I2C_TypeDef*   i2c;
@@ -36,8 +37,101 @@ typedef struct STM32_I2C_Info {
   uint16_t       sdaPin;
   uint16_t       sclPin;
   uint8_t        pinAf;
+  IRQn_Type      evIrqn;
+  IRQn_Type      erIrqn;
+  void           (*evHandler)(void);
+  void           (*erHandler)(void);
+#if I2C_DMA_SUPPORT
+  DMA_Stream_TypeDef* rxStream;
+  uint32_t       rxChannel;
+  uint32_t       rxFlags;
+  DMA_Stream_TypeDef* txStream;
+  uint32_t       txChannel;
+  uint32_t       txFlags;
+#endif  // I2C_DMA_SUPPORT
 } STM32_I2C_Info;
 
+// Run time state for an I2C interface.
+typedef struct STM32_I2C_State {
+  uint32_t hz;
+  uint32_t flagTimeout;
+  uint32_t busyTimeout;
+  size_t   dmaCount;
+  int      dmaRtn;
+  uint8_t  dmaActive;
+  uint8_t  dmaRead;
+  uint8_t  dmaStop;
+  uint8_t  irqInstalled;
+  uint8_t  irqRead;
+  uint8_t  irqStop;
+  uint8_t  irqAddress;
+  uint8_t  irqData;
+  uint8_t* irqBuf;
+  size_t   irqCount;
+  size_t   irqIndex;
+  volatile int     irqRtn;
+  volatile uint8_t irqActive;
+  uint8_t  irqRecover;
+  uint32_t irqMicros;
+  i2c_callback irqCallback;
+  uint8_t  streamActive;
+  uint8_t  streamAddress;
+  uint8_t  streamReg;
+  volatile uint8_t streamPaused;
+  volatile uint8_t streamStop;
+  uint8_t* streamBuf;
+  size_t   streamFrameSize;
+  uint32_t streamMask;
+  volatile uint32_t streamHead;
+  volatile uint32_t streamTail;
+  volatile uint32_t streamOverruns;
+  uint32_t streamFrameStart;
+  uint32_t streamFrameMicros;
+  uint32_t streamPauseMicros;
+  volatile uint32_t lockNext;
+  volatile uint32_t lockServing;
+  volatile uint8_t lockHeld;
+#if PLATFORM_THREADING
+  os_mutex_t lockMutex;
+#endif  // PLATFORM_THREADING
+  uint32_t lockMicros;
+  i2c_lock_stats lockStats;
+  uint8_t  autoRecover;
+  uint32_t recoveries;
+  uint32_t recoverFailures;
+#if I2C_STATS_ENABLE
+  uint32_t  statsMicros;
+  i2c_stats stats;
+#endif  // I2C_STATS_ENABLE
+} STM32_I2C_State;
+
+// Interrupt handlers for I2C1 and I2C3.
+static void i2c1EvIrq(void);
+static void i2c1ErIrq(void);
+#define I2C1_IRQ I2C1_EV_IRQn, I2C1_ER_IRQn, i2c1EvIrq, i2c1ErIrq
+#if PLATFORM_ID == 10 && defined(PM_SDA_UC) && defined(PM_SCL_UC)
+static void i2c3EvIrq(void);
+static void i2c3ErIrq(void);
+#define I2C3_IRQ I2C3_EV_IRQn, I2C3_ER_IRQn, i2c3EvIrq, i2c3ErIrq
+#endif  // PLATFORM_ID == 10 && defined(PM_SDA_UC) && defined(PM_SCL_UC)
+
+#if I2C_DMA_SUPPORT
+// All event flags for a DMA stream.
+#define DMA_STREAM0_FLAGS (DMA_FLAG_FEIF0 | DMA_FLAG_DMEIF0 | DMA_FLAG_TEIF0 |\
+                           DMA_FLAG_HTIF0 | DMA_FLAG_TCIF0)
+#define DMA_STREAM2_FLAGS (DMA_FLAG_FEIF2 | DMA_FLAG_DMEIF2 | DMA_FLAG_TEIF2 |\
+                           DMA_FLAG_HTIF2 | DMA_FLAG_TCIF2)
+#define DMA_STREAM4_FLAGS (DMA_FLAG_FEIF4 | DMA_FLAG_DMEIF4 | DMA_FLAG_TEIF4 |\
+                           DMA_FLAG_HTIF4 | DMA_FLAG_TCIF4)
+#define DMA_STREAM6_FLAGS (DMA_FLAG_FEIF6 | DMA_FLAG_DMEIF6 | DMA_FLAG_TEIF6 |\
+                           DMA_FLAG_HTIF6 | DMA_FLAG_TCIF6)
+// DMA1 request mapping for I2C1 and I2C3.
+#define I2C1_DMA DMA1_Stream0, DMA_Channel_1, DMA_STREAM0_FLAGS,\
+                 DMA1_Stream6, DMA_Channel_1, DMA_STREAM6_FLAGS
+#define I2C3_DMA DMA1_Stream2, DMA_Channel_3, DMA_STREAM2_FLAGS,\
+                 DMA1_Stream4, DMA_Channel_3, DMA_STREAM4_FLAGS
+#endif  // I2C_DMA_SUPPORT
+
 /*
  * I2C mapping
  */
@@ -45,55 +139,153 @@ typedef struct STM32_I2C_Info {
 static STM32_I2C_Info I2C_MAP[] = {
 #if PLATFORM_ID < 3
   // Core
-  {I2C1, &RCC->APB1ENR, RCC_APB1Periph_I2C1, D0, D1, 0}
+  {I2C1, &RCC->APB1ENR, RCC_APB1Periph_I2C1, D0, D1, 0, I2C1_IRQ}
 #else  // PLATFORM_ID < 3
   // Photon or Electron
-  {I2C1, &RCC->APB1ENR, RCC_APB1Periph_I2C1, D0, D1, GPIO_AF_I2C1}
+  {I2C1, &RCC->APB1ENR, RCC_APB1Periph_I2C1, D0, D1, GPIO_AF_I2C1, I2C1_IRQ, I2C1_DMA}
 #endif  // PLATFORM_ID < 3
 #if PLATFORM_ID == 10
   // Electron
-  ,{I2C1, &RCC->APB1ENR, RCC_APB1Periph_I2C1, C4, C5, GPIO_AF_I2C1}
+  ,{I2C1, &RCC->APB1ENR, RCC_APB1Periph_I2C1, C4, C5, GPIO_AF_I2C1, I2C1_IRQ, I2C1_DMA}
 #if defined(PM_SDA_UC) && defined(PM_SCL_UC)
   // Probably won't be supported in released Electron.
   ,{I2C3, &RCC->APB1ENR, RCC_APB1Periph_I2C3,
-    PM_SDA_UC, PM_SCL_UC, GPIO_AF_I2C3}
+    PM_SDA_UC, PM_SCL_UC, GPIO_AF_I2C3, I2C3_IRQ, I2C3_DMA}
 #endif  // defined(PM_SDA_UC) && defined(PM_SCL_UC)
 #endif  // #if PLATFORM_ID < 3
 };
 //-----------------------------------------------------------------------------
 #define N_I2C_IF  (sizeof(I2C_MAP)/sizeof(STM32_I2C_Info))
+
+static STM32_I2C_State I2C_STATE[N_I2C_IF];
+
+static void irqDone(I2C_TypeDef* i2c, STM32_I2C_State* s, int rtn);
+static void irqRestore(STM32_I2C_Info* p, STM32_I2C_State* s);
+static int autoRecover(HAL_I2C_Interface i2cIf, int rtn);
 //-----------------------------------------------------------------------------
-// Clear ADDR by reading SR1 register followed by reading SR2.
-static void clearAddrFlag(I2C_TypeDef* i2c) {
-  __IO uint32_t tmpreg = 0x00;
-  tmpreg = i2c->SR1;
-  tmpreg = i2c->SR2;
-  (void)tmpreg;
+#if I2C_TRACE_ENABLE
+// A slot is published when seq is one more than its ring position.
+typedef struct TraceSlot {
+  volatile uint32_t seq;
+  i2c_trace_event ev;
+} TraceSlot;
+static TraceSlot traceBuf[I2C_TRACE_SIZE];
+// Producers reserve slots by compare and swap on traceHead.  traceTail
+// is only written by the consumer.
+static volatile uint32_t traceHead;
+static volatile uint32_t traceTail;
+static volatile uint32_t traceDropped;
+
+static void tracePut(I2C_TypeDef* i2c, uint8_t type, uint16_t data) {
+  uint32_t cycles = DWT->CYCCNT;
+  uint32_t head = __atomic_load_n(&traceHead, __ATOMIC_RELAXED);
+  do {
+    if ((head - __atomic_load_n(&traceTail, __ATOMIC_ACQUIRE)) >= I2C_TRACE_SIZE) {
+      __atomic_fetch_add(&traceDropped, 1, __ATOMIC_RELAXED);
+      return;
+    }
+  } while (!__atomic_compare_exchange_n(&traceHead, &head, head + 1, 1,
+                                        __ATOMIC_RELAXED, __ATOMIC_RELAXED));
+  TraceSlot* slot = &traceBuf[head & (I2C_TRACE_SIZE - 1)];
+  slot->ev.cycles = cycles;
+  slot->ev.type = type;
+  slot->ev.bus = i2c == I2C1 ? 1 : 3;
+  slot->ev.data = data;
+  /* Publish the event.  A preempted producer delays the consumer but
+   * never blocks other producers. */
+  __atomic_store_n(&slot->seq, head + 1, __ATOMIC_RELEASE);
 }
 
-static int waitForStopCondition(I2C_TypeDef* i2c) {
-  int timeout = FLAG_TIMEOUT;
-  while (i2c->CR1 & I2C_CR1_STOP) {
-    if (--timeout <= 0) return 0;
+// Record errors returned by transfer functions.
+static int traceResult(HAL_I2C_Interface i2cIf, int rtn) {
+  if (rtn < 0 && i2cIf < N_I2C_IF) {
+    tracePut(I2C_MAP[i2cIf].i2c, I2C_TRACE_ERROR, -rtn);
   }
-  return 1;
+  return rtn;
 }
+#define TRACE(i2c, type, data) tracePut(i2c, type, data)
+#define TRACE_RESULT(i2cIf, rtn) traceResult(i2cIf, rtn)
+#else  // I2C_TRACE_ENABLE
+#define TRACE(i2c, type, data)
+#define TRACE_RESULT(i2cIf, rtn) (rtn)
+#endif  // I2C_TRACE_ENABLE
 
-static int waitUntilBitSetSR1(I2C_TypeDef* i2c, uint32_t bit) {
-  int timeout = FLAG_TIMEOUT;
-  do {
-    if (i2c->SR1 & bit) return 1;
-  } while (timeout--);
-  return 0;
-}
+// Register level primitives shared with I2cMasterT.  Keep the error macros.
+#define I2C_LLD_SOURCE
+#define I2C_LLD_TRACE(i2c, type, data) TRACE(i2c, type, data)
+#include "i2c_lld_stm32.h"
+//-----------------------------------------------------------------------------
+#if I2C_STATS_ENABLE
+#define STATS_START(m) uint32_t m = HAL_Timer_Get_Micro_Seconds()
+#define RECORD_RESULT(i2cIf, m, rtn) statsRecord(i2cIf, m, TRACE_RESULT(i2cIf, rtn))
+#define STATS_SAVE_START(s) (s)->statsMicros = HAL_Timer_Get_Micro_Seconds()
+#define STATS_RECORD_STATE(s, rtn)\
+  statsRecord((HAL_I2C_Interface)((s) - I2C_STATE), (s)->statsMicros, rtn)
 
-static int waitUntilNotBusy(I2C_TypeDef* i2c) {
-   int timeout = LONG_TIMEOUT;
-  while (i2c->SR2 & I2C_SR2_BUSY) {
-    if (--timeout <= 0) return 0;
+// Record the result and latency of a transfer.  Called from the interrupt
+// and from threads.
+static int statsRecord(HAL_I2C_Interface i2cIf, uint32_t start, int rtn) {
+  if (i2cIf >= N_I2C_IF) {
+    return rtn;
   }
-  return 1; 
+  i2c_stats* st = &I2C_STATE[i2cIf].stats;
+  uint32_t us = HAL_Timer_Get_Micro_Seconds() - start;
+  size_t bucket = us ? 32 - __builtin_clz(us) : 0;
+
+  if (bucket >= I2C_STATS_BUCKETS) {
+    bucket = I2C_STATS_BUCKETS - 1;
+  }
+  uint32_t primask = __get_PRIMASK();
+  __disable_irq();
+  st->histogram[bucket]++;
+  if (st->transactions == 0 || us < st->minMicros) {
+    st->minMicros = us;
+  }
+  if (us > st->maxMicros) {
+    st->maxMicros = us;
+  }
+  st->totalMicros += us;
+  st->transactions++;
+
+  /* Error class is encoded in the return value. */
+  if (rtn >= 0) {
+    st->bytes += rtn;
+  } else {
+    switch (-rtn/10000) {
+      case 1:
+        st->argErrors++;
+        break;
+
+      case 2:
+        st->timeouts++;
+        break;
+
+      case 3:
+        st->nacks++;
+        break;
+
+      default:
+        st->busErrors++;
+        break;
+    }
+  }
+  __set_PRIMASK(primask);
+  return rtn;
+}
+#else  // I2C_STATS_ENABLE
+#define STATS_START(m)
+#define RECORD_RESULT(i2cIf, m, rtn) TRACE_RESULT(i2cIf, rtn)
+#define STATS_SAVE_START(s)
+#define STATS_RECORD_STATE(s, rtn)
+#endif  // I2C_STATS_ENABLE
+//-----------------------------------------------------------------------------
+// Allow twice the nominal bus time plus the flag timeout.
+static uint32_t transferTimeoutMicros(STM32_I2C_State* s, size_t count) {
+  uint32_t hz = s->hz ? s->hz : 100000;
+  return 2*((9000000ULL*count)/hz) + FLAG_TIMEOUT(s);
 }
+//=============================================================================
+// Setup.
 //-----------------------------------------------------------------------------
 int i2c_begin(HAL_I2C_Interface i2cIf, uint32_t hz) {
   if (i2cIf >= N_I2C_IF) {
@@ -104,6 +296,17 @@ int i2c_begin(HAL_I2C_Interface i2cIf, uint32_t hz) {
   /* Enable I2C clock */
   *p->rccEnbReg |= p->rccEnbBit;
 
+#if I2C_DMA_SUPPORT
+  /* Enable DMA clock */
+  RCC->AHB1ENR |= RCC_AHB1Periph_DMA1;
+#endif  // I2C_DMA_SUPPORT
+
+#if I2C_TRACE_ENABLE
+  /* Enable cycle counter for trace time stamps */
+  CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+  DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+#endif  // I2C_TRACE_ENABLE
+
   /* Enable and Release I2C Reset State */
   I2C_DeInit(p->i2c);
 
@@ -130,7 +333,9 @@ int i2c_end(HAL_I2C_Interface i2cIf) {
   }
   STM32_I2C_Info* p = &I2C_MAP[i2cIf];
 
-  waitUntilNotBusy(p->i2c);
+  i2c_ll_wait_not_busy(p->i2c, LONG_TIMEOUT(&I2C_STATE[i2cIf]));
+
+  irqRestore(p, &I2C_STATE[i2cIf]);
 
   I2C_Cmd(p->i2c, DISABLE);
 
@@ -147,7 +352,7 @@ int i2c_frequency(HAL_I2C_Interface i2cIf, uint32_t hz) {
     return I2C_ERROR_ARG;
   }
   // wait before init
-  waitUntilNotBusy(p->i2c);
+  i2c_ll_wait_not_busy(p->i2c, LONG_TIMEOUT(&I2C_STATE[i2cIf]));
 
   // I2C configuration
   I2C_InitTypeDef I2C_InitStructure;
@@ -160,230 +365,1305 @@ int i2c_frequency(HAL_I2C_Interface i2cIf, uint32_t hz) {
 
   /* Apply I2C configuration */
   I2C_Init(p->i2c, &I2C_InitStructure);
+  I2C_STATE[i2cIf].hz = hz;
 
   return 0;
 }
 //-----------------------------------------------------------------------------
+int i2c_timeout(HAL_I2C_Interface i2cIf, uint32_t flagUs, uint32_t busyUs) {
+  if (i2cIf >= N_I2C_IF) {
+    return I2C_ERROR_ARG;
+  }
+  I2C_STATE[i2cIf].flagTimeout = flagUs;
+  I2C_STATE[i2cIf].busyTimeout = busyUs;
+  return 0;
+}
+//=============================================================================
+// Polled transfers.
+//-----------------------------------------------------------------------------
+static int readPolled(HAL_I2C_Interface i2cIf,
+                      uint8_t address, void *dst, size_t count, int stop) {
+  if (i2cIf >= N_I2C_IF) {
+    return I2C_ERROR_ARG;
+  }
+  return i2c_ll_master_read(I2C_MAP[i2cIf].i2c, address, dst, count, stop,
+                            FLAG_TIMEOUT(&I2C_STATE[i2cIf]));
+}
+//-----------------------------------------------------------------------------
 int i2c_read(HAL_I2C_Interface i2cIf,
              uint8_t address, void *dst, size_t count, int stop) {
+  STATS_START(m);
+  return autoRecover(i2cIf,
+    RECORD_RESULT(i2cIf, m, readPolled(i2cIf, address, dst, count, stop)));
+}
+//-----------------------------------------------------------------------------
+int i2c_stop(HAL_I2C_Interface i2cIf) {
+  if (i2cIf >= N_I2C_IF) {
+    return I2C_ERROR_ARG;
+  }
+  return i2c_ll_master_stop(I2C_MAP[i2cIf].i2c, FLAG_TIMEOUT(&I2C_STATE[i2cIf]));
+}
+//-----------------------------------------------------------------------------
+int i2c_stop_pending(HAL_I2C_Interface i2cIf) {
+  if (i2cIf >= N_I2C_IF) {
+    return I2C_ERROR_ARG;
+  }
+  return (I2C_MAP[i2cIf].i2c->CR1 & I2C_CR1_STOP) != 0;
+}
+//-----------------------------------------------------------------------------
+static int writePolled(HAL_I2C_Interface i2cIf, uint8_t address,
+                       const void *buf, size_t count, int stop) {
+  if (i2cIf >= N_I2C_IF) {
+    return I2C_ERROR_ARG;
+  }
+  return i2c_ll_master_write(I2C_MAP[i2cIf].i2c, address, buf, count, stop,
+                             FLAG_TIMEOUT(&I2C_STATE[i2cIf]));
+}
+//-----------------------------------------------------------------------------
+int i2c_write(HAL_I2C_Interface i2cIf, uint8_t address,
+              const void *buf, size_t count, int stop) {
+  STATS_START(m);
+  return autoRecover(i2cIf,
+    RECORD_RESULT(i2cIf, m, writePolled(i2cIf, address, buf, count, stop)));
+}
+//-----------------------------------------------------------------------------
+static int writeDataPolled(HAL_I2C_Interface i2cIf,
+                           const void* buf, size_t count, int stop) {
+  if (i2cIf >= N_I2C_IF) {
+    return I2C_ERROR_ARG;
+  }  
+  I2C_TypeDef* pI2c = I2C_MAP[i2cIf].i2c;  
+  uint32_t us = FLAG_TIMEOUT(&I2C_STATE[i2cIf]);
+   
+  return i2c_ll_write_data(pI2c, buf, count, stop, us);
+}
+//-----------------------------------------------------------------------------
+int i2c_write_data(HAL_I2C_Interface i2cIf, const void* buf, size_t count, int stop) {
+  STATS_START(m);
+  return autoRecover(i2cIf,
+    RECORD_RESULT(i2cIf, m, writeDataPolled(i2cIf, buf, count, stop)));
+}
+//-----------------------------------------------------------------------------
+static int transferPolled(HAL_I2C_Interface i2cIf,
+                          const i2c_segment* seg, size_t count, int stop) {
   if (i2cIf >= N_I2C_IF || count == 0) {
     return I2C_ERROR_ARG;
-  }              
-  I2C_TypeDef* pI2c = I2C_MAP[i2cIf].i2c;                 
-  uint8_t *pData = (uint8_t*)dst;
+  }
+  I2C_TypeDef* pI2c = I2C_MAP[i2cIf].i2c;
+  uint32_t us = FLAG_TIMEOUT(&I2C_STATE[i2cIf]);
+  const i2c_segment* begin = seg;
+  const i2c_segment* end = seg + count;
+  int total = 0;
+  int rtn;
 
-  /* Disable Pos */
-  pI2c->CR1 &= ~I2C_CR1_POS;
+  for (; seg < end; seg++) {
+    int segStop = stop && (seg + 1) == end;
 
+    if (seg->flags & I2C_SEG_READ) {
+      rtn = i2c_ll_master_read(pI2c, seg->addr, seg->buf, seg->len, segStop, us);
+    } else if (!(seg->flags & I2C_SEG_NOSTART) || seg == begin ||
+               ((seg - 1)->flags & I2C_SEG_READ)) {
+      rtn = i2c_ll_master_write(pI2c, seg->addr, seg->buf, seg->len, segStop, us);
+    } else {
+      /* Data of a NOSTART segment follows the previous write */
+      rtn = i2c_ll_write_data(pI2c, seg->buf, seg->len, segStop, us);
+    }
+    if (rtn < 0) {
+      goto fail;
+    }
+    total += rtn;
+  }
+  return total;
 
-  /* Enable Acknowledge */
-  pI2c->CR1 |= I2C_CR1_ACK;
+ fail:
+  i2c_ll_release_bus(pI2c);
+  return rtn;
+}
+//-----------------------------------------------------------------------------
+int i2c_transfer(HAL_I2C_Interface i2cIf,
+                 const i2c_segment* seg, size_t count, int stop) {
+  STATS_START(m);
+  return autoRecover(i2cIf,
+    RECORD_RESULT(i2cIf, m, transferPolled(i2cIf, seg, count, stop)));
+}
+//-----------------------------------------------------------------------------
+int i2c_write_read(HAL_I2C_Interface i2cIf, uint8_t address,
+                   const void* txBuf, size_t txCount,
+                   void* rxBuf, size_t rxCount, int stop) {
+  i2c_segment seg[2];
+
+  seg[0].addr = address;
+  seg[0].flags = 0;
+  seg[0].buf = (void*)txBuf;
+  seg[0].len = txCount;
+
+  seg[1].addr = address;
+  seg[1].flags = I2C_SEG_READ;
+  seg[1].buf = rxBuf;
+  seg[1].len = rxCount;
+
+  int rtn = i2c_transfer(i2cIf, seg, 2, stop);
+  return rtn < 0 ? rtn : (int)rxCount;
+}
+//-----------------------------------------------------------------------------
+// First and last address that are not reserved.
+#define SCAN_FIRST_ADDRESS 0X08
+#define SCAN_LAST_ADDRESS  0X77
+
+static int probeAddress(I2C_TypeDef* pI2c, uint8_t address, uint32_t us) {
+  /* Disable POS and clear AF from an earlier NACK */
+  pI2c->CR1 &= ~I2C_CR1_POS;
+  pI2c->SR1 = ~I2C_SR1_AF;
 
   /* Generate Start */
   pI2c->CR1 |= I2C_CR1_START;
-
-  /* Wait until SB flag is set */
-  if (!waitUntilBitSetSR1(pI2c, I2C_SR1_SB)) {
-   
+  if (!i2c_ll_wait_sr1(pI2c, I2C_SR1_SB, us)) {
     return I2C_ERROR_TIMEOUT;
   }
+  TRACE(pI2c, I2C_TRACE_START, 0);
 
-  /* Send slave address */
-   pI2c->DR = (address << 1) | 1;
+  /* Send slave address and wait for ACK or NACK */
+  pI2c->DR = address << 1;
+  if (!i2c_ll_wait_sr1(pI2c, I2C_SR1_ADDR | I2C_SR1_AF, us)) {
+    TRACE(pI2c, I2C_TRACE_TIMEOUT, address << 1);
+    i2c_ll_generate_stop(pI2c);
+    return I2C_ERROR_TIMEOUT;
+  }
+  int rtn = (pI2c->SR1 & I2C_SR1_ADDR) != 0;
+  TRACE(pI2c, rtn ? I2C_TRACE_ADDR_ACK : I2C_TRACE_ADDR_NACK, address << 1);
+  if (rtn) {
+    i2c_ll_clear_addr_flag(pI2c);
+  } else {
+    pI2c->SR1 = ~I2C_SR1_AF;
+  }
+  i2c_ll_generate_stop(pI2c);
+  if (!i2c_ll_wait_for_stop(pI2c, us)) {
+    return I2C_ERROR_TIMEOUT;
+  }
+  return rtn;
+}
+//-----------------------------------------------------------------------------
+int i2c_probe(HAL_I2C_Interface i2cIf, uint8_t address) {
+  if (i2cIf >= N_I2C_IF || address > 0X7F) {
+    return I2C_ERROR_ARG;
+  }
+  return autoRecover(i2cIf, probeAddress(I2C_MAP[i2cIf].i2c, address,
+                                         FLAG_TIMEOUT(&I2C_STATE[i2cIf])));
+}
+//-----------------------------------------------------------------------------
+int i2c_scan(HAL_I2C_Interface i2cIf, uint8_t* bitmap,
+             const uint8_t* candidates, size_t count) {
+  if (i2cIf >= N_I2C_IF || !bitmap) {
+    return I2C_ERROR_ARG;
+  }
+  I2C_TypeDef* pI2c = I2C_MAP[i2cIf].i2c;
+  uint32_t us = FLAG_TIMEOUT(&I2C_STATE[i2cIf]);
+  size_t n = candidates ? count : SCAN_LAST_ADDRESS - SCAN_FIRST_ADDRESS + 1;
+  int found = 0;
 
-  /* Wait until ADDR flag is set */
-  if (!waitUntilBitSetSR1(pI2c, I2C_SR1_ADDR)) {    
-      return I2C_ERROR_TIMEOUT;
+  memset(bitmap, 0, 16);
+  for (size_t i = 0; i < n; i++) {
+    uint8_t add = candidates ? candidates[i] : SCAN_FIRST_ADDRESS + i;
+    if (add > 0X7F) {
+      return I2C_ERROR_ARG;
+    }
+    int rtn = probeAddress(pI2c, add, us);
+    if (rtn < 0) {
+      return autoRecover(i2cIf, rtn);
+    }
+    if (rtn) {
+      bitmap[add >> 3] |= 1 << (add & 7);
+      found++;
+    }
   }
-  
-  if (count == 1) {
-    /* Disable Acknowledge */
-    pI2c->CR1 &= ~I2C_CR1_ACK;
-
-    /* Clear ADDR flag */
-    clearAddrFlag(pI2c);
-
-    /* Generate Stop */
-    if (stop) {
-      pI2c->CR1 |= I2C_CR1_STOP;
-    }    
-    /* Wait until RXNE flag is set */
-    if (!waitUntilBitSetSR1(pI2c, I2C_SR1_RXNE)) {
+  return found;
+}
+//=============================================================================
+// Bus lock.
+//-----------------------------------------------------------------------------
+/*
+ * Threads wait on a mutex so a FreeRTOS holder inherits the priority of
+ * the highest waiter.  The ticket counters only feed the statistics.
+ */
+// Interfaces that share a peripheral use the state of the first.
+static STM32_I2C_State* lockState(HAL_I2C_Interface i2cIf) {
+  size_t i = 0;
+  while (I2C_MAP[i].i2c != I2C_MAP[i2cIf].i2c) {
+    i++;
+  }
+  return &I2C_STATE[i];
+}
+//-----------------------------------------------------------------------------
+#if PLATFORM_THREADING
+// Create the mutex on first use.  A thread that loses the race frees its copy.
+static os_mutex_t lockMutex(STM32_I2C_State* s) {
+  os_mutex_t m = __atomic_load_n(&s->lockMutex, __ATOMIC_ACQUIRE);
+  if (m) {
+    return m;
+  }
+  os_mutex_t expected = 0;
+  if (os_mutex_create(&m) != 0) {
+    return 0;
+  }
+  if (!__atomic_compare_exchange_n(&s->lockMutex, &expected, m, 0,
+                                   __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)) {
+    os_mutex_destroy(m);
+    m = expected;
+  }
+  return m;
+}
+#endif  // PLATFORM_THREADING
+//-----------------------------------------------------------------------------
+// Take the lock within ms milliseconds, I2C_LOCK_FOREVER to block.
+static int lockAcquire(STM32_I2C_State* s, uint32_t ms) {
+#if PLATFORM_THREADING
+  os_mutex_t m = lockMutex(s);
+  if (!m) {
+    return I2C_ERROR_ARG;
+  }
+  if (ms == I2C_LOCK_FOREVER) {
+    return os_mutex_lock(m) == 0 ? 0 : I2C_ERROR_ARG;
+  }
+  // Sleep between attempts so a lower priority holder can run.
+  while (os_mutex_trylock(m) != 0) {
+    if (ms-- == 0) {
       return I2C_ERROR_TIMEOUT;
     }
+    HAL_Delay_Milliseconds(1);
+  }
+  return 0;
+#else  // PLATFORM_THREADING
+  // Only the caller can hold the lock.  Waiting would never end.
+  (void)ms;
+  if (__atomic_load_n(&s->lockHeld, __ATOMIC_RELAXED)) {
+    return I2C_ERROR_TIMEOUT;
+  }
+  return 0;
+#endif  // PLATFORM_THREADING
+}
+//-----------------------------------------------------------------------------
+static int lockTake(HAL_I2C_Interface i2cIf, uint32_t ms) {
+  if (i2cIf >= N_I2C_IF) {
+    return I2C_ERROR_ARG;
+  }
+  STM32_I2C_State* s = lockState(i2cIf);
+  uint32_t ticket = __atomic_fetch_add(&s->lockNext, 1, __ATOMIC_RELAXED);
+  int contended = ticket != __atomic_load_n(&s->lockServing, __ATOMIC_RELAXED);
+  int rtn = lockAcquire(s, ms);
+  if (rtn < 0) {
+    // Leave the queue so later callers are not counted as contended.
+    __atomic_fetch_add(&s->lockServing, 1, __ATOMIC_RELAXED);
+    return rtn;
+  }
+  __atomic_store_n(&s->lockHeld, 1, __ATOMIC_RELAXED);
+  s->lockMicros = HAL_Timer_Get_Micro_Seconds();
+  s->lockStats.locks++;
+  if (contended) {
+    s->lockStats.contended++;
+  }
+  return 0;
+}
+//-----------------------------------------------------------------------------
+int i2c_lock(HAL_I2C_Interface i2cIf) {
+  return lockTake(i2cIf, I2C_LOCK_FOREVER);
+}
+//-----------------------------------------------------------------------------
+int i2c_lock_timeout(HAL_I2C_Interface i2cIf, uint32_t ms) {
+  return lockTake(i2cIf, ms);
+}
+//-----------------------------------------------------------------------------
+int i2c_get_lock_stats(HAL_I2C_Interface i2cIf, i2c_lock_stats* stats) {
+  if (i2cIf >= N_I2C_IF) {
+    return I2C_ERROR_ARG;
+  }
+  *stats = lockState(i2cIf)->lockStats;
+  return 0;
+}
+//-----------------------------------------------------------------------------
+int i2c_try_lock(HAL_I2C_Interface i2cIf) {
+  if (i2cIf >= N_I2C_IF) {
+    return I2C_ERROR_ARG;
+  }
+  STM32_I2C_State* s = lockState(i2cIf);
+  if (__atomic_load_n(&s->lockHeld, __ATOMIC_RELAXED)) {
+    return 0;
+  }
+  int rtn = lockTake(i2cIf, 0);
+  if (rtn < 0) {
+    // A timeout means another thread took the lock first.
+    return -rtn/10000 == 2 ? 0 : rtn;
+  }
+  return 1;
+}
+//-----------------------------------------------------------------------------
+int i2c_unlock(HAL_I2C_Interface i2cIf) {
+  if (i2cIf >= N_I2C_IF) {
+    return I2C_ERROR_ARG;
+  }
+  STM32_I2C_State* s = lockState(i2cIf);
+  if (!__atomic_load_n(&s->lockHeld, __ATOMIC_RELAXED)) {
+    return I2C_ERROR_ARG;
+  }
+  uint32_t us = HAL_Timer_Get_Micro_Seconds() - s->lockMicros;
+  if (us > s->lockStats.maxHoldMicros) {
+    s->lockStats.maxHoldMicros = us;
+  }
+  s->lockStats.totalHoldMicros += us;
+  __atomic_store_n(&s->lockHeld, 0, __ATOMIC_RELAXED);
+  __atomic_fetch_add(&s->lockServing, 1, __ATOMIC_RELEASE);
+#if PLATFORM_THREADING
+  if (os_mutex_unlock(s->lockMutex) != 0) {
+    return I2C_ERROR_ARG;
+  }
+#endif  // PLATFORM_THREADING
+  return 0;
+}
+//=============================================================================
+// Bus recovery.
+//-----------------------------------------------------------------------------
+/*
+ * A slave reset in the middle of a read may hold SDA low.  Clock SCL
+ * until SDA is released, generate a stop and reset the peripheral.
+ */
+// Half period of recovery clock pulses in microseconds.
+#define RECOVER_HALF_PERIOD_MICROS 5
 
-    /* Read data from DR */
-    *pData++ = pI2c->DR;   
-  } else if (count == 2) {
-    /* Disable Acknowledge */
-    pI2c->CR1 &= ~I2C_CR1_ACK;
-
-    /* Enable Pos */
-    pI2c->CR1 |= I2C_CR1_POS;
+static void recoverDelay(void) {
+  uint32_t m = HAL_Timer_Get_Micro_Seconds();
+  while ((HAL_Timer_Get_Micro_Seconds() - m) < RECOVER_HALF_PERIOD_MICROS) {}
+}
 
-    /* Clear ADDR flag */
-    clearAddrFlag(pI2c);
-    
-    /* Wait until BTF flag is set */
-    if (!waitUntilBitSetSR1(pI2c, I2C_SR1_BTF)) {
-      return I2C_ERROR_TIMEOUT;
-    }
+// Open drain emulation.  The bus pull-ups drive released pins high.
+static void pinLow(uint16_t pin) {
+  HAL_Pin_Mode(pin, OUTPUT);
+  HAL_GPIO_Write(pin, 0);
+  recoverDelay();
+}
 
-    /* Generate Stop */
-    if (stop) {
-      pI2c->CR1 |= I2C_CR1_STOP;
-    }
+static void pinRelease(uint16_t pin) {
+  HAL_Pin_Mode(pin, INPUT);
+  recoverDelay();
+}
 
-    /* Read data from DR */
-    *pData++ = pI2c->DR;
+static int recoverBus(HAL_I2C_Interface i2cIf) {
+  STM32_I2C_Info* p = &I2C_MAP[i2cIf];
+  STM32_I2C_State* s = &I2C_STATE[i2cIf];
+  int i;
 
-    /* Read data from DR */
-    *pData++ = pI2c->DR;  
-  } else {
-    /* Enable Acknowledge */
-    pI2c->CR1 |= I2C_CR1_ACK;
-
-    /* Clear ADDR flag */
-    clearAddrFlag(pI2c);
-    
-    int todo;    
-    for (todo = count; todo > 3; todo--) {
-      /* Wait until RXNE flag is set */
-      if (!waitUntilBitSetSR1(pI2c, I2C_SR1_RXNE)) {
-        return I2C_ERROR_TIMEOUT;
-      }
+  /* Abort interrupt and DMA transfers */
+  p->i2c->CR2 &= ~(I2C_CR2_ITEVTEN | I2C_CR2_ITBUFEN | I2C_CR2_ITERREN |
+                   I2C_CR2_DMAEN | I2C_CR2_LAST);
+#if I2C_DMA_SUPPORT
+  if (s->dmaActive) {
+    p->rxStream->CR &= ~DMA_SxCR_EN;
+    p->txStream->CR &= ~DMA_SxCR_EN;
+  }
+#endif  // I2C_DMA_SUPPORT
+  if (s->dmaActive) {
+    s->dmaActive = 0;
+    s->dmaRtn = I2C_ERROR_BUS;
+  }
+  /* An interrupt transfer stays active until the pins are released. */
+  s->streamActive = 0;
+  s->streamPaused = 0;
+  /* Disable the peripheral and take control of the pins */
+  p->i2c->CR1 &= ~I2C_CR1_PE;
+  pinRelease(p->sdaPin);
+  pinRelease(p->sclPin);
 
-      /* Read data from DR */
-      *pData++ = pI2c->DR;   
-    }
-    /* 3 Last bytes */
-    /* Wait until BTF flag is set */
-    if (!waitUntilBitSetSR1(pI2c, I2C_SR1_BTF)) {
-      return I2C_ERROR_TIMEOUT;
-    }
+  /* Up to nine clocks until the slave releases SDA */
+  for (i = 0; i < 9 && !HAL_GPIO_Read(p->sdaPin); i++) {
+    pinLow(p->sclPin);
+    pinRelease(p->sclPin);
+  }
+  /* Stop condition, SDA rises while SCL is high */
+  pinLow(p->sclPin);
+  pinLow(p->sdaPin);
+  pinRelease(p->sclPin);
+  pinRelease(p->sdaPin);
 
-    /* Disable Acknowledge */
-    pI2c->CR1 &= ~I2C_CR1_ACK;
+  int idle = HAL_GPIO_Read(p->sdaPin) && HAL_GPIO_Read(p->sclPin);
 
-    /* Read data from DR */
-    *pData++ = pI2c->DR;
+  HAL_Pin_Mode(p->sclPin, AF_OUTPUT_DRAIN);
+  HAL_Pin_Mode(p->sdaPin, AF_OUTPUT_DRAIN);
 
-    /* Wait until BTF flag is set */
-    if (!waitUntilBitSetSR1(pI2c, I2C_SR1_BTF)) {
-      return I2C_ERROR_TIMEOUT;
-    }
+  /* Software reset clears a stuck BUSY flag */
+  if (p->i2c->SR2 & I2C_SR2_BUSY) {
+    p->i2c->CR1 |= I2C_CR1_SWRST;
+    p->i2c->CR1 &= ~I2C_CR1_SWRST;
+  }
+  I2C_DeInit(p->i2c);
+  i2c_frequency(i2cIf, s->hz ? s->hz : 100000);
 
-    /* Generate Stop */
-    if (stop) {
-      pI2c->CR1 |= I2C_CR1_STOP;
-    }
+  /* Finish an aborted interrupt transfer.  The callback may start another. */
+  uint32_t primask = __get_PRIMASK();
+  __disable_irq();
+  if (s->irqActive) {
+    irqDone(p->i2c, s, I2C_ERROR_BUS);
+  }
+  __set_PRIMASK(primask);
 
-    /* Read data from DR */
-    *pData++ = pI2c->DR;
+  if (!idle) {
+    s->recoverFailures++;
+    return I2C_ERROR_BUS;
+  }
+  s->recoveries++;
+  return 0;
+}
 
-    /* Read data from DR */
-    *pData++ = pI2c->DR;  
+// Recover after a timeout or bus error if automatic recovery is enabled.
+static int autoRecover(HAL_I2C_Interface i2cIf, int rtn) {
+  int type = -rtn/10000;
+  if ((type == 2 || type == 4) &&
+      i2cIf < N_I2C_IF && I2C_STATE[i2cIf].autoRecover) {
+    recoverBus(i2cIf);
   }
-  if (stop && !waitForStopCondition(pI2c)) {
-    return I2C_ERROR_TIMEOUT;
+  return rtn;
+}
+//-----------------------------------------------------------------------------
+int i2c_auto_recover(HAL_I2C_Interface i2cIf, int enable) {
+  if (i2cIf >= N_I2C_IF) {
+    return I2C_ERROR_ARG;
   }
-  return count;
+  I2C_STATE[i2cIf].autoRecover = enable != 0;
+  return 0;
 }
 //-----------------------------------------------------------------------------
-int i2c_stop(HAL_I2C_Interface i2cIf) {
+int i2c_recover(HAL_I2C_Interface i2cIf) {
   if (i2cIf >= N_I2C_IF) {
     return I2C_ERROR_ARG;
   }
-  I2C_TypeDef* pI2c = I2C_MAP[i2cIf].i2c;
-  
-  pI2c->CR1 |= I2C_CR1_STOP;
-  
-  if (!waitForStopCondition(pI2c)) {
-    return I2C_ERROR_TIMEOUT;
+  return recoverBus(i2cIf);
+}
+//-----------------------------------------------------------------------------
+int i2c_recover_counts(HAL_I2C_Interface i2cIf,
+                       uint32_t* recoveries, uint32_t* failures) {
+  if (i2cIf >= N_I2C_IF) {
+    return I2C_ERROR_ARG;
+  }
+  if (recoveries) {
+    *recoveries = I2C_STATE[i2cIf].recoveries;
+  }
+  if (failures) {
+    *failures = I2C_STATE[i2cIf].recoverFailures;
   }
   return 0;
 }
+//=============================================================================
+// Statistics.
 //-----------------------------------------------------------------------------
-int i2c_write(HAL_I2C_Interface i2cIf, uint8_t address,
-              const void *buf, size_t count, int stop) {
+int i2c_reset_stats(HAL_I2C_Interface i2cIf) {
   if (i2cIf >= N_I2C_IF) {
     return I2C_ERROR_ARG;
-  }        
-  I2C_TypeDef* pI2c = I2C_MAP[i2cIf].i2c;  
+  }
+#if I2C_STATS_ENABLE
+  uint32_t primask = __get_PRIMASK();
+  __disable_irq();
+  memset(&I2C_STATE[i2cIf].stats, 0, sizeof(i2c_stats));
+  __set_PRIMASK(primask);
+  return 0;
+#else  // I2C_STATS_ENABLE
+  return I2C_ERROR_ARG;
+#endif  // I2C_STATS_ENABLE
+}
+//-----------------------------------------------------------------------------
+int i2c_get_stats(HAL_I2C_Interface i2cIf, i2c_stats* stats) {
+  if (i2cIf >= N_I2C_IF) {
+    return I2C_ERROR_ARG;
+  }
+#if I2C_STATS_ENABLE
+  uint32_t primask = __get_PRIMASK();
+  __disable_irq();
+  *stats = I2C_STATE[i2cIf].stats;
+  __set_PRIMASK(primask);
+  return 0;
+#else  // I2C_STATS_ENABLE
+  memset(stats, 0, sizeof(i2c_stats));
+  return I2C_ERROR_ARG;
+#endif  // I2C_STATS_ENABLE
+}
+//=============================================================================
+// Trace.
+//-----------------------------------------------------------------------------
+uint32_t i2c_trace_dropped(void) {
+#if I2C_TRACE_ENABLE
+  return traceDropped;
+#else  // I2C_TRACE_ENABLE
+  return 0;
+#endif  // I2C_TRACE_ENABLE
+}
+//-----------------------------------------------------------------------------
+size_t i2c_trace_read(i2c_trace_event* buf, size_t count) {
+#if I2C_TRACE_ENABLE
+  uint32_t tail = traceTail;
+  size_t n = 0;
+  while (n < count) {
+    TraceSlot* slot = &traceBuf[tail & (I2C_TRACE_SIZE - 1)];
+    /* Stop at the first slot that is reserved but not yet published. */
+    if (__atomic_load_n(&slot->seq, __ATOMIC_ACQUIRE) != tail + 1) {
+      break;
+    }
+    buf[n++] = slot->ev;
+    tail++;
+  }
+  /* Release the slots after the events are copied. */
+  __atomic_store_n(&traceTail, tail, __ATOMIC_RELEASE);
+  return n;
+#else  // I2C_TRACE_ENABLE
+  (void)buf;
+  (void)count;
+  return 0;
+#endif  // I2C_TRACE_ENABLE
+}
+//=============================================================================
+// DMA transfers.
+#if I2C_DMA_SUPPORT
+//-----------------------------------------------------------------------------
+static void dmaStart(DMA_Stream_TypeDef* stream, uint32_t cr, uint32_t flags,
+                     I2C_TypeDef* i2c, const void* buf, size_t count) {
+  /* Stream must be disabled before it can be configured */
+  stream->CR &= ~DMA_SxCR_EN;
+  while (stream->CR & DMA_SxCR_EN) {}
+
+  DMA_ClearFlag(stream, flags);
+  stream->PAR = (uintptr_t)&i2c->DR;
+  stream->M0AR = (uintptr_t)buf;
+  stream->NDTR = count;
+
+  /* Direct mode, byte transfers, memory increment */
+  stream->FCR = 0;
+  stream->CR = cr | DMA_SxCR_MINC | DMA_SxCR_PL_1;
+  stream->CR |= DMA_SxCR_EN;
+}
+//-----------------------------------------------------------------------------
+// Disable DMA for the interface and save the result of the transfer.
+static int dmaEnd(STM32_I2C_Info* p, STM32_I2C_State* s, int rtn) {
+  TRACE(p->i2c, rtn < 0 ? I2C_TRACE_ERROR : I2C_TRACE_DATA,
+        rtn < 0 ? -rtn : rtn);
+  STATS_RECORD_STATE(s, rtn);
+  DMA_Stream_TypeDef* stream = s->dmaRead ? p->rxStream : p->txStream;
+  stream->CR &= ~DMA_SxCR_EN;
+  p->i2c->CR2 &= ~(I2C_CR2_DMAEN | I2C_CR2_LAST);
+  s->dmaActive = 0;
+  s->dmaRtn = rtn;
+  return autoRecover((HAL_I2C_Interface)(s - I2C_STATE), rtn);
+}
+//-----------------------------------------------------------------------------
+int i2c_read_dma(HAL_I2C_Interface i2cIf,
+                 uint8_t address, void *buf, size_t count, int stop) {
+  if (i2cIf >= N_I2C_IF || count == 0 || count > 0XFFFF) {
+    return I2C_ERROR_ARG;
+  }
+  STM32_I2C_Info* p = &I2C_MAP[i2cIf];
+  STM32_I2C_State* s = &I2C_STATE[i2cIf];
+  I2C_TypeDef* pI2c = p->i2c;
+  uint32_t us = FLAG_TIMEOUT(s);
+
+  if (s->dmaActive) {
+    return I2C_ERROR_ARG;
+  }
+  /* LAST requires at least two bytes so use polled read for one byte */
+  if (count == 1) {
+    s->dmaRtn = i2c_read(i2cIf, address, buf, count, stop);
+    return s->dmaRtn < 0 ? s->dmaRtn : 0;
+  }
+  STATS_SAVE_START(s);
+  s->dmaCount = count;
+  s->dmaRead = 1;
+  s->dmaStop = stop;
+
+  /* Disable Pos */
+  pI2c->CR1 &= ~I2C_CR1_POS;
+
+  /* Enable Acknowledge */
+  pI2c->CR1 |= I2C_CR1_ACK;
+
+  /* NACK will be generated after the last byte */
+  pI2c->CR2 |= I2C_CR2_DMAEN | I2C_CR2_LAST;
+
+  dmaStart(p->rxStream, p->rxChannel | DMA_DIR_PeripheralToMemory,
+           p->rxFlags, pI2c, buf, count);
+
+  /* Generate Start, send slave address and wait for ADDR or a NACK */
+  int rtn = i2c_ll_send_address(pI2c, (address << 1) | 1, us);
+  if (rtn < 0) {
+    return dmaEnd(p, s, rtn);
+  }
+  s->dmaActive = 1;
+
+  /* Clear ADDR flag, DMA transfers the data */
+  i2c_ll_clear_addr_flag(pI2c);
+
+  return 0;
+}
+//-----------------------------------------------------------------------------
+int i2c_write_dma(HAL_I2C_Interface i2cIf,
+                  uint8_t address, const void *buf, size_t count, int stop) {
+  if (i2cIf >= N_I2C_IF || count == 0 || count > 0XFFFF) {
+    return I2C_ERROR_ARG;
+  }
+  STM32_I2C_Info* p = &I2C_MAP[i2cIf];
+  STM32_I2C_State* s = &I2C_STATE[i2cIf];
+  I2C_TypeDef* pI2c = p->i2c;
+  uint32_t us = FLAG_TIMEOUT(s);
+
+  if (s->dmaActive) {
+    return I2C_ERROR_ARG;
+  }
+  STATS_SAVE_START(s);
+  s->dmaCount = count;
+  s->dmaRead = 0;
+  s->dmaStop = stop;
 
   /* Disable POS */
   pI2c->CR1 &= ~I2C_CR1_POS;
-  
-  /* Generate Start */
-  pI2c->CR1 |= I2C_CR1_START;
 
-  /* Wait until SB flag is set */
-  if (!waitUntilBitSetSR1(pI2c, I2C_SR1_SB)){
-  
-    return I2C_ERROR_TIMEOUT;
+  /* Generate Start, send slave address and wait for ADDR or a NACK */
+  int rtn = i2c_ll_send_address(pI2c, address << 1, us);
+  if (rtn < 0) {
+    return dmaEnd(p, s, rtn);
   }
+  pI2c->SR1 = ~I2C_SR1_AF;
+  pI2c->CR2 |= I2C_CR2_DMAEN;
 
-  /* Send slave address */
-   pI2c->DR = address << 1;
+  dmaStart(p->txStream, p->txChannel | DMA_DIR_MemoryToPeripheral,
+           p->txFlags, pI2c, buf, count);
+  s->dmaActive = 1;
 
-  /* Wait until ADDR flag is set */
-  if (!waitUntilBitSetSR1(pI2c, I2C_SR1_ADDR)) {
-   
-    return I2C_ERROR_TIMEOUT;
+  /* Clear ADDR flag, DMA transfers the data */
+  i2c_ll_clear_addr_flag(pI2c);
+
+  return 0;
+}
+//-----------------------------------------------------------------------------
+int i2c_dma_done(HAL_I2C_Interface i2cIf) {
+  if (i2cIf >= N_I2C_IF) {
+    return I2C_ERROR_ARG;
+  }
+  STM32_I2C_Info* p = &I2C_MAP[i2cIf];
+  STM32_I2C_State* s = &I2C_STATE[i2cIf];
+
+  if (!s->dmaActive) {
+    return 1;
   }
+  DMA_Stream_TypeDef* stream = s->dmaRead ? p->rxStream : p->txStream;
 
-  /* Clear ADDR flag */
-  clearAddrFlag(pI2c);
-  
-  return i2c_write_data(i2cIf, buf, count, stop);
+  /* EN is cleared by hardware at the end of the transfer */
+  return (stream->CR & DMA_SxCR_EN) == 0 || (p->i2c->SR1 & I2C_SR1_AF);
 }
 //-----------------------------------------------------------------------------
-int i2c_write_data(HAL_I2C_Interface i2cIf, const void* buf, size_t count, int stop) {
+int i2c_dma_wait(HAL_I2C_Interface i2cIf) {
   if (i2cIf >= N_I2C_IF) {
     return I2C_ERROR_ARG;
-  }  
-  I2C_TypeDef* pI2c = I2C_MAP[i2cIf].i2c;  
-   
-  const uint8_t* pData = buf;
-  
-  pI2c->SR1 = ~I2C_SR1_AF;
-  
-  int todo = count;
-  while (todo > 0) {
-    /* Wait until TXE flag is set */
-    if (!waitUntilBitSetSR1(pI2c, I2C_SR1_TXE)) {
-      return I2C_ERROR_TIMEOUT;
+  }
+  STM32_I2C_Info* p = &I2C_MAP[i2cIf];
+  STM32_I2C_State* s = &I2C_STATE[i2cIf];
+  I2C_TypeDef* pI2c = p->i2c;
+  uint32_t us = FLAG_TIMEOUT(s);
+
+  if (!s->dmaActive) {
+    return s->dmaRtn;
+  }
+  DMA_Stream_TypeDef* stream = s->dmaRead ? p->rxStream : p->txStream;
+  uint32_t timeout = transferTimeoutMicros(s, s->dmaCount);
+  uint32_t m = HAL_Timer_Get_Micro_Seconds();
+
+  /* Wait for DMA transfer complete */
+  while (stream->CR & DMA_SxCR_EN) {
+    if (pI2c->SR1 & I2C_SR1_AF) {
+      i2c_ll_generate_stop(pI2c);
+      return dmaEnd(p, s, I2C_ERROR_ACK_FAILURE);
+    }
+    if ((HAL_Timer_Get_Micro_Seconds() - m) > timeout) {
+      return dmaEnd(p, s, I2C_ERROR_TIMEOUT);
+    }
+  }
+  if (!s->dmaRead) {
+    /* Wait until the last byte has been sent */
+    if (!i2c_ll_wait_sr1(pI2c, I2C_SR1_BTF, us)) {
+      return dmaEnd(p, s, I2C_ERROR_TIMEOUT);
+    }
+    if (pI2c->SR1 & I2C_SR1_AF) {
+      return dmaEnd(p, s, I2C_ERROR_ACK_FAILURE);
+    }
+  }
+  /* Generate Stop */
+  if (s->dmaStop) {
+    i2c_ll_generate_stop(pI2c);
+
+    if (!i2c_ll_wait_for_stop(pI2c, us)) {
+      return dmaEnd(p, s, I2C_ERROR_TIMEOUT);
     }
+  }
+  return dmaEnd(p, s, s->dmaCount);
+}
+//=============================================================================
+#else  // I2C_DMA_SUPPORT
+// No DMA so use polled transfers.
+int i2c_read_dma(HAL_I2C_Interface i2cIf,
+                 uint8_t address, void *buf, size_t count, int stop) {
+  if (i2cIf >= N_I2C_IF) {
+    return I2C_ERROR_ARG;
+  }
+  int rtn = i2c_read(i2cIf, address, buf, count, stop);
+  I2C_STATE[i2cIf].dmaRtn = rtn;
+  return rtn < 0 ? rtn : 0;
+}
+//-----------------------------------------------------------------------------
+int i2c_write_dma(HAL_I2C_Interface i2cIf,
+                  uint8_t address, const void *buf, size_t count, int stop) {
+  if (i2cIf >= N_I2C_IF) {
+    return I2C_ERROR_ARG;
+  }
+  int rtn = i2c_write(i2cIf, address, buf, count, stop);
+  I2C_STATE[i2cIf].dmaRtn = rtn;
+  return rtn < 0 ? rtn : 0;
+}
+//-----------------------------------------------------------------------------
+int i2c_dma_done(HAL_I2C_Interface i2cIf) {
+  return i2cIf < N_I2C_IF ? 1 : I2C_ERROR_ARG;
+}
+//-----------------------------------------------------------------------------
+int i2c_dma_wait(HAL_I2C_Interface i2cIf) {
+  return i2cIf < N_I2C_IF ? I2C_STATE[i2cIf].dmaRtn : I2C_ERROR_ARG;
+}
+#endif  // I2C_DMA_SUPPORT
+//=============================================================================
+// Interrupt driven transfers.
+//-----------------------------------------------------------------------------
+#define I2C_CR2_IT_ALL (I2C_CR2_ITEVTEN | I2C_CR2_ITBUFEN | I2C_CR2_ITERREN)
+//-----------------------------------------------------------------------------
+/*
+ * Streaming.  Each frame is a register write and a read joined by repeated
+ * starts.  Frames follow each other with repeated starts, so the bus is only
+ * released when the ring is full or the stream stops.
+ */
+// Start a stream phase.  Called from the interrupt or with it disabled.
+static void streamStart(I2C_TypeDef* i2c, STM32_I2C_State* s, int read) {
+  if (read) {
+    s->irqAddress = (s->streamAddress << 1) | 1;
+    s->irqBuf = s->streamBuf +
+                (s->streamHead & s->streamMask)*s->streamFrameSize;
+    s->irqCount = s->streamFrameSize;
+  } else {
+    s->irqAddress = s->streamAddress << 1;
+    s->irqBuf = &s->streamReg;
+    s->irqCount = 1;
+    s->streamFrameStart = HAL_Timer_Get_Micro_Seconds();
+  }
+  s->irqRead = read;
+  s->irqIndex = 0;
+  s->irqData = 0;
+
+  /* Disable Pos */
+  i2c->CR1 &= ~I2C_CR1_POS;
+
+  /* Enable Acknowledge */
+  i2c->CR1 |= I2C_CR1_ACK;
+
+  /* Generate Start */
+  i2c->CR1 |= I2C_CR1_START;
+
+  /* Buffer interrupts are enabled in the address phase */
+  i2c->CR2 |= I2C_CR2_ITEVTEN | I2C_CR2_ITERREN;
+}
+//-----------------------------------------------------------------------------
+// Called at the end of a stream phase.  Returns nonzero if the stream
+// continues.
+static int streamNext(I2C_TypeDef* i2c, STM32_I2C_State* s, int rtn) {
+  if (rtn >= 0 && s->irqRead) {
+    /* Frame must be in the ring before head is advanced. */
+    __asm__ volatile("" ::: "memory");
+    s->streamHead++;
+    s->streamFrameMicros = HAL_Timer_Get_Micro_Seconds() - s->streamFrameStart;
+  }
+  if (rtn < 0 || s->streamStop) {
+    if (rtn >= 0) {
+      i2c_ll_generate_stop(i2c);
+    }
+    s->irqStop = 1;
+    s->streamActive = 0;
+    return 0;
+  }
+  if (!s->irqRead) {
+    streamStart(i2c, s, 1);
+  } else if ((s->streamHead - s->streamTail) > s->streamMask) {
+    /* Ring full.  Release the bus until a frame is popped. */
+    i2c_ll_generate_stop(i2c);
+    i2c->CR2 &= ~I2C_CR2_IT_ALL;
+    s->streamPauseMicros = HAL_Timer_Get_Micro_Seconds();
+    s->streamPaused = 1;
+  } else {
+    streamStart(i2c, s, 0);
+  }
+  return 1;
+}
+//-----------------------------------------------------------------------------
+// Frames lost in a pause so far.  The frame due when the ring filled and
+// one more for each frame time since.  Call with the interrupt disabled.
+static uint32_t streamDropped(STM32_I2C_State* s) {
+  uint32_t n = 1;
+  if (s->streamFrameMicros) {
+    n += (HAL_Timer_Get_Micro_Seconds() - s->streamPauseMicros)/
+         s->streamFrameMicros;
+  }
+  return n;
+}
+//-----------------------------------------------------------------------------
+static void irqDone(I2C_TypeDef* i2c, STM32_I2C_State* s, int rtn) {
+  if (s->streamActive && streamNext(i2c, s, rtn)) {
+    return;
+  }
+  TRACE(i2c, rtn < 0 ? I2C_TRACE_ERROR : I2C_TRACE_DATA,
+        rtn < 0 ? -rtn : rtn);
+  STATS_RECORD_STATE(s, rtn);
+  i2c->CR2 &= ~I2C_CR2_IT_ALL;
+  s->irqRtn = rtn;
+  s->irqActive = 0;
+  if (s->irqCallback) {
+    s->irqCallback((HAL_I2C_Interface)(s - I2C_STATE), rtn);
+  }
+}
+//-----------------------------------------------------------------------------
+// Find the active interface for a peripheral.
+static STM32_I2C_State* irqState(I2C_TypeDef* i2c) {
+  size_t i;
+  for (i = 0; i < N_I2C_IF; i++) {
+    if (I2C_MAP[i].i2c == i2c && I2C_STATE[i].irqActive) {
+      return &I2C_STATE[i];
+    }
+  }
+  return 0;
+}
+//-----------------------------------------------------------------------------
+static void irqEvent(I2C_TypeDef* i2c) {
+  STM32_I2C_State* s = irqState(i2c);
+  if (!s) {
+    i2c->CR2 &= ~I2C_CR2_IT_ALL;
+    return;
+  }
+  uint32_t sr1 = i2c->SR1;
 
-    /* Write data to DR */
-    pI2c->DR = *pData++;
-    todo--;
+  if (sr1 & I2C_SR1_SB) {
+    TRACE(i2c, I2C_TRACE_START, 0);
+
+    /* Send slave address */
+    i2c->DR = s->irqAddress;
+    return;
+  }
+  if (sr1 & I2C_SR1_ADDR) {
+    TRACE(i2c, I2C_TRACE_ADDR_ACK, s->irqAddress);
+    s->irqData = 1;
+    if (!s->irqRead) {
+      if (s->irqCount) {
+        /* Use TXE for data */
+        i2c->CR2 |= I2C_CR2_ITBUFEN;
+      }
+      /* Clear ADDR flag */
+      i2c_ll_clear_addr_flag(i2c);
+      if (s->irqCount == 0) {
+        if (s->irqStop) {
+          i2c_ll_generate_stop(i2c);
+        }
+        irqDone(i2c, s, 0);
+      }
+    } else if (s->irqCount == 1) {
+      /* Disable Acknowledge */
+      i2c->CR1 &= ~I2C_CR1_ACK;
 
-    if ((pI2c->SR1 & I2C_SR1_BTF) && (todo != 0)) {
+      /* Use RXNE for the byte */
+      i2c->CR2 |= I2C_CR2_ITBUFEN;
+
+      /* Clear ADDR flag */
+      i2c_ll_clear_addr_flag(i2c);
+
+      if (s->irqStop) {
+        i2c_ll_generate_stop(i2c);
+      }
+    } else if (s->irqCount == 2) {
+      /* Disable Acknowledge and enable Pos.  Use BTF for both bytes */
+      i2c->CR1 &= ~I2C_CR1_ACK;
+      i2c->CR1 |= I2C_CR1_POS;
+
+      /* Clear ADDR flag */
+      i2c_ll_clear_addr_flag(i2c);
+    } else {
+      if (s->irqCount > 3) {
+        /* Use RXNE until the last three bytes */
+        i2c->CR2 |= I2C_CR2_ITBUFEN;
+      }
+      /* Clear ADDR flag */
+      i2c_ll_clear_addr_flag(i2c);
+    }
+    return;
+  }
+  /* TXE and BTF from a write without stop are set until the start */
+  if (!s->irqData) {
+    return;
+  }
+  size_t todo = s->irqCount - s->irqIndex;
+  if (!s->irqRead) {
+    if ((sr1 & I2C_SR1_TXE) && todo) {
       /* Write data to DR */
-      pI2c->DR = *pData++;
-      todo--;
+      i2c->DR = s->irqBuf[s->irqIndex++];
+      if (todo == 1) {
+        /* Wait for BTF after the last byte */
+        i2c->CR2 &= ~I2C_CR2_ITBUFEN;
+      }
+    } else if ((sr1 & I2C_SR1_BTF) && todo == 0) {
+      if (s->irqStop) {
+        i2c_ll_generate_stop(i2c);
+      }
+      irqDone(i2c, s, s->irqCount);
+    }
+    return;
+  }
+  if (todo == 1) {
+    if (sr1 & I2C_SR1_RXNE) {
+      s->irqBuf[s->irqIndex++] = i2c->DR;
+      irqDone(i2c, s, s->irqCount);
+    }
+  } else if (todo == 2) {
+    if (sr1 & I2C_SR1_BTF) {
+      /* Generate Stop */
+      if (s->irqStop) {
+        i2c_ll_generate_stop(i2c);
+      }
+      s->irqBuf[s->irqIndex++] = i2c->DR;
+      s->irqBuf[s->irqIndex++] = i2c->DR;
+      irqDone(i2c, s, s->irqCount);
+    }
+  } else if (todo == 3) {
+    if (sr1 & I2C_SR1_BTF) {
+      /* Disable Acknowledge */
+      i2c->CR1 &= ~I2C_CR1_ACK;
+      s->irqBuf[s->irqIndex++] = i2c->DR;
     }
+  } else if (sr1 & I2C_SR1_RXNE) {
+    s->irqBuf[s->irqIndex++] = i2c->DR;
+    if (todo == 4) {
+      /* Use BTF for the last three bytes */
+      i2c->CR2 &= ~I2C_CR2_ITBUFEN;
+    }
+  }
+}
+//-----------------------------------------------------------------------------
+static void irqError(I2C_TypeDef* i2c) {
+  STM32_I2C_State* s = irqState(i2c);
+  uint32_t sr1 = i2c->SR1;
+  int rtn;
+
+  /* Clear error flags */
+  i2c->SR1 = ~(I2C_SR1_AF | I2C_SR1_ARLO | I2C_SR1_BERR | I2C_SR1_OVR);
+
+  if (sr1 & I2C_SR1_AF) {
+    if (s && !s->irqData) {
+      /* NACK before ADDR was set is an address NACK. */
+      TRACE(i2c, I2C_TRACE_ADDR_NACK, s->irqAddress);
+    }
+    i2c_ll_generate_stop(i2c);
+    rtn = I2C_ERROR_ACK_FAILURE;
+  } else {
+    rtn = I2C_ERROR_BUS;
   }
+  if (s) {
+    irqDone(i2c, s, rtn);
+  } else {
+    i2c->CR2 &= ~I2C_CR2_IT_ALL;
+  }
+}
+//-----------------------------------------------------------------------------
+static void i2c1EvIrq(void) {
+  irqEvent(I2C1);
+}
+//-----------------------------------------------------------------------------
+static void i2c1ErIrq(void) {
+  irqError(I2C1);
+}
+#if PLATFORM_ID == 10 && defined(PM_SDA_UC) && defined(PM_SCL_UC)
+//-----------------------------------------------------------------------------
+static void i2c3EvIrq(void) {
+  irqEvent(I2C3);
+}
+//-----------------------------------------------------------------------------
+static void i2c3ErIrq(void) {
+  irqError(I2C3);
+}
+#endif  // PLATFORM_ID == 10 && defined(PM_SDA_UC) && defined(PM_SCL_UC)
+//-----------------------------------------------------------------------------
+static int irqStart(HAL_I2C_Interface i2cIf, uint8_t address,
+                    int read, void *buf, size_t count, int stop) {
+  if (i2cIf >= N_I2C_IF || (read && count == 0)) {
+    return I2C_ERROR_ARG;
+  }
+  STM32_I2C_Info* p = &I2C_MAP[i2cIf];
+  STM32_I2C_State* s = &I2C_STATE[i2cIf];
+  I2C_TypeDef* pI2c = p->i2c;
+  uint32_t us = FLAG_TIMEOUT(s);
 
-  /* Wait until TXE flag is set */
-  if (!waitUntilBitSetSR1(pI2c, I2C_SR1_TXE)) {
+  if (s->irqActive || s->dmaActive) {
+    return I2C_ERROR_ARG;
+  }
+  /* Previous stop must finish before start */
+  if (!i2c_ll_wait_for_stop(pI2c, us)) {
     return I2C_ERROR_TIMEOUT;
   }
-  
-  /* May not need this test since TXE is not set if NACK is returned */
-  if (pI2c->SR1 & I2C_SR1_AF) {
-    return I2C_ERROR_ACK_FAILURE;
+  if (!s->irqInstalled) {
+    HAL_Set_Direct_Interrupt_Handler(p->evIrqn, p->evHandler,
+                                     HAL_DIRECT_INTERRUPT_FLAG_NONE, 0);
+    HAL_Set_Direct_Interrupt_Handler(p->erIrqn, p->erHandler,
+                                     HAL_DIRECT_INTERRUPT_FLAG_NONE, 0);
+    NVIC_EnableIRQ(p->evIrqn);
+    NVIC_EnableIRQ(p->erIrqn);
+    s->irqInstalled = 1;
   }
-  
-  /* Generate Stop */
-  if (stop) {
-    pI2c->CR1 |= I2C_CR1_STOP;
-    
-    if (!waitForStopCondition(pI2c)) {
-      return I2C_ERROR_TIMEOUT;
+  s->irqAddress = (address << 1) | (read ? 1 : 0);
+  s->irqRead = read;
+  s->irqStop = stop;
+  s->irqBuf = (uint8_t*)buf;
+  s->irqCount = count;
+  s->irqIndex = 0;
+  s->irqData = 0;
+  s->irqRtn = 0;
+  s->irqRecover = 1;
+  s->irqMicros = HAL_Timer_Get_Micro_Seconds();
+  STATS_SAVE_START(s);
+  s->irqActive = 1;
+
+  /* Disable Pos */
+  pI2c->CR1 &= ~I2C_CR1_POS;
+
+  /* Enable Acknowledge */
+  pI2c->CR1 |= I2C_CR1_ACK;
+
+  pI2c->SR1 = ~I2C_SR1_AF;
+
+  /* Generate Start */
+  pI2c->CR1 |= I2C_CR1_START;
+
+  /* Buffer interrupts are enabled in the address phase */
+  pI2c->CR2 |= I2C_CR2_ITEVTEN | I2C_CR2_ITERREN;
+
+  return 0;
+}
+//-----------------------------------------------------------------------------
+static void irqRestore(STM32_I2C_Info* p, STM32_I2C_State* s) {
+  if (s->irqInstalled) {
+    p->i2c->CR2 &= ~I2C_CR2_IT_ALL;
+    NVIC_DisableIRQ(p->evIrqn);
+    NVIC_DisableIRQ(p->erIrqn);
+    HAL_Set_Direct_Interrupt_Handler(p->evIrqn, 0,
+                                     HAL_DIRECT_INTERRUPT_FLAG_RESTORE, 0);
+    HAL_Set_Direct_Interrupt_Handler(p->erIrqn, 0,
+                                     HAL_DIRECT_INTERRUPT_FLAG_RESTORE, 0);
+    s->irqInstalled = 0;
+  }
+}
+//-----------------------------------------------------------------------------
+int i2c_start_read(HAL_I2C_Interface i2cIf,
+                   uint8_t address, void *buf, size_t count, int stop) {
+  return irqStart(i2cIf, address, 1, buf, count, stop);
+}
+//-----------------------------------------------------------------------------
+int i2c_start_write(HAL_I2C_Interface i2cIf,
+                    uint8_t address, const void *buf, size_t count, int stop) {
+  return irqStart(i2cIf, address, 0, (void*)buf, count, stop);
+}
+//-----------------------------------------------------------------------------
+int i2c_abort(HAL_I2C_Interface i2cIf) {
+  if (i2cIf >= N_I2C_IF) {
+    return I2C_ERROR_ARG;
+  }
+  STM32_I2C_Info* p = &I2C_MAP[i2cIf];
+  STM32_I2C_State* s = &I2C_STATE[i2cIf];
+  int rtn = 0;
+  uint32_t primask = __get_PRIMASK();
+  __disable_irq();
+  if (s->irqActive) {
+    p->i2c->CR2 &= ~I2C_CR2_IT_ALL;
+    i2c_ll_generate_stop(p->i2c);
+    s->streamActive = 0;
+    irqDone(p->i2c, s, I2C_ERROR_TIMEOUT);
+    rtn = 1;
+  }
+  __set_PRIMASK(primask);
+  return rtn;
+}
+//-----------------------------------------------------------------------------
+int i2c_done(HAL_I2C_Interface i2cIf) {
+  if (i2cIf >= N_I2C_IF) {
+    return I2C_ERROR_ARG;
+  }
+  STM32_I2C_State* s = &I2C_STATE[i2cIf];
+  if (!s->irqActive) {
+    return 1;
+  }
+  /* Abort a hung transfer so pollers see it finish. */
+  if (!s->streamActive &&
+      (HAL_Timer_Get_Micro_Seconds() - s->irqMicros) >
+      transferTimeoutMicros(s, s->irqCount)) {
+    i2c_abort(i2cIf);
+    return 1;
+  }
+  return 0;
+}
+//-----------------------------------------------------------------------------
+int i2c_set_callback(HAL_I2C_Interface i2cIf, i2c_callback callback) {
+  if (i2cIf >= N_I2C_IF) {
+    return I2C_ERROR_ARG;
+  }
+  I2C_STATE[i2cIf].irqCallback = callback;
+  return 0;
+}
+//-----------------------------------------------------------------------------
+int i2c_wait(HAL_I2C_Interface i2cIf) {
+  if (i2cIf >= N_I2C_IF) {
+    return I2C_ERROR_ARG;
+  }
+  STM32_I2C_Info* p = &I2C_MAP[i2cIf];
+  STM32_I2C_State* s = &I2C_STATE[i2cIf];
+  uint32_t us = FLAG_TIMEOUT(s);
+  uint32_t timeout = transferTimeoutMicros(s, s->irqCount);
+  uint32_t m = HAL_Timer_Get_Micro_Seconds();
+
+  while (s->irqActive) {
+    if ((HAL_Timer_Get_Micro_Seconds() - m) > timeout) {
+      /* Also ends a stream so a later transfer is not taken as a phase. */
+      i2c_abort(i2cIf);
+      break;
+    }
+  }
+  int rtn = s->irqRtn;
+  if (rtn >= 0 && s->irqStop && !i2c_ll_wait_for_stop(p->i2c, us)) {
+    rtn = I2C_ERROR_TIMEOUT;
+  }
+  /* Only the first wait after a failed transfer recovers the bus. */
+  if (s->irqRecover) {
+    s->irqRecover = 0;
+    return autoRecover(i2cIf, rtn);
+  }
+  return rtn;
+}
+//=============================================================================
+// Streaming.
+//-----------------------------------------------------------------------------
+int i2c_stream_available(HAL_I2C_Interface i2cIf) {
+  if (i2cIf >= N_I2C_IF) {
+    return I2C_ERROR_ARG;
+  }
+  STM32_I2C_State* s = &I2C_STATE[i2cIf];
+  int n = s->streamHead - s->streamTail;
+  if (n == 0 && !s->streamActive && !s->irqActive && s->irqRtn < 0) {
+    return s->irqRtn;
+  }
+  return n;
+}
+//-----------------------------------------------------------------------------
+int i2c_stream_overruns(HAL_I2C_Interface i2cIf) {
+  if (i2cIf >= N_I2C_IF) {
+    return I2C_ERROR_ARG;
+  }
+  STM32_I2C_State* s = &I2C_STATE[i2cIf];
+  uint32_t primask = __get_PRIMASK();
+  __disable_irq();
+  uint32_t n = s->streamOverruns;
+  if (s->streamPaused) {
+    n += streamDropped(s);
+  }
+  __set_PRIMASK(primask);
+  return n;
+}
+//-----------------------------------------------------------------------------
+int i2c_stream_pop(HAL_I2C_Interface i2cIf, void* frame) {
+  if (i2cIf >= N_I2C_IF) {
+    return I2C_ERROR_ARG;
+  }
+  STM32_I2C_State* s = &I2C_STATE[i2cIf];
+  uint32_t tail = s->streamTail;
+  if (tail == s->streamHead) {
+    return 0;
+  }
+  memcpy(frame, s->streamBuf + (tail & s->streamMask)*s->streamFrameSize,
+         s->streamFrameSize);
+
+  /* Release the slot after the frame is copied. */
+  __asm__ volatile("" ::: "memory");
+  s->streamTail = tail + 1;
+
+  if (s->streamPaused) {
+    I2C_TypeDef* pI2c = I2C_MAP[i2cIf].i2c;
+    /* Interrupts for the interface are off while paused so the wait for
+       the stop that released the bus runs with interrupts enabled. */
+    int stopped = i2c_ll_wait_for_stop(pI2c, FLAG_TIMEOUT(s));
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+    if (s->streamPaused && s->streamActive) {
+      s->streamPaused = 0;
+      s->streamOverruns += streamDropped(s);
+      if (stopped) {
+        streamStart(pI2c, s, 0);
+      } else {
+        s->streamActive = 0;
+        s->irqActive = 0;
+        s->irqRtn = I2C_ERROR_TIMEOUT;
+      }
     }
+    __set_PRIMASK(primask);
   }
+  return 1;
+}
+//-----------------------------------------------------------------------------
+int i2c_stream_start(HAL_I2C_Interface i2cIf, uint8_t address, uint8_t reg,
+                     void* buf, size_t frameSize, size_t frameCount) {
+  if (i2cIf >= N_I2C_IF || !buf || frameSize == 0 || frameCount == 0 ||
+      (frameCount & (frameCount - 1))) {
+    return I2C_ERROR_ARG;
+  }
+  STM32_I2C_State* s = &I2C_STATE[i2cIf];
+  if (s->irqActive || s->dmaActive) {
+    return I2C_ERROR_ARG;
+  }
+  s->streamAddress = address;
+  s->streamReg = reg;
+  s->streamBuf = (uint8_t*)buf;
+  s->streamFrameSize = frameSize;
+  s->streamMask = frameCount - 1;
+  s->streamHead = 0;
+  s->streamTail = 0;
+  s->streamOverruns = 0;
+  s->streamFrameMicros = 0;
+  s->streamPaused = 0;
+  s->streamStop = 0;
+  s->streamActive = 1;
 
-  return count;
+  /* First register write.  The interrupt runs the rest of the stream. */
+  int rtn = irqStart(i2cIf, address, 0, &s->streamReg, 1, 0);
+  if (rtn < 0) {
+    s->streamActive = 0;
+  }
+  return rtn;
 }
+//-----------------------------------------------------------------------------
+int i2c_stream_stop(HAL_I2C_Interface i2cIf) {
+  if (i2cIf >= N_I2C_IF) {
+    return I2C_ERROR_ARG;
+  }
+  STM32_I2C_State* s = &I2C_STATE[i2cIf];
+  uint32_t primask = __get_PRIMASK();
+  __disable_irq();
+  if (s->streamActive && s->streamPaused) {
+    s->streamOverruns += streamDropped(s);
+    s->streamActive = 0;
+    s->streamPaused = 0;
+    s->irqActive = 0;
+    s->irqRtn = 0;
+  }
+  /* Stop at the end of the current phase. */
+  s->streamStop = 1;
+  __set_PRIMASK(primask);
+  return i2c_wait(i2cIf);
+}
+//-----------------------------------------------------------------------------
+#if __LINE__ >= 5000
+#error i2c_lld_stm32.c error codes overlap i2c_lld_stm32.h
+#endif  // __LINE__ >= 5000
@@ -0,0 +1,343 @@
+/* Particle I2cMaster Library
+ * Copyright (C) 2016 by William Greiman
+ *
+ * This file is part of the Particle I2cMaster Library
+ *
+ * This Library is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This Library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with the Particle I2cMaster Library.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+#ifndef i2c_lld_stm32_h
+#define i2c_lld_stm32_h
+/*
+ * STM32 register level primitives.  Shared by the low level driver and
+ * I2cMasterT so the polling loops inline with a constant peripheral
+ * address when the interface is known at compile time.
+ *
+ * Functions return 1/0 or a byte count/negative error code, the same as
+ * the low level driver.
+ */
+#include "i2c_lld.h"
+
+/*
+ * Error codes are -(class*10000 + file + line).  The class is 1 for an
+ * argument error, 2 for a timeout, 3 for a NACK and 4 for a bus error.
+ * I2C_ERROR_FILE is 5000 in this file and 0 after it so a line number
+ * identifies either this file or i2c_lld_stm32.c.  The error and trace
+ * macros are removed at the end of this file unless I2C_LLD_SOURCE is
+ * defined, so they stay private to the low level driver.
+ */
+#define I2C_ERROR_FILE 5000
+#define I2C_ERROR_ARG         (-(10000 + I2C_ERROR_FILE + __LINE__))
+#define I2C_ERROR_TIMEOUT     (-(20000 + I2C_ERROR_FILE + __LINE__))
+#define I2C_ERROR_ACK_FAILURE (-(30000 + I2C_ERROR_FILE + __LINE__))
+#define I2C_ERROR_BUS         (-(40000 + I2C_ERROR_FILE + __LINE__))
+
+#ifndef I2C_LLD_TRACE
+/** Trace hook.  Only the low level driver records trace events. */
+#define I2C_LLD_TRACE(i2c, type, data)
+#endif  // I2C_LLD_TRACE
+//-----------------------------------------------------------------------------
+// Clear ADDR by reading SR1 register followed by reading SR2.
+static inline void i2c_ll_clear_addr_flag(I2C_TypeDef* i2c) {
+  __IO uint32_t tmpreg = 0x00;
+  tmpreg = i2c->SR1;
+  tmpreg = i2c->SR2;
+  (void)tmpreg;
+}
+
+// Generate a stop condition.
+static inline void i2c_ll_generate_stop(I2C_TypeDef* i2c) {
+  i2c->CR1 |= I2C_CR1_STOP;
+  I2C_LLD_TRACE(i2c, I2C_TRACE_STOP, 0);
+}
+
+// Generate a stop after a failed transfer unless one is pending or the
+// peripheral has already left master mode, for example after a NACK.
+static inline void i2c_ll_release_bus(I2C_TypeDef* i2c) {
+  if (!(i2c->CR1 & I2C_CR1_STOP) && (i2c->SR2 & I2C_SR2_MSL)) {
+    i2c_ll_generate_stop(i2c);
+  }
+}
+
+static inline int i2c_ll_wait_for_stop(I2C_TypeDef* i2c, uint32_t us) {
+  uint32_t m = HAL_Timer_Get_Micro_Seconds();
+  while (i2c->CR1 & I2C_CR1_STOP) {
+    if ((HAL_Timer_Get_Micro_Seconds() - m) > us) {
+      return (i2c->CR1 & I2C_CR1_STOP) == 0;
+    }
+  }
+  return 1;
+}
+
+static inline int i2c_ll_wait_sr1(I2C_TypeDef* i2c, uint32_t bit, uint32_t us) {
+  /* Avoid reading the timer if the flag is already set */
+  if (i2c->SR1 & bit) return 1;
+  uint32_t m = HAL_Timer_Get_Micro_Seconds();
+  do {
+    if (i2c->SR1 & bit) return 1;
+  } while ((HAL_Timer_Get_Micro_Seconds() - m) <= us);
+  return (i2c->SR1 & bit) != 0;
+}
+
+static inline int i2c_ll_wait_not_busy(I2C_TypeDef* i2c, uint32_t us) {
+  uint32_t m = HAL_Timer_Get_Micro_Seconds();
+  while (i2c->SR2 & I2C_SR2_BUSY) {
+    if ((HAL_Timer_Get_Micro_Seconds() - m) > us) {
+      return (i2c->SR2 & I2C_SR2_BUSY) == 0;
+    }
+  }
+  return 1;
+}
+//-----------------------------------------------------------------------------
+// Generate start, send address and wait for ADDR.  ADDR is not cleared.
+// Returns zero or a negative error code.  Stop is generated on a NACK.
+static inline int i2c_ll_send_address(I2C_TypeDef* pI2c, uint8_t addrRW, uint32_t us) {
+  /* Generate Start */
+  pI2c->CR1 |= I2C_CR1_START;
+
+  /* Wait until SB flag is set */
+  if (!i2c_ll_wait_sr1(pI2c, I2C_SR1_SB, us)) {
+    return I2C_ERROR_TIMEOUT;
+  }
+
+  I2C_LLD_TRACE(pI2c, I2C_TRACE_START, 0);
+
+  /* Send slave address */
+  pI2c->DR = addrRW;
+
+  /* Wait until ADDR flag is set or the address is not acknowledged */
+  if (!i2c_ll_wait_sr1(pI2c, I2C_SR1_ADDR | I2C_SR1_AF, us)) {
+    I2C_LLD_TRACE(pI2c, I2C_TRACE_TIMEOUT, addrRW);
+    return I2C_ERROR_TIMEOUT;
+  }
+  if (pI2c->SR1 & I2C_SR1_AF) {
+    I2C_LLD_TRACE(pI2c, I2C_TRACE_ADDR_NACK, addrRW);
+    pI2c->SR1 = ~I2C_SR1_AF;
+    i2c_ll_generate_stop(pI2c);
+    return I2C_ERROR_ACK_FAILURE;
+  }
+  I2C_LLD_TRACE(pI2c, I2C_TRACE_ADDR_ACK, addrRW);
+  return 0;
+}
+//-----------------------------------------------------------------------------
+// Read data phase.  Called with ADDR set.
+static inline int i2c_ll_read_data(I2C_TypeDef* pI2c,
+                                   void* dst, size_t count, int stop, uint32_t us) {
+  uint8_t *pData = (uint8_t*)dst;
+
+  if (count == 1) {
+    /* Disable Acknowledge */
+    pI2c->CR1 &= ~I2C_CR1_ACK;
+
+    /* Clear ADDR flag */
+    i2c_ll_clear_addr_flag(pI2c);
+
+    /* Generate Stop */
+    if (stop) {
+      i2c_ll_generate_stop(pI2c);
+    }    
+    /* Wait until RXNE flag is set */
+    if (!i2c_ll_wait_sr1(pI2c, I2C_SR1_RXNE, us)) {
+      return I2C_ERROR_TIMEOUT;
+    }
+
+    /* Read data from DR */
+    *pData++ = pI2c->DR;   
+  } else if (count == 2) {
+    /* Disable Acknowledge */
+    pI2c->CR1 &= ~I2C_CR1_ACK;
+
+    /* Enable Pos */
+    pI2c->CR1 |= I2C_CR1_POS;
+
+    /* Clear ADDR flag */
+    i2c_ll_clear_addr_flag(pI2c);
+    
+    /* Wait until BTF flag is set */
+    if (!i2c_ll_wait_sr1(pI2c, I2C_SR1_BTF, us)) {
+      return I2C_ERROR_TIMEOUT;
+    }
+
+    /* Generate Stop */
+    if (stop) {
+      i2c_ll_generate_stop(pI2c);
+    }
+
+    /* Read data from DR */
+    *pData++ = pI2c->DR;
+
+    /* Read data from DR */
+    *pData++ = pI2c->DR;  
+  } else {
+    /* Enable Acknowledge */
+    pI2c->CR1 |= I2C_CR1_ACK;
+
+    /* Clear ADDR flag */
+    i2c_ll_clear_addr_flag(pI2c);
+    
+    int todo;    
+    for (todo = count; todo > 3; todo--) {
+      /* Wait until RXNE flag is set */
+      if (!i2c_ll_wait_sr1(pI2c, I2C_SR1_RXNE, us)) {
+        return I2C_ERROR_TIMEOUT;
+      }
+
+      /* Read data from DR */
+      *pData++ = pI2c->DR;   
+    }
+    /* 3 Last bytes */
+    /* Wait until BTF flag is set */
+    if (!i2c_ll_wait_sr1(pI2c, I2C_SR1_BTF, us)) {
+      return I2C_ERROR_TIMEOUT;
+    }
+
+    /* Disable Acknowledge */
+    pI2c->CR1 &= ~I2C_CR1_ACK;
+
+    /* Read data from DR */
+    *pData++ = pI2c->DR;
+
+    /* Wait until BTF flag is set */
+    if (!i2c_ll_wait_sr1(pI2c, I2C_SR1_BTF, us)) {
+      return I2C_ERROR_TIMEOUT;
+    }
+
+    /* Generate Stop */
+    if (stop) {
+      i2c_ll_generate_stop(pI2c);
+    }
+
+    /* Read data from DR */
+    *pData++ = pI2c->DR;
+
+    /* Read data from DR */
+    *pData++ = pI2c->DR;  
+  }
+  if (stop && !i2c_ll_wait_for_stop(pI2c, us)) {
+    return I2C_ERROR_TIMEOUT;
+  }
+  I2C_LLD_TRACE(pI2c, I2C_TRACE_DATA, count);
+  return count;
+}
+//-----------------------------------------------------------------------------
+// Write data phase.  Called after ADDR has been cleared.
+static inline int i2c_ll_write_data(I2C_TypeDef* pI2c,
+                                    const void* buf, size_t count, int stop, uint32_t us) {
+  const uint8_t* pData = (const uint8_t*)buf;
+  
+  pI2c->SR1 = ~I2C_SR1_AF;
+  
+  int todo = count;
+  while (todo > 0) {
+    /* Wait until TXE flag is set */
+    if (!i2c_ll_wait_sr1(pI2c, I2C_SR1_TXE, us)) {
+      return I2C_ERROR_TIMEOUT;
+    }
+
+    /* Write data to DR */
+    pI2c->DR = *pData++;
+    todo--;
+
+    if ((pI2c->SR1 & I2C_SR1_BTF) && (todo != 0)) {
+      /* Write data to DR */
+      pI2c->DR = *pData++;
+      todo--;
+    }
+  }
+
+  /* Wait until TXE flag is set */
+  if (!i2c_ll_wait_sr1(pI2c, I2C_SR1_TXE, us)) {
+    return I2C_ERROR_TIMEOUT;
+  }
+  
+  /* May not need this test since TXE is not set if NACK is returned */
+  if (pI2c->SR1 & I2C_SR1_AF) {
+    return I2C_ERROR_ACK_FAILURE;
+  }
+  
+  /* Generate Stop */
+  if (stop) {
+    i2c_ll_generate_stop(pI2c);
+    
+    if (!i2c_ll_wait_for_stop(pI2c, us)) {
+      return I2C_ERROR_TIMEOUT;
+    }
+  }
+
+  I2C_LLD_TRACE(pI2c, I2C_TRACE_DATA, count);
+  return count;
+}
+//-----------------------------------------------------------------------------
+// Read with start.
+static inline int i2c_ll_master_read(I2C_TypeDef* pI2c, uint8_t address,
+                                     void* dst, size_t count, int stop,
+                                     uint32_t us) {
+  if (count == 0) {
+    return I2C_ERROR_ARG;
+  }
+  /* Disable Pos */
+  pI2c->CR1 &= ~I2C_CR1_POS;
+
+  /* Enable Acknowledge */
+  pI2c->CR1 |= I2C_CR1_ACK;
+
+  /* Generate Start and send slave address */
+  int rtn = i2c_ll_send_address(pI2c, (address << 1) | 1, us);
+  if (rtn < 0) {
+    return rtn;
+  }
+  return i2c_ll_read_data(pI2c, dst, count, stop, us);
+}
+//-----------------------------------------------------------------------------
+// Write with start.
+static inline int i2c_ll_master_write(I2C_TypeDef* pI2c, uint8_t address,
+                                      const void* buf, size_t count, int stop,
+                                      uint32_t us) {
+  /* Disable POS */
+  pI2c->CR1 &= ~I2C_CR1_POS;
+
+  /* Generate Start and send slave address */
+  int rtn = i2c_ll_send_address(pI2c, address << 1, us);
+  if (rtn < 0) {
+    return rtn;
+  }
+  /* Clear ADDR flag */
+  i2c_ll_clear_addr_flag(pI2c);
+
+  return i2c_ll_write_data(pI2c, buf, count, stop, us);
+}
+//-----------------------------------------------------------------------------
+// Generate stop and wait for it to be sent.
+static inline int i2c_ll_master_stop(I2C_TypeDef* pI2c, uint32_t us) {
+  i2c_ll_generate_stop(pI2c);
+
+  if (!i2c_ll_wait_for_stop(pI2c, us)) {
+    return I2C_ERROR_TIMEOUT;
+  }
+  return 0;
+}
+#if __LINE__ >= 1000
+#error i2c_lld_stm32.h error codes overlap the next class
+#endif  // __LINE__ >= 1000
+#undef I2C_ERROR_FILE
+#ifdef I2C_LLD_SOURCE
+#define I2C_ERROR_FILE 0
+#else  // I2C_LLD_SOURCE
+#undef I2C_ERROR_ARG
+#undef I2C_ERROR_TIMEOUT
+#undef I2C_ERROR_ACK_FAILURE
+#undef I2C_ERROR_BUS
+#undef I2C_LLD_TRACE
+#endif  // I2C_LLD_SOURCE
+#endif  // i2c_lld_stm32_h
@@ -0,0 +1,199 @@
+/* Particle I2cMaster Library
+ * Copyright (C) 2016 by William Greiman
+ *
+ * This file is part of the Particle I2cMaster Library
+ *
+ * This Library is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This Library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with the Particle I2cMaster Library.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+// Ordering and completion of I2cMaster::readAsync()/writeAsync() requests
+// on a simulated bus with a DS1307 and an MPU6050.
+#include <stdio.h>
+#include <string.h>
+#include "I2cMaster.h"
+
+const uint8_t DS1307_ADDRESS = 0X68;
+const uint8_t MPU6050_ADDRESS = 0X69;
+const uint8_t ABSENT_ADDRESS = 0X50;
+
+Ds1307Sim ds1307;
+Mpu6050Sim mpu6050;
+I2cMaster i2c;
+int failures;
+//-----------------------------------------------------------------------------
+void check(const char* name, bool ok) {
+  printf("%-32s %s\n", name, ok ? "ok" : "FAIL");
+  if (!ok) {
+    failures++;
+  }
+}
+//-----------------------------------------------------------------------------
+// Requests finish in the order they were queued.
+void ordering() {
+  uint8_t reg0 = 0;
+  uint8_t data[5] = {8, 0XC1, 0XC2, 0XC3, 0XC4};
+  uint8_t reg8 = 8;
+  uint8_t rtc[7];
+  uint8_t ram[4];
+  memset(rtc, 0, sizeof(rtc));
+  memset(ram, 0, sizeof(ram));
+  I2cFuture f[4];
+  f[0] = i2c.writeAsync(DS1307_ADDRESS, &reg0, 1);
+  f[1] = i2c.readAsync(DS1307_ADDRESS, rtc, sizeof(rtc));
+  f[2] = i2c.writeAsync(DS1307_ADDRESS, data, sizeof(data));
+  f[3] = i2c.writeAsync(DS1307_ADDRESS, &reg8, 1);
+  bool ok = f[0].valid() && f[1].valid() && f[2].valid() && f[3].valid();
+  ok = ok && !i2c.readAsync(DS1307_ADDRESS, ram, sizeof(ram)).valid();
+  check("queue full", ok);
+
+  /* A later request is never done before an earlier one. */
+  bool inOrder = true;
+  while (!f[3].ready()) {
+    for (int i = 1; i < 4; i++) {
+      if (f[i].ready() && !f[i - 1].ready()) {
+        inOrder = false;
+      }
+    }
+  }
+  check("completion order", inOrder && f[0].ready() && f[1].ready() &&
+        f[2].ready());
+  check("results", f[0].result() == 1 && f[1].result() == 7 &&
+        f[2].result() == 5 && f[3].result() == 1);
+  check("read data", memcmp(rtc, ds1307.reg, sizeof(rtc)) == 0);
+
+  I2cFuture r = i2c.readAsync(DS1307_ADDRESS, ram, sizeof(ram));
+  check("write then read back", r.wait() && r.result() == 4 &&
+        memcmp(ram, &data[1], sizeof(ram)) == 0);
+}
+//-----------------------------------------------------------------------------
+// Compute overlaps an MPU6050 burst read.
+void overlap() {
+  uint8_t reg = 0X3B;
+  uint8_t sample[14];
+  I2cFuture w = i2c.writeAsync(MPU6050_ADDRESS, &reg, 1, false);
+  I2cFuture r = i2c.readAsync(MPU6050_ADDRESS, sample, sizeof(sample));
+  check("pending after queue", !r.ready() && r.result() < 0);
+  bool ok = w.wait() && r.wait() && r.result() == 14;
+  for (size_t i = 0; ok && i < 7; i++) {
+    ok = ((sample[2*i] << 8) | sample[2*i + 1]) ==
+         (uint16_t)(mpu6050.samples*(i + 1));
+  }
+  check("repeated start burst read", ok);
+}
+//-----------------------------------------------------------------------------
+// A request queued during a direct interrupt transfer starts after it.
+void direct() {
+  uint8_t reg = 0;
+  uint8_t rtc[7];
+  memset(rtc, 0, sizeof(rtc));
+  bool ok = i2c.startWrite(DS1307_ADDRESS, &reg, 1);
+  I2cFuture f = i2c.readAsync(DS1307_ADDRESS, rtc, sizeof(rtc));
+  check("queued behind direct transfer", ok && f.valid() && !f.ready());
+  check("starts after direct transfer", f.wait() && f.result() == 7 &&
+        memcmp(rtc, ds1307.reg, sizeof(rtc)) == 0);
+}
+//-----------------------------------------------------------------------------
+// A failed request does not stop the queue.
+void failure() {
+  uint8_t b;
+  uint8_t reg = 0;
+  uint8_t rtc[2];
+  I2cFuture f0 = i2c.readAsync(ABSENT_ADDRESS, &b, 1);
+  I2cFuture f1 = i2c.writeAsync(DS1307_ADDRESS, &reg, 1);
+  I2cFuture f2 = i2c.readAsync(DS1307_ADDRESS, rtc, sizeof(rtc));
+  check("address nack", !f0.wait() && f0.result() < 0);
+  check("queue runs after nack", f2.wait() && f1.result() == 1 &&
+        f2.result() == 2);
+}
+//-----------------------------------------------------------------------------
+// A request that runs past the wait timeout is aborted.
+void timeout() {
+  uint8_t reg = 0X3B;
+  uint8_t sample[14];
+  uint8_t reg0 = 0;
+  mpu6050.stretchNanos = 1000000;
+  I2cFuture f0 = i2c.writeAsync(MPU6050_ADDRESS, &reg, 1);
+  I2cFuture f1 = i2c.readAsync(MPU6050_ADDRESS, sample, sizeof(sample));
+  check("timeout aborts", !f0.wait(100) && f0.ready() && f0.result() < 0);
+  mpu6050.stretchNanos = 0;
+  I2cFuture f2 = i2c.writeAsync(DS1307_ADDRESS, &reg0, 1);
+  check("queue runs after abort", f1.wait() && f1.result() == 14 &&
+        f2.wait() && f2.result() == 1);
+}
+//-----------------------------------------------------------------------------
+// A stream that times out in wait() is stopped and does not take over the
+// next transfer.
+void streamTimeout() {
+  uint8_t ring[4*14];
+  uint8_t sample[14];
+  uint8_t reg = 0X3B;
+  mpu6050.stretchNanos = 3000000;
+  bool ok = i2c.startStream(MPU6050_ADDRESS, 0X3B, ring, 14, 4);
+  check("stream timeout", ok && !i2c.wait());
+  mpu6050.stretchNanos = 0;
+  uint32_t samples = mpu6050.samples;
+  i2c.writeAsync(MPU6050_ADDRESS, &reg, 1, false);
+  I2cFuture f = i2c.readAsync(MPU6050_ADDRESS, sample, sizeof(sample));
+  ok = f.wait() && f.result() == 14;
+  /* Interrupts run between steps.  A live stream would read more samples. */
+  for (int i = 0; i < 1000; i++) {
+    i2cSim.cpu(1000);
+  }
+  check("read after stream timeout", ok && mpu6050.samples == samples + 1);
+}
+//-----------------------------------------------------------------------------
+// Bus recovery finishes an active request and the queue moves on.
+void recover() {
+  uint8_t reg = 0X3B;
+  uint8_t reg0 = 0;
+  mpu6050.stretchNanos = 1000000;
+  I2cFuture f0 = i2c.writeAsync(MPU6050_ADDRESS, &reg, 1);
+  I2cFuture f1 = i2c.writeAsync(DS1307_ADDRESS, &reg0, 1);
+  bool ok = i2c.recoverBus();
+  mpu6050.stretchNanos = 0;
+  check("recovery aborts", ok && f0.ready() && f0.result() < 0);
+  check("queue runs after recovery", f1.wait() && f1.result() == 1);
+}
+//-----------------------------------------------------------------------------
+// Results are lost when the slot is reused.
+void reuse() {
+  uint8_t reg = 0;
+  I2cFuture f0 = i2c.writeAsync(DS1307_ADDRESS, &reg, 1);
+  f0.wait();
+  for (int i = 0; i < I2C_ASYNC_QUEUE_SIZE; i++) {
+    i2c.writeAsync(DS1307_ADDRESS, &reg, 1).wait();
+  }
+  check("stale future", f0.ready() && f0.result() < 0);
+  check("invalid future", I2cFuture().ready() && !I2cFuture().wait());
+}
+//-----------------------------------------------------------------------------
+int main() {
+  i2cSim.i2c1.attach(&ds1307);
+  i2cSim.i2c1.attach(&mpu6050);
+  if (!i2c.begin(400000)) {
+    printf("begin failed\n");
+    return 1;
+  }
+  ordering();
+  overlap();
+  direct();
+  failure();
+  timeout();
+  streamTimeout();
+  recover();
+  reuse();
+  i2c.end();
+  printf("\n%s\n", failures ? "FAILED" : "PASSED");
+  return failures ? 1 : 0;
+}
@@ -0,0 +1,148 @@
+/* Particle I2cMaster Library
+ * Copyright (C) 2016 by William Greiman
+ *
+ * This file is part of the Particle I2cMaster Library
+ *
+ * This Library is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This Library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with the Particle I2cMaster Library.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+// i2c_lock(), i2c_try_lock(), i2c_unlock(), I2cBusGuard and lock statistics
+// with the driver built for threads.  Host threads stand in for FreeRTOS
+// tasks and the shim mutex for os_mutex_t.
+#include <stdio.h>
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include "I2cMaster.h"
+
+I2cMaster i2c;
+int failures;
+//-----------------------------------------------------------------------------
+void check(const char* name, bool ok) {
+  printf("%-32s %s\n", name, ok ? "ok" : "FAIL");
+  if (!ok) {
+    failures++;
+  }
+}
+//-----------------------------------------------------------------------------
+i2c_lock_stats lockStats() {
+  i2c_lock_stats stats;
+  i2c.lockStats(&stats);
+  return stats;
+}
+//-----------------------------------------------------------------------------
+void sleepMillis(uint32_t ms) {
+  std::this_thread::sleep_for(std::chrono::milliseconds(ms));
+}
+//-----------------------------------------------------------------------------
+// Lock and unlock in one thread.
+void single() {
+  i2c_lock_stats before = lockStats();
+  bool ok = i2c.lock();
+  ok = ok && !i2c.tryLock();
+  ok = ok && i2c.unlock();
+  check("lock, tryLock held, unlock", ok);
+  check("unlock not held fails", !i2c.unlock() && i2c.rtn() < 0);
+  ok = i2c.tryLock();
+  ok = ok && i2c.unlock();
+  check("tryLock free", ok);
+
+  i2c.lock();
+  i2cSim.cpu(2000000);
+  i2c.unlock();
+  i2c_lock_stats stats = lockStats();
+  check("stats locks", stats.locks == before.locks + 3);
+  check("stats not contended", stats.contended == before.contended);
+  check("stats hold time", stats.maxHoldMicros >= 2000 &&
+        stats.totalHoldMicros >= before.totalHoldMicros + 2000);
+}
+//-----------------------------------------------------------------------------
+// The guard holds the lock for its scope.
+void guard() {
+  {
+    I2cBusGuard guard(i2c);
+    check("guard locked", guard.locked());
+    check("guard excludes tryLock", !i2c.tryLock());
+  }
+  bool ok = i2c.tryLock();
+  ok = ok && i2c.unlock();
+  check("guard unlocks", ok);
+}
+//-----------------------------------------------------------------------------
+// A waiter blocks until the holder unlocks.
+void contention() {
+  std::atomic<bool> held(false);
+  std::atomic<bool> released(false);
+  i2c_lock_stats before = lockStats();
+  std::thread holder([&]() {
+    i2c_lock(HAL_I2C_INTERFACE1);
+    held = true;
+    sleepMillis(20);
+    released = true;
+    i2c_unlock(HAL_I2C_INTERFACE1);
+  });
+  while (!held) {
+    sleepMillis(1);
+  }
+  check("tryLock other thread", !i2c.tryLock());
+  bool ok = i2c.lock();
+  check("lock waits for holder", ok && released);
+  i2c.unlock();
+  holder.join();
+  i2c_lock_stats stats = lockStats();
+  check("stats contended", stats.contended == before.contended + 1 &&
+        stats.locks == before.locks + 2);
+}
+//-----------------------------------------------------------------------------
+// A guard with a timeout reports failure and does not unlock.
+void timeout() {
+  std::atomic<bool> held(false);
+  std::atomic<bool> release(false);
+  std::thread holder([&]() {
+    i2c_lock(HAL_I2C_INTERFACE1);
+    held = true;
+    while (!release) {
+      sleepMillis(1);
+    }
+    i2c_unlock(HAL_I2C_INTERFACE1);
+  });
+  while (!held) {
+    sleepMillis(1);
+  }
+  {
+    I2cBusGuard guard(i2c, 5);
+    check("guard timeout", !guard.locked() && i2c.rtn() < 0);
+  }
+  check("failed guard keeps lock", !i2c.tryLock());
+  release = true;
+  holder.join();
+
+  i2c_lock_stats before = lockStats();
+  bool ok = i2c.lock(5);
+  ok = ok && i2c.unlock();
+  i2c_lock_stats stats = lockStats();
+  check("lock after timeout", ok && stats.contended == before.contended);
+}
+//-----------------------------------------------------------------------------
+int main() {
+  single();
+  guard();
+  contention();
+  timeout();
+  check("bad interface", i2c_lock((HAL_I2C_Interface)99) < 0 &&
+        i2c_try_lock((HAL_I2C_Interface)99) < 0 &&
+        i2c_unlock((HAL_I2C_Interface)99) < 0);
+  printf("\n%s\n", failures ? "FAILED" : "PASSED");
+  return failures ? 1 : 0;
+}
@@ -0,0 +1,155 @@
+/* Particle I2cMaster Library
+ * Copyright (C) 2016 by William Greiman
+ *
+ * This file is part of the Particle I2cMaster Library
+ *
+ * This Library is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This Library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with the Particle I2cMaster Library.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+// I2cMaster and the compile time I2cMasterT on a simulated bus.  The same
+// transfers run through both classes and the table shows simulated time
+// and register access counts.  Failed transfers must leave the bus usable.
+#include <stdio.h>
+#include <string.h>
+#include "I2cMaster.h"
+#include "I2cMasterT.h"
+
+const uint8_t DS1307_ADDRESS = 0X68;
+const uint8_t MPU6050_ADDRESS = 0X69;
+const uint8_t ABSENT_ADDRESS = 0X50;
+
+Ds1307Sim ds1307;
+Mpu6050Sim mpu6050;
+I2cMaster i2c;
+I2cMasterT<HAL_I2C_INTERFACE1> i2cT;
+uint8_t buf[64];
+int failures;
+//-----------------------------------------------------------------------------
+void check(const char* name, bool ok) {
+  printf("%-32s %s\n", name, ok ? "ok" : "FAIL");
+  if (!ok) {
+    failures++;
+  }
+}
+//-----------------------------------------------------------------------------
+// Error class is encoded in the return value.
+int errorClass(int rtn) {
+  return rtn < 0 ? -rtn/10000 : 0;
+}
+//-----------------------------------------------------------------------------
+// Register address write with repeated start read.
+template <class Bus>
+bool transferRead(Bus& bus, uint8_t address, uint8_t reg, size_t count) {
+  memset(buf, 0, sizeof(buf));
+  return bus.transfer(address, &reg, 1, buf, count);
+}
+//-----------------------------------------------------------------------------
+template <class Bus>
+bool rtcRead(Bus& bus, uint8_t reg, size_t count) {
+  return transferRead(bus, DS1307_ADDRESS, reg, count) &&
+         memcmp(buf, &ds1307.reg[reg], count) == 0;
+}
+//-----------------------------------------------------------------------------
+template <class Bus>
+bool rtcWrite(Bus& bus, uint8_t reg, size_t count) {
+  uint8_t data[17];
+  data[0] = reg;
+  for (size_t i = 1; i <= count; i++) {
+    data[i] = 0XC0 + i;
+  }
+  return bus.write(DS1307_ADDRESS, data, count + 1) &&
+         memcmp(&ds1307.reg[reg], &data[1], count) == 0;
+}
+//-----------------------------------------------------------------------------
+template <class Bus>
+bool mpuRead(Bus& bus) {
+  if (!transferRead(bus, MPU6050_ADDRESS, 0X3B, 14)) {
+    return false;
+  }
+  for (size_t i = 0; i < 7; i++) {
+    if (((buf[2*i] << 8) | buf[2*i + 1]) !=
+        (uint16_t)(mpu6050.samples*(i + 1))) {
+      return false;
+    }
+  }
+  return true;
+}
+//-----------------------------------------------------------------------------
+// Run one operation and print its costs.
+template <class Bus>
+void row(const char* name, Bus& bus, bool (*op)(Bus&)) {
+  I2cSimStats before = i2cSim.stats();
+  bool ok = op(bus);
+  I2cSimStats st = i2cSim.stats();
+  printf("%-24s %8.1f %6u %6u %6u%s\n", name,
+         (st.nanos - before.nanos)/1000.0,
+         st.polls - before.polls,
+         st.registerReads - before.registerReads,
+         st.registerWrites - before.registerWrites,
+         ok ? "" : "  FAIL");
+  if (!ok) {
+    failures++;
+  }
+}
+//-----------------------------------------------------------------------------
+template <class Bus> bool rtcRead7(Bus& bus) {return rtcRead(bus, 0, 7);}
+template <class Bus> bool rtcRead32(Bus& bus) {return rtcRead(bus, 8, 32);}
+template <class Bus> bool rtcWrite8(Bus& bus) {return rtcWrite(bus, 16, 8);}
+//-----------------------------------------------------------------------------
+template <class Bus>
+void bench(const char* name, Bus& bus) {
+  printf("%s\n", name);
+  printf("%-24s %8s %6s %6s %6s\n", "operation", "us", "polls", "reads",
+         "writes");
+  row("transfer 7 bytes", bus, rtcRead7<Bus>);
+  row("transfer 32 bytes", bus, rtcRead32<Bus>);
+  row("write 8 bytes", bus, rtcWrite8<Bus>);
+  row("mpu6050 14 bytes", bus, mpuRead<Bus>);
+  printf("\n");
+}
+//-----------------------------------------------------------------------------
+// A NACK or timeout ends the I2cMasterT transfer and the bus still works.
+void errors() {
+  bool ok = !transferRead(i2cT, ABSENT_ADDRESS, 0, 4);
+  check("absent device fails", ok && errorClass(i2cT.rtn()) == 3);
+  check("read after absent device", rtcRead(i2cT, 0, 7));
+
+  i2cT.setTimeout(100);
+  i2cSim.i2c1.holdSda(9);
+  ok = !transferRead(i2cT, DS1307_ADDRESS, 0, 4);
+  check("held bus times out", ok && errorClass(i2cT.rtn()) == 2);
+  check("recover held bus", i2cT.recoverBus() && !i2cSim.i2c1.sdaHeld());
+  i2cT.setTimeout(0);
+  check("read after recovery", rtcRead(i2cT, 0, 7));
+}
+//-----------------------------------------------------------------------------
+int main() {
+  i2cSim.i2c1.attach(&ds1307);
+  i2cSim.i2c1.attach(&mpu6050);
+  for (size_t i = 0; i < sizeof(ds1307.reg); i++) {
+    ds1307.reg[i] = i;
+  }
+  check("I2cMaster begin", i2c.begin(400000));
+  bench("I2cMaster 400 kHz", i2c);
+  check("I2cMaster end", i2c.end());
+
+  check("I2cMasterT begin", i2cT.begin(400000));
+  bench("I2cMasterT 400 kHz", i2cT);
+  errors();
+  check("I2cMasterT end", i2cT.end());
+  check("I2cMasterT bad frequency",
+        !i2cT.begin(1000000) && errorClass(i2cT.rtn()) == 1);
+  printf("\n%s\n", failures ? "FAILED" : "PASSED");
+  return failures ? 1 : 0;
+}
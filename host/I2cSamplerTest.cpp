@@ -0,0 +1,215 @@
+/* Particle I2cMaster Library
+ * Copyright (C) 2016 by William Greiman
+ *
+ * This file is part of the Particle I2cMaster Library
+ *
+ * This Library is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This Library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with the Particle I2cMaster Library.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+// I2cSampler on a simulated bus: double buffer swap, acquisition time
+// stamps, error counting and release of the bus after a read that could
+// not be queued.
+#include <stdio.h>
+#include <string.h>
+#include "I2cSampler.h"
+
+const uint8_t DS1307_ADDRESS = 0X68;
+const uint8_t ABSENT_ADDRESS = 0X50;
+const uint32_t TICK_MICROS = 1000;
+
+Ds1307Sim ds1307;
+I2cMaster i2c;
+int failures;
+//-----------------------------------------------------------------------------
+void check(const char* name, bool ok) {
+  printf("%-32s %s\n", name, ok ? "ok" : "FAIL");
+  if (!ok) {
+    failures++;
+  }
+}
+//-----------------------------------------------------------------------------
+// Call tick() then run the bus for one tick period in small steps.
+void tickRun(I2cSampler* sampler) {
+  sampler->tick();
+  for (uint32_t i = 0; i < TICK_MICROS; i++) {
+    i2cSim.cpu(1000);
+  }
+}
+//-----------------------------------------------------------------------------
+// Finish the requests of a job so the next test starts with an empty queue.
+void drain(I2cSampleJob* job) {
+  job->read.wait();
+}
+//-----------------------------------------------------------------------------
+// A published sample stays in the front half while the next is read into
+// the back half.
+void doubleBuffer() {
+  I2cSampler sampler(&i2c, TICK_MICROS);
+  uint8_t buf[8];
+  I2cSampleJob job;
+  job.address = DS1307_ADDRESS;
+  job.reg = 8;
+  job.count = 4;
+  job.periodTicks = 2;
+  job.buffer = buf;
+  sampler.addJob(&job);
+
+  uint8_t a[4] = {0XA0, 0XA1, 0XA2, 0XA3};
+  uint8_t b[4] = {0XB0, 0XB1, 0XB2, 0XB3};
+  uint8_t sample[4];
+  memcpy(&ds1307.reg[8], a, 4);
+  /* Start, then publish at the next tick. */
+  tickRun(&sampler);
+  tickRun(&sampler);
+  bool ok = sampler.read(&job, sample) == 1 && memcmp(sample, a, 4) == 0;
+  check("first sample", ok);
+
+  memcpy(&ds1307.reg[8], b, 4);
+  tickRun(&sampler);
+  tickRun(&sampler);
+  ok = sampler.read(&job, sample) == 2 && memcmp(sample, b, 4) == 0;
+  ok = ok && memcmp(buf + (job.front ^ 1)*4, a, 4) == 0;
+  check("swap keeps previous in back", ok);
+
+  /* The read of the third sample goes to the back half only. */
+  memcpy(&ds1307.reg[8], a, 4);
+  tickRun(&sampler);
+  ok = sampler.read(&job, sample) == 2 && memcmp(sample, b, 4) == 0;
+  check("front stable until publish", ok);
+  tickRun(&sampler);
+  ok = sampler.read(&job, sample) == 3 && memcmp(sample, a, 4) == 0;
+  check("third sample", ok);
+}
+//-----------------------------------------------------------------------------
+// Sample times are bus start times.  A read held behind another transfer
+// is stamped when it starts, not when the tick queued it.
+void timestamps() {
+  I2cSampler sampler(&i2c, TICK_MICROS);
+  uint8_t buf[2];
+  I2cSampleJob job;
+  job.address = DS1307_ADDRESS;
+  job.reg = 8;
+  job.count = 1;
+  job.periodTicks = 1;
+  job.buffer = buf;
+  sampler.addJob(&job);
+  for (int i = 0; i < 20; i++) {
+    tickRun(&sampler);
+  }
+  I2cSampleStats stats;
+  sampler.stats(&job, &stats);
+  check("periodic interval", stats.samples >= 19 && stats.errors == 0 &&
+        stats.maxJitterMicros < 50 && stats.minIntervalMicros > 950 &&
+        stats.maxIntervalMicros < 1050);
+
+  /* 30 bytes at 400 kHz hold the bus for about 700 us. */
+  static uint8_t block[31];
+  block[0] = 8;
+  I2cFuture filler = i2c.writeAsync(DS1307_ADDRESS, block, sizeof(block));
+  uint32_t tickMicros = micros();
+  uint32_t n = stats.samples;
+  tickRun(&sampler);
+  bool ok = filler.ready() && filler.result() == sizeof(block);
+  tickRun(&sampler);
+  tickRun(&sampler);
+  uint32_t sampleMicros = 0;
+  ok = ok && sampler.read(&job, buf, &sampleMicros) > n;
+  check("late start stamped at bus start",
+        ok && sampleMicros - tickMicros > 600);
+  sampler.stats(&job, &stats);
+  /* The read had not finished at the next due tick. */
+  check("late start is an overrun", stats.overruns == 1 &&
+        stats.maxJitterMicros < 50);
+  drain(&job);
+}
+//-----------------------------------------------------------------------------
+// Reads from an absent device count as errors and publish nothing.
+void errors() {
+  I2cSampler sampler(&i2c, TICK_MICROS);
+  uint8_t buf[4];
+  I2cSampleJob job;
+  job.address = ABSENT_ADDRESS;
+  job.reg = 0;
+  job.count = 2;
+  job.periodTicks = 1;
+  job.buffer = buf;
+  sampler.addJob(&job);
+  for (int i = 0; i < 10; i++) {
+    tickRun(&sampler);
+  }
+  I2cSampleStats stats;
+  sampler.stats(&job, &stats);
+  check("absent device errors", stats.errors >= 3 && stats.samples == 0 &&
+        sampler.read(&job, buf) == 0);
+  drain(&job);
+}
+//-----------------------------------------------------------------------------
+// Fill the queue so the write is queued but the read is not.  The write
+// has no stop, so the sampler queues an address only write with stop.
+void stopPending() {
+  I2cSampler sampler(&i2c, TICK_MICROS);
+  uint8_t buf[4];
+  I2cSampleJob job;
+  job.address = DS1307_ADDRESS;
+  job.reg = 8;
+  job.count = 2;
+  job.periodTicks = 1;
+  job.buffer = buf;
+  sampler.addJob(&job);
+
+  static uint8_t block[9];
+  block[0] = 8;
+  I2cFuture filler[I2C_ASYNC_QUEUE_SIZE - 1];
+  bool ok = true;
+  for (size_t i = 0; i < I2C_ASYNC_QUEUE_SIZE - 1; i++) {
+    filler[i] = i2c.writeAsync(DS1307_ADDRESS, block, sizeof(block));
+    ok = ok && filler[i].valid();
+  }
+  tickRun(&sampler);
+  I2cSampleStats stats;
+  sampler.stats(&job, &stats);
+  check("read not queued", ok && job.stopPending && stats.errors == 1);
+
+  /* Nothing else polls the queue.  The sampler must release the bus. */
+  for (int i = 0; i < 10; i++) {
+    tickRun(&sampler);
+  }
+  sampler.stats(&job, &stats);
+  check("stop releases bus", !job.stopPending && stats.overruns >= 1 &&
+        stats.errors == 1 && stats.samples >= 3);
+  uint8_t sample[2];
+  ok = sampler.read(&job, sample) && sample[0] == ds1307.reg[8] &&
+       sample[1] == ds1307.reg[9];
+  check("samples after stop", ok);
+  drain(&job);
+}
+//-----------------------------------------------------------------------------
+int main() {
+  i2cSim.i2c1.attach(&ds1307);
+  if (!i2c.begin(400000)) {
+    printf("begin failed\n");
+    return 1;
+  }
+  doubleBuffer();
+  timestamps();
+  errors();
+  stopPending();
+  uint8_t reg = 0;
+  uint8_t sec;
+  check("bus free after tests", i2c.transfer(DS1307_ADDRESS, &reg, 1,
+        &sec, 1) && sec == ds1307.reg[0]);
+  i2c.end();
+  printf("\n%s\n", failures ? "FAILED" : "PASSED");
+  return failures ? 1 : 0;
+}
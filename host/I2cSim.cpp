@@ -0,0 +1,659 @@
+/* Particle I2cMaster Library
+ * Copyright (C) 2016 by William Greiman
+ *
+ * This file is part of the Particle I2cMaster Library
+ *
+ * This Library is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This Library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with the Particle I2cMaster Library.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+#include "i2c_hal.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+I2cSim i2cSim;
+
+// Register numbers in I2cSimRegister.
+enum {REG_CR1, REG_CR2, REG_OAR1, REG_OAR2, REG_DR,
+      REG_SR1, REG_SR2, REG_CCR, REG_TRISE, REG_COUNT};
+
+// Error flags cleared by writing zero.
+const uint16_t SR1_RC_W0 = I2C_SR1_AF | I2C_SR1_ARLO | I2C_SR1_BERR |
+                           I2C_SR1_OVR | I2C_SR1_TIMEOUT;
+
+// A handler that does not clear its interrupt runs forever on hardware.
+const uint32_t INTERRUPT_STORM = 10000;
+//=============================================================================
+I2cSimRegister::operator uint32_t() const {
+  return m_dev->read(m_id);
+}
+//-----------------------------------------------------------------------------
+I2cSimRegister& I2cSimRegister::operator=(uint32_t value) {
+  m_dev->write(m_id, value);
+  return *this;
+}
+//=============================================================================
+bool I2cRegisterSlave::start(bool read) {
+  m_first = !read;
+  return true;
+}
+//-----------------------------------------------------------------------------
+bool I2cRegisterSlave::write(uint8_t data) {
+  if (m_first) {
+    m_pointer = data % m_size;
+    m_first = false;
+  } else {
+    m_regs[m_pointer] = data;
+    m_pointer = next(m_pointer);
+  }
+  return true;
+}
+//-----------------------------------------------------------------------------
+uint8_t I2cRegisterSlave::read() {
+  update(m_pointer);
+  uint8_t data = m_regs[m_pointer];
+  m_pointer = next(m_pointer);
+  return data;
+}
+//-----------------------------------------------------------------------------
+Ds1307Sim::Ds1307Sim() : I2cRegisterSlave(0X68, reg, sizeof(reg)) {
+  // 12:34:56 Sunday 2016-07-03 in BCD, square wave off.
+  static const uint8_t clock[8] = {0X56, 0X34, 0X12, 0X01,
+                                   0X03, 0X07, 0X16, 0X00};
+  memcpy(reg, clock, sizeof(clock));
+  for (size_t i = sizeof(clock); i < sizeof(reg); i++) {
+    reg[i] = i;
+  }
+}
+//-----------------------------------------------------------------------------
+Mpu6050Sim::Mpu6050Sim()
+  : I2cRegisterSlave(0X69, reg, sizeof(reg)), samples(0) {
+  memset(reg, 0, sizeof(reg));
+  // PWR_MGMT_1 reset value and WHO_AM_I.
+  reg[0X6B] = 0X40;
+  reg[0X75] = 0X68;
+}
+//-----------------------------------------------------------------------------
+void Mpu6050Sim::update(size_t r) {
+  if (r != 0X3B) {
+    return;
+  }
+  // Seven big endian words: accel x, y, z, temperature, gyro x, y, z.
+  samples++;
+  for (size_t i = 0; i < 7; i++) {
+    uint16_t v = samples*(i + 1);
+    reg[0X3B + 2*i] = v >> 8;
+    reg[0X3C + 2*i] = v;
+  }
+}
+//=============================================================================
+I2cSimPeripheral::I2cSimPeripheral(uint16_t sdaPin, uint16_t sclPin)
+  : CR1(this, REG_CR1), CR2(this, REG_CR2), OAR1(this, REG_OAR1),
+    OAR2(this, REG_OAR2), DR(this, REG_DR), SR1(this, REG_SR1),
+    SR2(this, REG_SR2), CCR(this, REG_CCR), TRISE(this, REG_TRISE),
+    m_busy(false), m_hz(100000), m_slave(0), m_rxDma(0), m_txDma(0),
+    m_slaveCount(0),
+    m_sdaPin(sdaPin), m_sclPin(sclPin),
+    m_sdaDriven(false), m_sclDriven(false), m_sdaLow(false), m_sclLow(false),
+    m_sdaHold(0), m_now(0), m_busStart(0), m_busNanos(0), m_busBytes(0) {
+  reset();
+}
+//-----------------------------------------------------------------------------
+void I2cSimPeripheral::attach(I2cSlave* slave) {
+  if (m_slaveCount < sizeof(m_slaves)/sizeof(m_slaves[0])) {
+    m_slaves[m_slaveCount++] = slave;
+  }
+}
+//-----------------------------------------------------------------------------
+void I2cSimPeripheral::holdSda(uint8_t clocks) {
+  m_sdaHold = clocks;
+  if (clocks) {
+    setBusy(true);
+  }
+}
+//-----------------------------------------------------------------------------
+void I2cSimPeripheral::reset() {
+  m_cr1 = m_cr2 = m_oar1 = m_oar2 = m_ccr = m_trise = m_sr1 = 0;
+  m_msl = m_tra = m_data = m_addrRead = false;
+  m_dr = m_shift = m_txData = m_txByte = m_addressByte = 0;
+  m_shiftFull = m_txPending = false;
+  m_lastAck = m_firstRx = true;
+  m_action = NONE;
+  m_actionNanos = 0;
+  if (m_slave) {
+    m_slave->stop();
+  }
+  m_slave = 0;
+  setBusy(m_sdaHold != 0);
+  memset(m_last, 0XFF, sizeof(m_last));
+}
+//-----------------------------------------------------------------------------
+void I2cSimPeripheral::setClock(uint32_t hz) {
+  m_hz = hz ? hz : 100000;
+}
+//-----------------------------------------------------------------------------
+uint64_t I2cSimPeripheral::byteNanos() const {
+  return 9000000000ULL/m_hz;
+}
+//-----------------------------------------------------------------------------
+uint64_t I2cSimPeripheral::busNanos() const {
+  return m_busNanos + (m_busy ? m_now - m_busStart : 0);
+}
+//-----------------------------------------------------------------------------
+void I2cSimPeripheral::setBusy(bool busy) {
+  if (busy && !m_busy) {
+    m_busStart = m_now;
+  } else if (!busy && m_busy) {
+    m_busNanos += m_now - m_busStart;
+  }
+  m_busy = busy;
+}
+//-----------------------------------------------------------------------------
+I2cSlave* I2cSimPeripheral::find(uint8_t address) const {
+  for (size_t i = 0; i < m_slaveCount; i++) {
+    if (m_slaves[i]->address() == address) {
+      return m_slaves[i];
+    }
+  }
+  return 0;
+}
+//-----------------------------------------------------------------------------
+void I2cSimPeripheral::schedule(Action action, uint64_t nanos) {
+  m_action = action;
+  m_actionNanos = m_now + nanos;
+}
+//-----------------------------------------------------------------------------
+// Start the next bus action if the bus is held by the master and idle.
+void I2cSimPeripheral::idleAction() {
+  if (m_action != NONE || !(m_cr1 & I2C_CR1_PE)) {
+    return;
+  }
+  uint64_t bit = byteNanos()/9;
+  if (m_cr1 & I2C_CR1_START) {
+    /* Wait for a bus held by another device */
+    if (!m_busy || m_msl) {
+      schedule(START, m_msl ? bit : bit/2);
+    }
+  } else if (m_cr1 & I2C_CR1_STOP) {
+    if (m_msl) {
+      schedule(STOP, bit);
+    } else {
+      m_cr1 &= ~I2C_CR1_STOP;
+    }
+  } else if (m_msl && m_data && !m_tra && m_lastAck && !m_shiftFull) {
+    startByte(RX_BYTE);
+  } else if (m_msl && m_data && m_tra && m_txPending) {
+    m_txPending = false;
+    m_txByte = m_txData;
+    m_sr1 |= I2C_SR1_TXE;
+    startByte(TX_BYTE);
+  }
+}
+//-----------------------------------------------------------------------------
+void I2cSimPeripheral::startByte(Action action) {
+  m_busBytes++;
+  schedule(action, byteNanos() + (m_slave ? m_slave->stretchNanos : 0));
+}
+//-----------------------------------------------------------------------------
+void I2cSimPeripheral::runUntil(uint64_t nanos) {
+  dmaService();
+  while (m_action != NONE && m_actionNanos <= nanos) {
+    Action action = m_action;
+    m_now = m_actionNanos;
+    m_action = NONE;
+    switch (action) {
+      case START:
+        startDone();
+        break;
+
+      case ADDRESS:
+        addressDone();
+        break;
+
+      case TX_BYTE:
+        txDone();
+        break;
+
+      case RX_BYTE:
+        rxDone();
+        break;
+
+      case STOP:
+        stopDone();
+        break;
+
+      default:
+        break;
+    }
+    dmaService();
+    idleAction();
+  }
+  m_now = nanos;
+}
+//-----------------------------------------------------------------------------
+void I2cSimPeripheral::startDone() {
+  m_cr1 &= ~I2C_CR1_START;
+  m_sr1 &= ~(I2C_SR1_TXE | I2C_SR1_BTF);
+  m_sr1 |= I2C_SR1_SB;
+  m_msl = true;
+  m_tra = false;
+  m_data = false;
+  m_shiftFull = false;
+  m_txPending = false;
+  setBusy(true);
+}
+//-----------------------------------------------------------------------------
+void I2cSimPeripheral::addressDone() {
+  bool read = m_addressByte & 1;
+  I2cSlave* slave = find(m_addressByte >> 1);
+  if (slave && !slave->nackAddress && slave->start(read)) {
+    m_slave = slave;
+    m_tra = !read;
+    m_sr1 |= I2C_SR1_ADDR;
+  } else {
+    m_slave = 0;
+    m_sr1 |= I2C_SR1_AF;
+  }
+}
+//-----------------------------------------------------------------------------
+void I2cSimPeripheral::txDone() {
+  if (!m_slave || !m_slave->write(m_txByte)) {
+    m_sr1 |= I2C_SR1_AF;
+    m_data = false;
+    m_txPending = false;
+    return;
+  }
+  if (m_txPending) {
+    m_txPending = false;
+    m_txByte = m_txData;
+    m_sr1 |= I2C_SR1_TXE;
+    startByte(TX_BYTE);
+  } else if (!(m_cr1 & (I2C_CR1_START | I2C_CR1_STOP))) {
+    /* Clock is stretched until DR is written or a start or stop */
+    m_sr1 |= I2C_SR1_BTF;
+  }
+}
+//-----------------------------------------------------------------------------
+void I2cSimPeripheral::rxDone() {
+  uint8_t data = m_slave ? m_slave->read() : 0XFF;
+  /* With POS set ACK applies to the next byte so the first is acknowledged */
+  m_lastAck = (m_cr1 & I2C_CR1_POS) && m_firstRx ? true : m_cr1 & I2C_CR1_ACK;
+  if (dmaLast()) {
+    /* LAST NACKs the byte that ends the DMA transfer */
+    m_lastAck = false;
+  }
+  m_firstRx = false;
+  if (!(m_sr1 & I2C_SR1_RXNE)) {
+    m_dr = data;
+    m_sr1 |= I2C_SR1_RXNE;
+  } else {
+    /* Clock is stretched until DR is read */
+    m_shift = data;
+    m_shiftFull = true;
+    m_sr1 |= I2C_SR1_BTF;
+  }
+}
+//-----------------------------------------------------------------------------
+void I2cSimPeripheral::stopDone() {
+  m_cr1 &= ~I2C_CR1_STOP;
+  m_sr1 &= ~(I2C_SR1_TXE | I2C_SR1_BTF | I2C_SR1_SB | I2C_SR1_ADDR);
+  if (m_slave) {
+    m_slave->stop();
+    m_slave = 0;
+  }
+  m_msl = false;
+  m_tra = false;
+  m_data = false;
+  m_txPending = false;
+  setBusy(m_sdaHold != 0);
+}
+//-----------------------------------------------------------------------------
+uint32_t I2cSimPeripheral::read(uint8_t id) {
+  i2cSim.cpu(i2cSim.costs.registerNanos);
+  uint32_t value = 0;
+  switch (id) {
+    case REG_CR1:
+      value = m_cr1;
+      break;
+
+    case REG_CR2:
+      value = m_cr2;
+      break;
+
+    case REG_OAR1:
+      value = m_oar1;
+      break;
+
+    case REG_OAR2:
+      value = m_oar2;
+      break;
+
+    case REG_DR:
+      value = readDr();
+      break;
+
+    case REG_SR1:
+      value = m_sr1;
+      if (value & I2C_SR1_ADDR) {
+        m_addrRead = true;
+      }
+      break;
+
+    case REG_SR2:
+      value = (m_busy ? I2C_SR2_BUSY : 0) | (m_msl ? I2C_SR2_MSL : 0) |
+              (m_tra ? I2C_SR2_TRA : 0);
+      /* ADDR is cleared by reading SR1 then SR2 */
+      if (m_addrRead && (m_sr1 & I2C_SR1_ADDR)) {
+        m_sr1 &= ~I2C_SR1_ADDR;
+        m_data = true;
+        m_firstRx = true;
+        m_lastAck = true;
+        if (m_tra) {
+          m_sr1 |= I2C_SR1_TXE;
+        }
+      }
+      m_addrRead = false;
+      break;
+
+    case REG_CCR:
+      value = m_ccr;
+      break;
+
+    case REG_TRISE:
+      value = m_trise;
+      break;
+  }
+  bool status = id == REG_CR1 || id == REG_SR1 || id == REG_SR2;
+  i2cSim.countRead(status && value == m_last[id]);
+  m_last[id] = value;
+  dmaService();
+  idleAction();
+  return value;
+}
+//-----------------------------------------------------------------------------
+void I2cSimPeripheral::write(uint8_t id, uint32_t value) {
+  i2cSim.cpu(i2cSim.costs.registerNanos);
+  i2cSim.countWrite();
+  /* A read after a write is not a poll */
+  memset(m_last, 0XFF, sizeof(m_last));
+  switch (id) {
+    case REG_CR1:
+      if (value & I2C_CR1_SWRST) {
+        reset();
+        m_cr1 = I2C_CR1_SWRST;
+        return;
+      }
+      m_cr1 = value;
+      if (!(value & I2C_CR1_PE)) {
+        /* Disabling the peripheral abandons the transfer */
+        m_cr1 &= ~(I2C_CR1_START | I2C_CR1_STOP);
+        m_sr1 = 0;
+        m_action = NONE;
+        m_msl = m_tra = m_data = false;
+        m_slave = 0;
+        setBusy(m_sdaHold != 0);
+      }
+      break;
+
+    case REG_CR2:
+      m_cr2 = value;
+      break;
+
+    case REG_OAR1:
+      m_oar1 = value;
+      break;
+
+    case REG_OAR2:
+      m_oar2 = value;
+      break;
+
+    case REG_DR:
+      writeDr(value);
+      break;
+
+    case REG_SR1:
+      m_sr1 &= value | ~SR1_RC_W0;
+      break;
+
+    case REG_CCR:
+      m_ccr = value;
+      break;
+
+    case REG_TRISE:
+      m_trise = value;
+      break;
+  }
+  dmaService();
+  idleAction();
+}
+//-----------------------------------------------------------------------------
+// DR access by the CPU or DMA.
+uint8_t I2cSimPeripheral::readDr() {
+  uint8_t value = m_dr;
+  if (m_sr1 & I2C_SR1_RXNE) {
+    m_sr1 &= ~I2C_SR1_RXNE;
+    if (m_shiftFull) {
+      m_dr = m_shift;
+      m_shiftFull = false;
+      m_sr1 &= ~I2C_SR1_BTF;
+      m_sr1 |= I2C_SR1_RXNE;
+    }
+  }
+  return value;
+}
+//-----------------------------------------------------------------------------
+void I2cSimPeripheral::writeDr(uint8_t value) {
+  m_dr = value;
+  if (m_sr1 & I2C_SR1_SB) {
+    /* Address phase */
+    m_sr1 &= ~I2C_SR1_SB;
+    m_addressByte = value;
+    m_busBytes++;
+    I2cSlave* slave = find(value >> 1);
+    schedule(ADDRESS, byteNanos() + (slave ? slave->stretchNanos : 0));
+  } else if (m_msl && m_data && m_tra) {
+    if (m_action == TX_BYTE) {
+      /* DR holds the byte until the shift register is free */
+      m_txPending = true;
+      m_txData = value;
+      m_sr1 &= ~I2C_SR1_TXE;
+    } else if (m_action == NONE) {
+      m_sr1 &= ~I2C_SR1_BTF;
+      m_txByte = value;
+      startByte(TX_BYTE);
+    }
+  }
+}
+//-----------------------------------------------------------------------------
+// True if the byte being received ends a DMA transfer with LAST set.
+bool I2cSimPeripheral::dmaLast() const {
+  return (m_cr2 & (I2C_CR2_DMAEN | I2C_CR2_LAST)) ==
+         (I2C_CR2_DMAEN | I2C_CR2_LAST) &&
+         m_rxDma && (m_rxDma->CR & DMA_SxCR_EN) && m_rxDma->NDTR == 1;
+}
+//-----------------------------------------------------------------------------
+// Serve RXNE and TXE DMA requests.
+void I2cSimPeripheral::dmaService() {
+  I2cSimDmaStream* streams[2] = {m_rxDma, m_txDma};
+  for (size_t i = 0; i < 2; i++) {
+    I2cSimDmaStream* st = streams[i];
+    if (!st || !(st->CR & DMA_SxCR_EN)) {
+      if (st) {
+        st->running = false;
+      }
+      continue;
+    }
+    if (!st->running) {
+      st->running = true;
+      st->index = 0;
+    }
+    if (!(m_cr2 & I2C_CR2_DMAEN)) {
+      continue;
+    }
+    uint8_t* mem = (uint8_t*)st->M0AR;
+    if (st->CR & DMA_DIR_MemoryToPeripheral) {
+      while ((st->CR & DMA_SxCR_EN) && m_msl && m_data && m_tra &&
+             (m_sr1 & I2C_SR1_TXE)) {
+        writeDr(mem[st->index]);
+        st->index += st->CR & DMA_SxCR_MINC ? 1 : 0;
+        if (--st->NDTR == 0) {
+          st->CR &= ~DMA_SxCR_EN;
+        }
+      }
+    } else {
+      while ((st->CR & DMA_SxCR_EN) && (m_sr1 & I2C_SR1_RXNE)) {
+        mem[st->index] = readDr();
+        st->index += st->CR & DMA_SxCR_MINC ? 1 : 0;
+        if (--st->NDTR == 0) {
+          st->CR &= ~DMA_SxCR_EN;
+        }
+      }
+    }
+  }
+}
+//-----------------------------------------------------------------------------
+bool I2cSimPeripheral::eventIrq() const {
+  if (!(m_cr2 & I2C_CR2_ITEVTEN)) {
+    return false;
+  }
+  if (m_sr1 & (I2C_SR1_SB | I2C_SR1_ADDR | I2C_SR1_BTF | I2C_SR1_STOPF)) {
+    return true;
+  }
+  return (m_cr2 & I2C_CR2_ITBUFEN) && (m_sr1 & (I2C_SR1_TXE | I2C_SR1_RXNE));
+}
+//-----------------------------------------------------------------------------
+bool I2cSimPeripheral::errorIrq() const {
+  return (m_cr2 & I2C_CR2_ITERREN) &&
+         (m_sr1 & (I2C_SR1_AF | I2C_SR1_ARLO | I2C_SR1_BERR | I2C_SR1_OVR));
+}
+//-----------------------------------------------------------------------------
+int I2cSimPeripheral::pinRead(uint16_t pin) const {
+  if (pin == m_sdaPin) {
+    return !(m_sdaHold || (m_sdaDriven && m_sdaLow));
+  }
+  return !(m_sclDriven && m_sclLow);
+}
+//-----------------------------------------------------------------------------
+// GPIO access to the bus lines for recovery.
+void I2cSimPeripheral::pinChange(uint16_t pin, bool driven, bool low) {
+  int scl = pinRead(m_sclPin);
+  int sda = pinRead(m_sdaPin);
+  if (pin == m_sdaPin) {
+    m_sdaDriven = driven;
+    m_sdaLow = low;
+  } else {
+    m_sclDriven = driven;
+    m_sclLow = low;
+  }
+  if (!scl && pinRead(m_sclPin) && m_sdaHold) {
+    /* A slave releases SDA after the clocks it missed */
+    m_sdaHold--;
+  }
+  if (!sda && pinRead(m_sdaPin) && pinRead(m_sclPin) && !m_msl) {
+    /* Stop condition frees the bus */
+    setBusy(false);
+  }
+}
+//-----------------------------------------------------------------------------
+void I2cSimPeripheral::pinMode(uint16_t pin, bool drive) {
+  pinChange(pin, drive, pin == m_sdaPin ? m_sdaLow : m_sclLow);
+}
+//-----------------------------------------------------------------------------
+void I2cSimPeripheral::pinWrite(uint16_t pin, bool high) {
+  pinChange(pin, pin == m_sdaPin ? m_sdaDriven : m_sclDriven, !high);
+}
+//=============================================================================
+I2cSim::I2cSim() : i2c1(0, 1), m_nanos(0), m_primask(0), m_isr(false),
+    m_reads(0), m_writes(0), m_polls(0), m_timerReads(0), m_interrupts(0) {
+  i2c1.attachDma(&dma1Stream0, &dma1Stream6);
+  // Photon at 120 MHz with APB1 at 30 MHz.
+  costs.registerNanos = 70;
+  costs.timerNanos = 150;
+  costs.interruptNanos = 250;
+  m_handler[0] = m_handler[1] = 0;
+  m_enabled[0] = m_enabled[1] = false;
+}
+//-----------------------------------------------------------------------------
+void I2cSim::cpu(uint32_t nanos) {
+  m_nanos += nanos;
+  i2c1.runUntil(m_nanos);
+  interrupts();
+}
+//-----------------------------------------------------------------------------
+uint64_t I2cSim::timer() {
+  m_timerReads++;
+  cpu(costs.timerNanos);
+  return m_nanos;
+}
+//-----------------------------------------------------------------------------
+void I2cSim::interrupts() {
+  if (m_isr || m_primask) {
+    return;
+  }
+  for (uint32_t n = 0;; n++) {
+    void (*handler)(void) = 0;
+    if (m_enabled[0] && m_handler[0] && i2c1.eventIrq()) {
+      handler = m_handler[0];
+    } else if (m_enabled[1] && m_handler[1] && i2c1.errorIrq()) {
+      handler = m_handler[1];
+    }
+    if (!handler) {
+      break;
+    }
+    if (n == INTERRUPT_STORM) {
+      fprintf(stderr, "I2cSim: interrupt not cleared by handler\n");
+      abort();
+    }
+    m_isr = true;
+    m_interrupts++;
+    m_nanos += costs.interruptNanos;
+    i2c1.runUntil(m_nanos);
+    handler();
+    m_isr = false;
+  }
+}
+//-----------------------------------------------------------------------------
+void I2cSim::setHandler(int irqn, void (*handler)(void)) {
+  m_handler[irqn == I2C1_ER_IRQn] = handler;
+}
+//-----------------------------------------------------------------------------
+void I2cSim::enableIrq(int irqn, bool enable) {
+  m_enabled[irqn == I2C1_ER_IRQn] = enable;
+  interrupts();
+}
+//-----------------------------------------------------------------------------
+void I2cSim::setPrimask(uint32_t primask) {
+  m_primask = primask;
+  interrupts();
+}
+//-----------------------------------------------------------------------------
+void I2cSim::reset() {
+  i2c1.reset();
+  dma1Stream0.CR = dma1Stream6.CR = 0;
+  m_primask = 0;
+  m_enabled[0] = m_enabled[1] = false;
+}
+//-----------------------------------------------------------------------------
+I2cSimStats I2cSim::stats() const {
+  I2cSimStats st;
+  st.nanos = m_nanos;
+  st.busNanos = i2c1.busNanos();
+  st.registerReads = m_reads;
+  st.registerWrites = m_writes;
+  st.polls = m_polls;
+  st.timerReads = m_timerReads;
+  st.interrupts = m_interrupts;
+  st.busBytes = i2c1.busBytes();
+  return st;
+}
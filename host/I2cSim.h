@@ -0,0 +1,372 @@
+/* Particle I2cMaster Library
+ * Copyright (C) 2016 by William Greiman
+ *
+ * This file is part of the Particle I2cMaster Library
+ *
+ * This Library is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This Library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with the Particle I2cMaster Library.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+#ifndef I2cSim_h
+#define I2cSim_h
+/*
+ * Host simulation of an STM32F2 I2C peripheral in master mode, the bus
+ * and slave devices.  The low level driver is compiled unchanged against
+ * the shim headers in host/shim.  Every peripheral register access and
+ * timer read advances simulated time, so polling loops, interrupts and
+ * timeouts behave as they do on a Photon.
+ */
+#include <stdint.h>
+#include <stddef.h>
+
+class I2cSimPeripheral;
+//-----------------------------------------------------------------------------
+/**
+ * @class I2cSimRegister
+ * @brief A peripheral register.  Reads and writes go to the model.
+ */
+class I2cSimRegister {
+ public:
+  I2cSimRegister(I2cSimPeripheral* dev, uint8_t id) : m_dev(dev), m_id(id) {}
+  operator uint32_t() const;
+  I2cSimRegister& operator=(uint32_t value);
+  I2cSimRegister& operator=(const I2cSimRegister& reg) {
+    return *this = (uint32_t)reg;
+  }
+  I2cSimRegister& operator|=(uint32_t value) {
+    return *this = (uint32_t)*this | value;
+  }
+  I2cSimRegister& operator&=(uint32_t value) {
+    return *this = (uint32_t)*this & value;
+  }
+
+ private:
+  I2cSimPeripheral* m_dev;
+  uint8_t m_id;
+};
+//-----------------------------------------------------------------------------
+/**
+ * @class I2cSlave
+ * @brief Slave device on the simulated bus.
+ */
+class I2cSlave {
+ public:
+  explicit I2cSlave(uint8_t address)
+    : stretchNanos(0), nackAddress(false), m_address(address) {}
+  virtual ~I2cSlave() {}
+
+  /** @return Right justified 7-bit address. */
+  uint8_t address() const {return m_address;}
+
+  /** Start or repeated start addressed to this slave.
+   *
+   * @param[in] read True for a read.
+   *
+   * @return false to NACK the address.
+   */
+  virtual bool start(bool read) = 0;
+
+  /** Byte written by the master.
+   *
+   * @return false to NACK the byte.
+   */
+  virtual bool write(uint8_t data) = 0;
+
+  /** @return Byte read by the master. */
+  virtual uint8_t read() = 0;
+
+  /** Stop condition. */
+  virtual void stop() {}
+
+  /** Clock stretching before the acknowledge of every byte. */
+  uint32_t stretchNanos;
+
+  /** NACK the address phase. */
+  bool nackAddress;
+
+ private:
+  uint8_t m_address;
+};
+//-----------------------------------------------------------------------------
+/**
+ * @class I2cRegisterSlave
+ * @brief Slave with a register file and an auto incrementing pointer.
+ *
+ * The first byte of a write sets the register pointer.
+ */
+class I2cRegisterSlave : public I2cSlave {
+ public:
+  I2cRegisterSlave(uint8_t address, uint8_t* regs, size_t size)
+    : I2cSlave(address), m_regs(regs), m_size(size), m_pointer(0),
+      m_first(false) {}
+  bool start(bool read);
+  bool write(uint8_t data);
+  uint8_t read();
+  /** @return Register pointer. */
+  size_t pointer() const {return m_pointer;}
+
+ protected:
+  /** Called before a register is read by the master. */
+  virtual void update(size_t reg) {(void)reg;}
+  /** @return Register after reg. */
+  virtual size_t next(size_t reg) {return (reg + 1) % m_size;}
+  uint8_t* m_regs;
+  size_t m_size;
+
+ private:
+  size_t m_pointer;
+  bool m_first;
+};
+//-----------------------------------------------------------------------------
+/**
+ * @class Ds1307Sim
+ * @brief DS1307 real time clock.  Registers 0-7 are the clock and
+ *        registers 8-63 are RAM.  The pointer wraps from 63 to zero.
+ */
+class Ds1307Sim : public I2cRegisterSlave {
+ public:
+  Ds1307Sim();
+  uint8_t reg[64];
+};
+//-----------------------------------------------------------------------------
+/**
+ * @class Mpu6050Sim
+ * @brief MPU6050 register file.  Each read of ACCEL_XOUT_H starts a new
+ *        sample in registers 0X3B-0X48.  AD0 is high so the address is 0X69.
+ */
+class Mpu6050Sim : public I2cRegisterSlave {
+ public:
+  Mpu6050Sim();
+  uint8_t reg[128];
+  /** Number of samples read. */
+  uint32_t samples;
+
+ protected:
+  void update(size_t r);
+};
+//-----------------------------------------------------------------------------
+/** Counters for a simulated peripheral. */
+struct I2cSimStats {
+  /** Simulated time in nanoseconds. */
+  uint64_t nanos;
+  /** Time the bus was busy in nanoseconds. */
+  uint64_t busNanos;
+  /** Peripheral register reads. */
+  uint32_t registerReads;
+  /** Peripheral register writes. */
+  uint32_t registerWrites;
+  /** Status register reads that returned the previous value. */
+  uint32_t polls;
+  /** Timer reads. */
+  uint32_t timerReads;
+  /** Interrupt handler calls. */
+  uint32_t interrupts;
+  /** Bytes transferred on the bus, including addresses. */
+  uint32_t busBytes;
+};
+//-----------------------------------------------------------------------------
+/**
+ * @class I2cSimDmaStream
+ * @brief DMA stream.  Used as DMA_Stream_TypeDef.  Registers are plain
+ *        memory, the peripheral moves a byte for each DMA request while EN
+ *        is set and clears EN when NDTR reaches zero.
+ */
+class I2cSimDmaStream {
+ public:
+  I2cSimDmaStream() : CR(0), NDTR(0), PAR(0), M0AR(0), FCR(0),
+                      running(false), index(0) {}
+  volatile uint32_t CR;
+  volatile uint32_t NDTR;
+  volatile uintptr_t PAR;
+  volatile uintptr_t M0AR;
+  volatile uint32_t FCR;
+  /** True after EN has been seen by the peripheral. */
+  bool running;
+  /** Memory offset of the next byte. */
+  size_t index;
+};
+//-----------------------------------------------------------------------------
+/**
+ * @class I2cSimPeripheral
+ * @brief I2C peripheral in master mode.  Used as I2C_TypeDef.
+ */
+class I2cSimPeripheral {
+ public:
+  I2cSimPeripheral(uint16_t sdaPin, uint16_t sclPin);
+  I2cSimRegister CR1;
+  I2cSimRegister CR2;
+  I2cSimRegister OAR1;
+  I2cSimRegister OAR2;
+  I2cSimRegister DR;
+  I2cSimRegister SR1;
+  I2cSimRegister SR2;
+  I2cSimRegister CCR;
+  I2cSimRegister TRISE;
+
+  /** Add a slave to the bus. */
+  void attach(I2cSlave* slave);
+  /** Remove all slaves. */
+  void detachAll() {m_slaveCount = 0;}
+  /** A slave holds SDA low until clocks SCL pulses have been seen. */
+  void holdSda(uint8_t clocks);
+  /** @return true if SDA is held low by a slave. */
+  bool sdaHeld() const {return m_sdaHold != 0;}
+  /** Connect the receive and transmit DMA streams. */
+  void attachDma(I2cSimDmaStream* rx, I2cSimDmaStream* tx) {
+    m_rxDma = rx;
+    m_txDma = tx;
+  }
+
+  // Register model.
+  uint32_t read(uint8_t id);
+  void write(uint8_t id, uint32_t value);
+
+  // Called by the simulator.
+  void setClock(uint32_t hz);
+  void reset();
+  void runUntil(uint64_t nanos);
+  bool eventIrq() const;
+  bool errorIrq() const;
+  void pinMode(uint16_t pin, bool drive);
+  void pinWrite(uint16_t pin, bool high);
+  int pinRead(uint16_t pin) const;
+  bool usesPin(uint16_t pin) const {return pin == m_sdaPin || pin == m_sclPin;}
+  uint64_t busNanos() const;
+  uint32_t busBytes() const {return m_busBytes;}
+
+ private:
+  enum Action {NONE, START, ADDRESS, TX_BYTE, RX_BYTE, STOP};
+  void schedule(Action action, uint64_t nanos);
+  void idleAction();
+  void startByte(Action action);
+  void startDone();
+  void addressDone();
+  void txDone();
+  void rxDone();
+  void stopDone();
+  void pinChange(uint16_t pin, bool driven, bool low);
+  void dmaService();
+  bool dmaLast() const;
+  uint8_t readDr();
+  void writeDr(uint8_t value);
+  uint64_t byteNanos() const;
+  I2cSlave* find(uint8_t address) const;
+  void setBusy(bool busy);
+
+  uint16_t m_cr1;
+  uint16_t m_cr2;
+  uint16_t m_oar1;
+  uint16_t m_oar2;
+  uint16_t m_ccr;
+  uint16_t m_trise;
+  uint16_t m_sr1;
+  bool m_busy;
+  bool m_msl;
+  bool m_tra;
+  bool m_data;
+  bool m_addrRead;
+  uint8_t m_dr;
+  uint8_t m_shift;
+  bool m_shiftFull;
+  bool m_txPending;
+  uint8_t m_txData;
+  uint8_t m_txByte;
+  bool m_lastAck;
+  bool m_firstRx;
+  uint32_t m_hz;
+  Action m_action;
+  uint64_t m_actionNanos;
+  uint8_t m_addressByte;
+  I2cSlave* m_slave;
+  I2cSimDmaStream* m_rxDma;
+  I2cSimDmaStream* m_txDma;
+  I2cSlave* m_slaves[8];
+  size_t m_slaveCount;
+  uint16_t m_sdaPin;
+  uint16_t m_sclPin;
+  bool m_sdaDriven;
+  bool m_sclDriven;
+  bool m_sdaLow;
+  bool m_sclLow;
+  uint8_t m_sdaHold;
+  uint64_t m_now;
+  uint64_t m_busStart;
+  uint64_t m_busNanos;
+  uint32_t m_busBytes;
+  uint32_t m_last[9];
+};
+//-----------------------------------------------------------------------------
+/** CPU costs in nanoseconds. */
+struct I2cSimCosts {
+  /** Peripheral register access on APB1. */
+  uint32_t registerNanos;
+  /** HAL_Timer_Get_Micro_Seconds() call. */
+  uint32_t timerNanos;
+  /** Interrupt entry and exit. */
+  uint32_t interruptNanos;
+};
+//-----------------------------------------------------------------------------
+/**
+ * @class I2cSim
+ * @brief Simulated time, interrupt controller and I2C peripherals.
+ */
+class I2cSim {
+ public:
+  I2cSim();
+  /** Advance time by CPU work and run due bus events and interrupts. */
+  void cpu(uint32_t nanos);
+  /** Timer read. */
+  uint64_t timer();
+  /** Current time in nanoseconds. */
+  uint64_t nanos() const {return m_nanos;}
+  /** Snapshot of the counters for interface zero. */
+  I2cSimStats stats() const;
+  /** Restore the power on state of the peripheral, slaves remain. */
+  void reset();
+  /** Called when a register access count changes. */
+  void countRead(bool poll) {m_reads++; m_polls += poll;}
+  void countWrite() {m_writes++;}
+
+  // NVIC and core.
+  void setHandler(int irqn, void (*handler)(void));
+  void enableIrq(int irqn, bool enable);
+  uint32_t primask() const {return m_primask;}
+  void setPrimask(uint32_t primask);
+  bool inInterrupt() const {return m_isr;}
+
+  /** Peripheral costs. */
+  I2cSimCosts costs;
+  /** I2C1 peripheral. */
+  I2cSimPeripheral i2c1;
+  /** DMA1 stream 0, I2C1 receive. */
+  I2cSimDmaStream dma1Stream0;
+  /** DMA1 stream 6, I2C1 transmit. */
+  I2cSimDmaStream dma1Stream6;
+
+ private:
+  void interrupts();
+  uint64_t m_nanos;
+  uint32_t m_primask;
+  bool m_isr;
+  uint32_t m_reads;
+  uint32_t m_writes;
+  uint32_t m_polls;
+  uint32_t m_timerReads;
+  uint32_t m_interrupts;
+  void (*m_handler[2])(void);
+  bool m_enabled[2];
+};
+
+/** The simulator used by the shim headers. */
+extern I2cSim i2cSim;
+#endif  // I2cSim_h
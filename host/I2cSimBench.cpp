@@ -0,0 +1,233 @@
+/* Particle I2cMaster Library
+ * Copyright (C) 2016 by William Greiman
+ *
+ * This file is part of the Particle I2cMaster Library
+ *
+ * This Library is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This Library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with the Particle I2cMaster Library.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+// Transfer timing and register access counts for the low level driver
+// on a simulated bus with a DS1307 and an MPU6050.
+#include <stdio.h>
+#include <string.h>
+#include "i2c_lld.h"
+
+const HAL_I2C_Interface I2C_IF = HAL_I2C_INTERFACE1;
+const uint8_t DS1307_ADDRESS = 0X68;
+const uint8_t MPU6050_ADDRESS = 0X69;
+const uint8_t ABSENT_ADDRESS = 0X50;
+
+Ds1307Sim ds1307;
+Mpu6050Sim mpu6050;
+uint8_t buf[64];
+int failures;
+I2cSimStats before;
+//-----------------------------------------------------------------------------
+void begin() {
+  before = i2cSim.stats();
+}
+//-----------------------------------------------------------------------------
+// Print counters for the transaction and check the result.
+void end(const char* name, int rtn, bool ok) {
+  I2cSimStats st = i2cSim.stats();
+  printf("%-20s %7d %8.1f %8.1f %6u %6u %6u %6u %4u%s\n", name, rtn,
+         (st.nanos - before.nanos)/1000.0,
+         (st.busNanos - before.busNanos)/1000.0,
+         st.polls - before.polls,
+         st.registerReads - before.registerReads,
+         st.registerWrites - before.registerWrites,
+         st.timerReads - before.timerReads,
+         st.interrupts - before.interrupts,
+         ok ? "" : "  FAIL");
+  if (!ok) {
+    failures++;
+  }
+}
+//-----------------------------------------------------------------------------
+// Error class is encoded in the return value.
+int errorClass(int rtn) {
+  return rtn < 0 ? -rtn/10000 : 0;
+}
+//-----------------------------------------------------------------------------
+bool rtcMatch(uint8_t reg, size_t count) {
+  return memcmp(buf, &ds1307.reg[reg], count) == 0;
+}
+//-----------------------------------------------------------------------------
+// Register address write with stop then read.
+void polledRead(const char* name, uint8_t reg, size_t count) {
+  memset(buf, 0, sizeof(buf));
+  begin();
+  int rtn = i2c_write(I2C_IF, DS1307_ADDRESS, &reg, 1, 1);
+  if (rtn >= 0) {
+    rtn = i2c_read(I2C_IF, DS1307_ADDRESS, buf, count, 1);
+  }
+  end(name, rtn, rtn == (int)count && rtcMatch(reg, count));
+}
+//-----------------------------------------------------------------------------
+// Register address write with repeated start read.
+void transferRead(const char* name, uint8_t reg, size_t count) {
+  memset(buf, 0, sizeof(buf));
+  begin();
+  int rtn = i2c_write_read(I2C_IF, DS1307_ADDRESS, &reg, 1, buf, count, 1);
+  end(name, rtn, rtn == (int)count && rtcMatch(reg, count));
+}
+//-----------------------------------------------------------------------------
+// Polled register address write then interrupt driven read.
+void irqRead(const char* name, uint8_t reg, size_t count) {
+  memset(buf, 0, sizeof(buf));
+  begin();
+  int rtn = i2c_write(I2C_IF, DS1307_ADDRESS, &reg, 1, 0);
+  if (rtn >= 0) {
+    rtn = i2c_start_read(I2C_IF, DS1307_ADDRESS, buf, count, 1);
+  }
+  if (rtn >= 0) {
+    rtn = i2c_wait(I2C_IF);
+  }
+  end(name, rtn, rtn == (int)count && rtcMatch(reg, count));
+}
+//-----------------------------------------------------------------------------
+void polledWrite(const char* name, uint8_t reg, size_t count) {
+  uint8_t data[17];
+  data[0] = reg;
+  for (size_t i = 1; i <= count; i++) {
+    data[i] = 0XA0 + i;
+  }
+  begin();
+  int rtn = i2c_write(I2C_IF, DS1307_ADDRESS, data, count + 1, 1);
+  end(name, rtn, rtn == (int)count + 1 &&
+      memcmp(&ds1307.reg[reg], &data[1], count) == 0);
+}
+//-----------------------------------------------------------------------------
+void irqWrite(const char* name, uint8_t reg, size_t count) {
+  uint8_t data[17];
+  data[0] = reg;
+  for (size_t i = 1; i <= count; i++) {
+    data[i] = 0XB0 + i;
+  }
+  begin();
+  int rtn = i2c_start_write(I2C_IF, DS1307_ADDRESS, data, count + 1, 1);
+  if (rtn >= 0) {
+    rtn = i2c_wait(I2C_IF);
+  }
+  end(name, rtn, rtn == (int)count + 1 &&
+      memcmp(&ds1307.reg[reg], &data[1], count) == 0);
+}
+//-----------------------------------------------------------------------------
+// Burst read of the MPU6050 accel, temperature and gyro registers.
+void mpuRead(const char* name) {
+  uint8_t reg = 0X3B;
+  memset(buf, 0, sizeof(buf));
+  begin();
+  int rtn = i2c_write_read(I2C_IF, MPU6050_ADDRESS, &reg, 1, buf, 14, 1);
+  bool ok = rtn == 14;
+  for (size_t i = 0; ok && i < 7; i++) {
+    ok = ((buf[2*i] << 8) | buf[2*i + 1]) == (uint16_t)(mpu6050.samples*(i + 1));
+  }
+  end(name, rtn, ok);
+}
+//-----------------------------------------------------------------------------
+void absentRead(const char* name, bool irq) {
+  begin();
+  int rtn = irq ? i2c_start_read(I2C_IF, ABSENT_ADDRESS, buf, 1, 1) :
+                  i2c_read(I2C_IF, ABSENT_ADDRESS, buf, 1, 1);
+  if (irq && rtn >= 0) {
+    rtn = i2c_wait(I2C_IF);
+  }
+  if (rtn < 0) {
+    i2c_stop(I2C_IF);
+  }
+  end(name, rtn, errorClass(rtn) == 3);
+}
+//-----------------------------------------------------------------------------
+void scan(const char* name) {
+  uint8_t bitmap[16];
+  begin();
+  int rtn = i2c_scan(I2C_IF, bitmap, 0, 0);
+  end(name, rtn, rtn == 2 && (bitmap[DS1307_ADDRESS >> 3] & 1 << (DS1307_ADDRESS & 7)) &&
+      (bitmap[MPU6050_ADDRESS >> 3] & 1 << (MPU6050_ADDRESS & 7)));
+}
+//-----------------------------------------------------------------------------
+// A slave holds SDA low after a reset in the middle of a read.
+void stuckBus(const char* name) {
+  i2cSim.i2c1.holdSda(5);
+  int rtn = i2c_read(I2C_IF, DS1307_ADDRESS, buf, 7, 1);
+  bool ok = errorClass(rtn) == 2;
+  begin();
+  rtn = i2c_recover(I2C_IF);
+  end(name, rtn, ok && rtn == 0 && !i2cSim.i2c1.sdaHeld());
+}
+//-----------------------------------------------------------------------------
+// A failed interrupt transfer recovers the bus once, not on every wait.
+void waitRecover(const char* name) {
+  uint32_t before;
+  uint32_t after;
+  i2c_auto_recover(I2C_IF, 1);
+  i2c_recover_counts(I2C_IF, &before, 0);
+  i2cSim.i2c1.holdSda(5);
+  begin();
+  int rtn = i2c_start_read(I2C_IF, DS1307_ADDRESS, buf, 7, 1);
+  if (rtn >= 0) {
+    rtn = i2c_wait(I2C_IF);
+  }
+  int again = i2c_wait(I2C_IF);
+  i2c_recover_counts(I2C_IF, &after, 0);
+  i2c_auto_recover(I2C_IF, 0);
+  end(name, rtn, rtn < 0 && again == rtn && after - before == 1 &&
+      !i2cSim.i2c1.sdaHeld());
+}
+//-----------------------------------------------------------------------------
+void runBench(uint32_t hz) {
+  printf("\n%u kHz\n", (unsigned)(hz/1000));
+  printf("%-20s %7s %8s %8s %6s %6s %6s %6s %4s\n", "transaction", "rtn",
+         "time us", "bus us", "polls", "reads", "writes", "timer", "irqs");
+  int rtn = i2c_begin(I2C_IF, hz);
+  if (rtn < 0) {
+    printf("i2c_begin failed: %d\n", rtn);
+    failures++;
+    return;
+  }
+  polledRead("polled read 1", 0, 1);
+  polledRead("polled read 2", 0, 2);
+  polledRead("polled read 3", 0, 3);
+  polledRead("polled read 7", 0, 7);
+  polledRead("polled read 64", 0, 64);
+  transferRead("transfer read 7", 0, 7);
+  transferRead("transfer read 64", 0, 64);
+  irqRead("irq read 1", 0, 1);
+  irqRead("irq read 2", 0, 2);
+  irqRead("irq read 3", 0, 3);
+  irqRead("irq read 64", 0, 64);
+  polledWrite("polled write 8", 8, 8);
+  irqWrite("irq write 8", 16, 8);
+  mpuRead("mpu6050 read 14");
+  mpu6050.stretchNanos = 20000;
+  mpuRead("stretched read 14");
+  mpu6050.stretchNanos = 0;
+  absentRead("polled nack", false);
+  absentRead("irq nack", true);
+  scan("scan");
+  stuckBus("recover");
+  waitRecover("irq recover once");
+  polledRead("read after recover", 0, 7);
+  i2c_end(I2C_IF);
+}
+//-----------------------------------------------------------------------------
+int main() {
+  i2cSim.i2c1.attach(&ds1307);
+  i2cSim.i2c1.attach(&mpu6050);
+  runBench(100000);
+  runBench(400000);
+  printf("\n%s\n", failures ? "FAILED" : "PASSED");
+  return failures ? 1 : 0;
+}
@@ -0,0 +1,131 @@
+/* Particle I2cMaster Library
+ * Copyright (C) 2016 by William Greiman
+ *
+ * This file is part of the Particle I2cMaster Library
+ *
+ * This Library is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This Library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with the Particle I2cMaster Library.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+// DMA transfers of the Photon driver on a simulated bus with a DS1307.
+#include <stdio.h>
+#include <string.h>
+#include "i2c_lld.h"
+
+#if !I2C_DMA_SUPPORT
+#error I2cSimDma requires PLATFORM_ID > 3
+#endif  // !I2C_DMA_SUPPORT
+
+const HAL_I2C_Interface I2C_IF = HAL_I2C_INTERFACE1;
+const uint8_t DS1307_ADDRESS = 0X68;
+const uint8_t ABSENT_ADDRESS = 0X50;
+
+Ds1307Sim ds1307;
+uint8_t buf[64];
+int failures;
+I2cSimStats before;
+//-----------------------------------------------------------------------------
+void begin() {
+  before = i2cSim.stats();
+}
+//-----------------------------------------------------------------------------
+// Print counters for the transaction and check the result.
+void end(const char* name, int rtn, bool ok) {
+  I2cSimStats st = i2cSim.stats();
+  printf("%-20s %7d %8.1f %8.1f %6u %6u %6u\n", name, rtn,
+         (st.nanos - before.nanos)/1000.0,
+         (st.busNanos - before.busNanos)/1000.0,
+         st.polls - before.polls,
+         st.registerReads - before.registerReads,
+         st.registerWrites - before.registerWrites);
+  if (!ok) {
+    printf("%-20s FAIL\n", name);
+    failures++;
+  }
+}
+//-----------------------------------------------------------------------------
+// Error class is encoded in the return value.
+int errorClass(int rtn) {
+  return rtn < 0 ? -rtn/10000 : 0;
+}
+//-----------------------------------------------------------------------------
+// Polled register address write then DMA read.
+void dmaRead(const char* name, uint8_t reg, size_t count) {
+  memset(buf, 0, sizeof(buf));
+  begin();
+  int rtn = i2c_write(I2C_IF, DS1307_ADDRESS, &reg, 1, 0);
+  if (rtn >= 0) {
+    rtn = i2c_read_dma(I2C_IF, DS1307_ADDRESS, buf, count, 1);
+  }
+  if (rtn >= 0) {
+    rtn = i2c_dma_wait(I2C_IF);
+  }
+  end(name, rtn, rtn == (int)count &&
+      memcmp(buf, &ds1307.reg[reg], count) == 0 &&
+      i2c_dma_done(I2C_IF) == 1);
+}
+//-----------------------------------------------------------------------------
+void dmaWrite(const char* name, uint8_t reg, size_t count) {
+  uint8_t data[17];
+  data[0] = reg;
+  for (size_t i = 1; i <= count; i++) {
+    data[i] = 0XD0 + i;
+  }
+  begin();
+  int rtn = i2c_write_dma(I2C_IF, DS1307_ADDRESS, data, count + 1, 1);
+  if (rtn >= 0) {
+    rtn = i2c_dma_wait(I2C_IF);
+  }
+  end(name, rtn, rtn == (int)count + 1 &&
+      memcmp(&ds1307.reg[reg], &data[1], count) == 0);
+}
+//-----------------------------------------------------------------------------
+// An address NACK is an ACK failure from the start call, not a timeout.
+void dmaNack(const char* name, bool read) {
+  uint8_t data[2] = {0, 0};
+  begin();
+  int rtn = read ? i2c_read_dma(I2C_IF, ABSENT_ADDRESS, buf, 7, 1) :
+                   i2c_write_dma(I2C_IF, ABSENT_ADDRESS, data, 2, 1);
+  int again = i2c_dma_wait(I2C_IF);
+  end(name, rtn, errorClass(rtn) == 3 && again == rtn &&
+      i2c_dma_done(I2C_IF) == 1);
+}
+//-----------------------------------------------------------------------------
+void runDma(uint32_t hz) {
+  printf("\n%u kHz\n", (unsigned)(hz/1000));
+  printf("%-20s %7s %8s %8s %6s %6s %6s\n", "transaction", "rtn",
+         "time us", "bus us", "polls", "reads", "writes");
+  int rtn = i2c_begin(I2C_IF, hz);
+  if (rtn < 0) {
+    printf("i2c_begin failed: %d\n", rtn);
+    failures++;
+    return;
+  }
+  dmaRead("dma read 2", 0, 2);
+  dmaRead("dma read 7", 0, 7);
+  dmaRead("dma read 64", 0, 64);
+  dmaWrite("dma write 8", 8, 8);
+  dmaRead("dma read back 8", 8, 8);
+  dmaNack("dma read nack", true);
+  dmaNack("dma write nack", false);
+  dmaRead("read after nack", 0, 7);
+  i2c_end(I2C_IF);
+}
+//-----------------------------------------------------------------------------
+int main() {
+  i2cSim.i2c1.attach(&ds1307);
+  runDma(100000);
+  runDma(400000);
+  printf("\n%s\n", failures ? "FAILED" : "PASSED");
+  return failures ? 1 : 0;
+}
@@ -0,0 +1,158 @@
+/* Particle I2cMaster Library
+ * Copyright (C) 2016 by William Greiman
+ *
+ * This file is part of the Particle I2cMaster Library
+ *
+ * This Library is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This Library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with the Particle I2cMaster Library.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+// Host implementation of the shim HAL functions.
+#include "i2c_hal.h"
+#include "gpio_hal.h"
+#include "timer_hal.h"
+#include "interrupts_hal.h"
+#include "pinmap_impl.h"
+#include "concurrent_hal.h"
+#include "delay_hal.h"
+#include <chrono>
+#include <mutex>
+#include <thread>
+
+RCC_TypeDef simRcc;
+uint32_t SystemCoreClock = 120000000;
+DWT_Type simDwt;
+CoreDebug_Type simCoreDebug;
+//-----------------------------------------------------------------------------
+uint32_t HAL_Timer_Get_Micro_Seconds(void) {
+  return i2cSim.timer()/1000;
+}
+//-----------------------------------------------------------------------------
+uint32_t HAL_Timer_Get_Milli_Seconds(void) {
+  return i2cSim.timer()/1000000;
+}
+//-----------------------------------------------------------------------------
+void HAL_Pin_Mode(pin_t pin, PinMode mode) {
+  if (i2cSim.i2c1.usesPin(pin)) {
+    i2cSim.i2c1.pinMode(pin, mode == OUTPUT);
+  }
+}
+//-----------------------------------------------------------------------------
+void HAL_GPIO_Write(pin_t pin, uint8_t value) {
+  if (i2cSim.i2c1.usesPin(pin)) {
+    i2cSim.i2c1.pinWrite(pin, value != 0);
+  }
+}
+//-----------------------------------------------------------------------------
+int32_t HAL_GPIO_Read(pin_t pin) {
+  return i2cSim.i2c1.usesPin(pin) ? i2cSim.i2c1.pinRead(pin) : 0;
+}
+//-----------------------------------------------------------------------------
+STM32_Pin_Info* HAL_Pin_Map(void) {
+  static STM32_Pin_Info pinMap[2] = {{0, 9}, {0, 8}};
+  return pinMap;
+}
+//-----------------------------------------------------------------------------
+void GPIO_PinAFConfig(void* gpio, uint16_t source, uint8_t af) {
+  (void)gpio;
+  (void)source;
+  (void)af;
+}
+//-----------------------------------------------------------------------------
+void DMA_ClearFlag(DMA_Stream_TypeDef* stream, uint32_t flags) {
+  (void)stream;
+  (void)flags;
+}
+//-----------------------------------------------------------------------------
+void I2C_DeInit(I2C_TypeDef* i2c) {
+  i2c->reset();
+}
+//-----------------------------------------------------------------------------
+void I2C_Init(I2C_TypeDef* i2c, I2C_InitTypeDef* init) {
+  i2c->setClock(init->I2C_ClockSpeed);
+  i2c->CR1 &= ~I2C_CR1_PE;
+  i2c->CCR = 30000000/(2*init->I2C_ClockSpeed);
+  i2c->TRISE = 31;
+  i2c->CR1 |= I2C_CR1_PE;
+  i2c->CR1 = (i2c->CR1 & ~I2C_CR1_ACK) | init->I2C_Ack;
+  i2c->OAR1 = init->I2C_AcknowledgedAddress | init->I2C_OwnAddress1;
+}
+//-----------------------------------------------------------------------------
+void I2C_Cmd(I2C_TypeDef* i2c, FunctionalState state) {
+  if (state) {
+    i2c->CR1 |= I2C_CR1_PE;
+  } else {
+    i2c->CR1 &= ~I2C_CR1_PE;
+  }
+}
+//-----------------------------------------------------------------------------
+void NVIC_EnableIRQ(IRQn_Type irqn) {
+  i2cSim.enableIrq(irqn, true);
+}
+//-----------------------------------------------------------------------------
+void NVIC_DisableIRQ(IRQn_Type irqn) {
+  i2cSim.enableIrq(irqn, false);
+}
+//-----------------------------------------------------------------------------
+int HAL_Set_Direct_Interrupt_Handler(IRQn_Type irqn,
+                                     HAL_Direct_Interrupt_Handler handler,
+                                     uint32_t flags, void* reserved) {
+  (void)reserved;
+  i2cSim.setHandler(irqn,
+                    flags & HAL_DIRECT_INTERRUPT_FLAG_RESTORE ? 0 : handler);
+  return 0;
+}
+//-----------------------------------------------------------------------------
+void __disable_irq(void) {
+  i2cSim.setPrimask(1);
+}
+//-----------------------------------------------------------------------------
+void __enable_irq(void) {
+  i2cSim.setPrimask(0);
+}
+//-----------------------------------------------------------------------------
+uint32_t __get_PRIMASK(void) {
+  return i2cSim.primask();
+}
+//-----------------------------------------------------------------------------
+void __set_PRIMASK(uint32_t primask) {
+  i2cSim.setPrimask(primask);
+}
+//-----------------------------------------------------------------------------
+int os_mutex_create(os_mutex_t* mutex) {
+  *mutex = new std::mutex;
+  return 0;
+}
+//-----------------------------------------------------------------------------
+int os_mutex_destroy(os_mutex_t mutex) {
+  delete static_cast<std::mutex*>(mutex);
+  return 0;
+}
+//-----------------------------------------------------------------------------
+int os_mutex_lock(os_mutex_t mutex) {
+  static_cast<std::mutex*>(mutex)->lock();
+  return 0;
+}
+//-----------------------------------------------------------------------------
+int os_mutex_trylock(os_mutex_t mutex) {
+  return static_cast<std::mutex*>(mutex)->try_lock() ? 0 : 1;
+}
+//-----------------------------------------------------------------------------
+int os_mutex_unlock(os_mutex_t mutex) {
+  static_cast<std::mutex*>(mutex)->unlock();
+  return 0;
+}
+//-----------------------------------------------------------------------------
+void HAL_Delay_Milliseconds(uint32_t millis) {
+  std::this_thread::sleep_for(std::chrono::milliseconds(millis));
+}
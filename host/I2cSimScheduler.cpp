@@ -0,0 +1,248 @@
+/* Particle I2cMaster Library
+ * Copyright (C) 2016 by William Greiman
+ *
+ * This file is part of the Particle I2cMaster Library
+ *
+ * This Library is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This Library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with the Particle I2cMaster Library.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+// Fixed priority and earliest deadline first schedules on a simulated bus.
+//
+// An MPU6050 sample is read every millisecond at high priority with a one
+// millisecond deadline.  The DS1307 time is read every two milliseconds
+// with a tight deadline at the low priority of the DS1307 RAM write, which
+// runs continuously in eight byte chunks with no deadline.  With fixed
+// priority the time read waits for the whole RAM write and falls behind.  For each job the
+// table shows completed reads, deadline misses, worst latency from release
+// to completion and jitter, the spread of that latency.
+//
+// Chunk functions that transfer fewer bytes than asked, or none, are
+// checked first.
+#include <stdio.h>
+#include <string.h>
+#include "I2cBusScheduler.h"
+
+const uint8_t DS1307_ADDRESS = 0X68;
+const uint8_t MPU6050_ADDRESS = 0X69;
+const uint32_t RUN_MICROS = 200000;
+
+Ds1307Sim ds1307;
+Mpu6050Sim mpu6050;
+I2cMaster i2c;
+uint8_t ram[56];
+int failures;
+//-----------------------------------------------------------------------------
+/** A periodic read and its results. */
+struct Job {
+  const char* name;
+  uint32_t periodMicros;
+  I2cTransaction t;
+  uint8_t data[16];
+  // Set by the loop.
+  bool active;
+  uint32_t due;
+  uint32_t release;
+  // Results.
+  uint32_t done;
+  uint32_t errors;
+  uint32_t misses;
+  uint32_t minLatency;
+  uint32_t maxLatency;
+};
+Job jobs[2];
+const size_t JOB_COUNT = sizeof(jobs)/sizeof(jobs[0]);
+//-----------------------------------------------------------------------------
+void check(const char* name, bool ok) {
+  printf("%-32s %s\n", name, ok ? "ok" : "FAIL");
+  if (!ok) {
+    failures++;
+  }
+}
+//-----------------------------------------------------------------------------
+void initJob(Job* job, const char* name, uint8_t address, uint8_t reg,
+             size_t count, uint8_t priority, uint32_t periodMicros,
+             uint32_t deadlineMicros) {
+  job->name = name;
+  job->periodMicros = periodMicros;
+  job->t = I2cTransaction();
+  job->t.address = address;
+  job->t.read = true;
+  job->t.memAddressSize = 1;
+  job->t.memAddress = reg;
+  job->t.buf = job->data;
+  job->t.count = count;
+  job->t.priority = priority;
+  job->t.deadlineMicros = deadlineMicros;
+  job->active = false;
+  job->done = 0;
+  job->errors = 0;
+  job->misses = 0;
+  job->minLatency = UINT32_MAX;
+  job->maxLatency = 0;
+}
+//-----------------------------------------------------------------------------
+// Release due jobs and record finished ones.
+void service(I2cBusScheduler* sched, Job* job, const uint8_t* regs) {
+  if (job->active && job->t.isDone()) {
+    uint32_t latency = micros() - job->release;
+    if (job->t.rtn == (int)job->t.count &&
+        memcmp(job->data, &regs[job->t.memAddress], job->t.count) == 0) {
+      job->done++;
+    } else {
+      job->errors++;
+    }
+    job->misses += job->t.missed;
+    if (latency < job->minLatency) {
+      job->minLatency = latency;
+    }
+    if (latency > job->maxLatency) {
+      job->maxLatency = latency;
+    }
+    job->active = false;
+  }
+  if (!job->active && (int32_t)(micros() - job->due) >= 0) {
+    job->release = job->due;
+    job->due += job->periodMicros;
+    job->active = sched->submit(&job->t);
+    if (!job->active) {
+      job->errors++;
+    }
+  }
+}
+//-----------------------------------------------------------------------------
+// Read at most SHORT_CHUNK bytes of DS1307 RAM and count calls in t->arg.
+const size_t SHORT_CHUNK = 3;
+int shortChunk(I2cMaster* bus, I2cTransaction* t, size_t offset,
+               size_t count) {
+  (*(uint32_t*)t->arg)++;
+  if (count > SHORT_CHUNK) {
+    count = SHORT_CHUNK;
+  }
+  uint8_t mem = t->memAddress + offset;
+  uint8_t* buf = (uint8_t*)t->buf + offset;
+  return bus->transfer(t->address, &mem, 1, buf, count) ? (int)count :
+         bus->rtn();
+}
+//-----------------------------------------------------------------------------
+int stalledChunk(I2cMaster*, I2cTransaction* t, size_t, size_t) {
+  (*(uint32_t*)t->arg)++;
+  return 0;
+}
+//-----------------------------------------------------------------------------
+// Short and stalled chunk functions.
+void chunkFunctions() {
+  I2cBusScheduler sched(&i2c);
+  uint8_t data[20];
+  uint32_t calls = 0;
+  I2cTransaction t;
+  t.address = DS1307_ADDRESS;
+  t.read = true;
+  t.memAddress = 8;
+  t.buf = data;
+  t.count = sizeof(data);
+  t.chunkSize = 8;
+  t.chunkFunction = shortChunk;
+  t.arg = &calls;
+  memset(data, 0, sizeof(data));
+  bool ok = sched.submit(&t);
+  sched.run();
+  check("short chunk continues", ok && t.isDone() &&
+        t.rtn == (int)sizeof(data) && t.done == sizeof(data) &&
+        memcmp(data, &ds1307.reg[8], sizeof(data)) == 0);
+  check("short chunk calls",
+        calls == (sizeof(data) + SHORT_CHUNK - 1)/SHORT_CHUNK);
+
+  calls = 0;
+  t.chunkFunction = stalledChunk;
+  ok = sched.submit(&t);
+  sched.run();
+  check("stalled chunk fails", ok && t.isDone() &&
+        t.rtn == I2cBusScheduler::CHUNK_ERROR && calls == 1 &&
+        sched.pending() == 0);
+  printf("\n");
+}
+//-----------------------------------------------------------------------------
+// Run the jobs and a bulk write under one policy.
+uint32_t bench(const char* name, uint8_t policy) {
+  I2cBusScheduler sched(&i2c, policy);
+  I2cTransaction bulk;
+  bulk.address = DS1307_ADDRESS;
+  bulk.memAddressSize = 1;
+  bulk.memAddress = 8;
+  bulk.buf = ram;
+  bulk.count = sizeof(ram);
+  bulk.chunkSize = 8;
+
+  initJob(&jobs[0], "mpu6050", MPU6050_ADDRESS, 0X3B, 14, 1, 1000, 1000);
+  initJob(&jobs[1], "clock", DS1307_ADDRESS, 0, 7, 0, 2000, 700);
+  uint32_t start = micros() + 1000;
+  for (size_t i = 0; i < JOB_COUNT; i++) {
+    jobs[i].due = start;
+  }
+  const uint8_t* regs[JOB_COUNT] = {mpu6050.reg, ds1307.reg};
+  uint32_t bulkWrites = 0;
+  while ((int32_t)(micros() - (start + RUN_MICROS)) < 0) {
+    for (size_t i = 0; i < JOB_COUNT; i++) {
+      service(&sched, &jobs[i], regs[i]);
+    }
+    if (bulk.state != I2cTransaction::QUEUED) {
+      bulkWrites += bulk.rtn == (int)bulk.count;
+      sched.submit(&bulk);
+    }
+    sched.poll();
+  }
+  sched.run();
+  for (size_t i = 0; i < JOB_COUNT; i++) {
+    service(&sched, &jobs[i], regs[i]);
+  }
+
+  printf("%s: %u bulk writes, %u deadline misses\n", name, bulkWrites,
+         sched.misses());
+  printf("%-10s %6s %6s %6s %8s %8s\n",
+         "job", "done", "errors", "misses", "max us", "jitter");
+  bool ok = true;
+  for (size_t i = 0; i < JOB_COUNT; i++) {
+    Job* job = &jobs[i];
+    printf("%-10s %6u %6u %6u %8u %8u\n", job->name, job->done, job->errors,
+           job->misses, job->maxLatency, job->maxLatency - job->minLatency);
+    ok = ok && job->errors == 0;
+  }
+  printf("\n");
+  check(name, ok);
+  printf("\n");
+  return sched.misses();
+}
+//-----------------------------------------------------------------------------
+int main() {
+  i2cSim.i2c1.attach(&ds1307);
+  i2cSim.i2c1.attach(&mpu6050);
+  if (!i2c.begin(400000)) {
+    printf("begin failed\n");
+    return 1;
+  }
+  for (size_t i = 0; i < sizeof(ram); i++) {
+    ram[i] = i;
+    ds1307.reg[8 + i] = 0X80 + i;
+  }
+  chunkFunctions();
+  uint32_t fixed = bench("fixed priority", I2cBusScheduler::FIXED_PRIORITY);
+  uint32_t edf = bench("earliest deadline", I2cBusScheduler::EARLIEST_DEADLINE);
+  /* jobs hold the EDF results.  Without misses every release completes. */
+  check("EDF meets all deadlines", edf == 0 &&
+        jobs[1].done + 1 >= RUN_MICROS/jobs[1].periodMicros);
+  check("EDF misses no more than fixed", edf <= fixed);
+  i2c.end();
+  printf("\n%s\n", failures ? "FAILED" : "PASSED");
+  return failures ? 1 : 0;
+}
@@ -0,0 +1,124 @@
+/* Particle I2cMaster Library
+ * Copyright (C) 2016 by William Greiman
+ *
+ * This file is part of the Particle I2cMaster Library
+ *
+ * This Library is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This Library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with the Particle I2cMaster Library.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+// MPU6050 sample stream on a simulated bus.  The ring fills, the stream
+// pauses and the overrun count grows by one for each frame time the bus
+// is released.  Popping a frame resumes the stream.
+#include <stdio.h>
+#include <string.h>
+#include "I2cMaster.h"
+
+const uint8_t MPU6050_ADDRESS = 0X69;
+const uint8_t ACCEL_XOUT_H = 0X3B;
+const size_t FRAME_SIZE = 14;
+const size_t FRAME_COUNT = 4;
+// Frame times to leave the stream paused.
+const uint32_t PAUSE_FRAMES = 10;
+
+Mpu6050Sim mpu6050;
+I2cMaster i2c;
+uint8_t ring[FRAME_COUNT*FRAME_SIZE];
+int failures;
+//-----------------------------------------------------------------------------
+void check(const char* name, bool ok) {
+  printf("%-32s %s\n", name, ok ? "ok" : "FAIL");
+  if (!ok) {
+    failures++;
+  }
+}
+//-----------------------------------------------------------------------------
+// Run the simulator in one microsecond steps until n frames are available.
+bool runUntilAvailable(int n) {
+  for (int i = 0; i < 100000; i++) {
+    if (i2c_stream_available(HAL_I2C_INTERFACE1) >= n) {
+      return true;
+    }
+    i2cSim.cpu(1000);
+  }
+  return false;
+}
+//-----------------------------------------------------------------------------
+void runMicros(uint32_t us) {
+  for (uint32_t i = 0; i < us; i++) {
+    i2cSim.cpu(1000);
+  }
+}
+//-----------------------------------------------------------------------------
+// Sample number in the first word of a frame.
+uint16_t sampleOf(const uint8_t* frame) {
+  return (frame[0] << 8) | frame[1];
+}
+//-----------------------------------------------------------------------------
+int main() {
+  i2cSim.i2c1.attach(&mpu6050);
+  if (!i2c.begin(400000)) {
+    printf("begin failed\n");
+    return 1;
+  }
+  bool ok = i2c.startStream(MPU6050_ADDRESS, ACCEL_XOUT_H, ring, FRAME_SIZE,
+                            FRAME_COUNT);
+  ok = ok && runUntilAvailable(1);
+  uint64_t t0 = i2cSim.nanos();
+  ok = ok && runUntilAvailable(3);
+  uint32_t frameMicros = (i2cSim.nanos() - t0)/2000;
+  ok = ok && runUntilAvailable(FRAME_COUNT);
+  check("ring fills", ok && frameMicros > 0);
+
+  /* The stream is paused with a full ring. */
+  uint32_t samples = mpu6050.samples;
+  int before = i2c.streamOverruns();
+  runMicros(PAUSE_FRAMES*frameMicros);
+  int after = i2c.streamOverruns();
+  check("paused stream reads nothing", mpu6050.samples == samples);
+  check("overruns count dropped frames", before >= 1 &&
+        after - before >= (int)PAUSE_FRAMES - 1 &&
+        after - before <= (int)PAUSE_FRAMES + 1);
+  printf("frame %u us, overruns %d after %u frame times\n", frameMicros,
+         after, PAUSE_FRAMES);
+
+  /* A pop resumes the stream and fixes the count for the pause. */
+  uint8_t frame[FRAME_SIZE];
+  ok = i2c.popFrame(frame);
+  int fixed = i2c.streamOverruns();
+  runMicros(frameMicros/2);
+  check("pop resumes stream", ok && fixed >= after &&
+        fixed <= after + 1 && mpu6050.samples > samples);
+
+  /* Frames keep their order and no more are dropped while there is room. */
+  uint16_t last = sampleOf(frame);
+  bool ordered = true;
+  for (size_t i = 1; i < FRAME_COUNT; i++) {
+    ordered = ordered && i2c.popFrame(frame) && sampleOf(frame) == ++last;
+  }
+  ok = runUntilAvailable(1) && i2c.popFrame(frame);
+  check("frames in order", ordered && ok && sampleOf(frame) == last + 1);
+  check("no drops with room", i2c.streamOverruns() == fixed);
+
+  /* Stopping a paused stream counts the frames dropped so far. */
+  ok = runUntilAvailable(FRAME_COUNT);
+  runMicros(PAUSE_FRAMES*frameMicros);
+  int paused = i2c.streamOverruns();
+  ok = ok && i2c.stopStream();
+  int stopped = i2c.streamOverruns();
+  check("stop while paused", ok && stopped >= paused &&
+        stopped <= paused + 1 && stopped - fixed >= (int)PAUSE_FRAMES);
+  i2c.end();
+  printf("\n%s\n", failures ? "FAILED" : "PASSED");
+  return failures ? 1 : 0;
+}
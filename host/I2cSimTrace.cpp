@@ -0,0 +1,107 @@
+/* Particle I2cMaster Library
+ * Copyright (C) 2016 by William Greiman
+ *
+ * This file is part of the Particle I2cMaster Library
+ *
+ * This Library is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This Library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with the Particle I2cMaster Library.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+// Check the trace events of polled and interrupt transfers on the
+// simulated bus and dump them in the format read by I2cTraceDecode.
+#include <stdio.h>
+#include "i2c_lld.h"
+
+const HAL_I2C_Interface I2C_IF = HAL_I2C_INTERFACE1;
+const uint8_t DS1307_ADDRESS = 0X68;
+const uint8_t ABSENT_ADDRESS = 0X50;
+
+Ds1307Sim ds1307;
+uint8_t buf[8];
+int failures;
+//-----------------------------------------------------------------------------
+// Remove the events of one transaction and compare the types.
+void check(const char* name, const uint8_t* types, size_t count) {
+  i2c_trace_event ev[16];
+  size_t n = i2c_trace_read(ev, 16);
+  bool ok = n == count;
+  for (size_t i = 0; i < n; i++) {
+    printf("I2C_TRACE %X %u %u %X\n", (unsigned)ev[i].cycles,
+           ev[i].type, ev[i].bus, ev[i].data);
+    if (ok && ev[i].type != types[i]) {
+      ok = false;
+    }
+  }
+  if (!ok) {
+    fprintf(stderr, "%s: unexpected events\n", name);
+    failures++;
+  }
+}
+//-----------------------------------------------------------------------------
+int main() {
+  const uint8_t polledRead[] = {I2C_TRACE_START, I2C_TRACE_ADDR_ACK,
+    I2C_TRACE_DATA, I2C_TRACE_START, I2C_TRACE_ADDR_ACK, I2C_TRACE_STOP,
+    I2C_TRACE_DATA};
+  const uint8_t polledWrite[] = {I2C_TRACE_START, I2C_TRACE_ADDR_ACK,
+    I2C_TRACE_DATA};
+  // Stop is set before the last byte is read.
+  const uint8_t irqRead[] = {I2C_TRACE_START, I2C_TRACE_ADDR_ACK,
+    I2C_TRACE_STOP, I2C_TRACE_DATA};
+  const uint8_t nack[] = {I2C_TRACE_START, I2C_TRACE_ADDR_NACK,
+    I2C_TRACE_STOP, I2C_TRACE_ERROR};
+  uint8_t reg = 0;
+
+  i2cSim.i2c1.attach(&ds1307);
+  printf("I2C_TRACE HZ %u\n", (unsigned)SystemCoreClock);
+  if (i2c_begin(I2C_IF, 400000) < 0) {
+    fprintf(stderr, "i2c_begin failed\n");
+    return 1;
+  }
+  i2c_write_read(I2C_IF, DS1307_ADDRESS, &reg, 1, buf, 7, 1);
+  check("polled read", polledRead, sizeof(polledRead));
+
+  i2c_write(I2C_IF, DS1307_ADDRESS, &reg, 1, 0);
+  check("polled write", polledWrite, sizeof(polledWrite));
+  if (i2c_start_read(I2C_IF, DS1307_ADDRESS, buf, 7, 1) >= 0) {
+    i2c_wait(I2C_IF);
+  }
+  check("irq read", irqRead, sizeof(irqRead));
+
+  if (i2c_start_read(I2C_IF, ABSENT_ADDRESS, buf, 1, 1) >= 0) {
+    i2c_wait(I2C_IF);
+  }
+  // The NACK arrives in the error interrupt before ADDR is set.
+  check("irq nack", nack, sizeof(nack));
+
+  // Events are dropped, not overwritten, when the buffer is full.
+  for (size_t i = 0; i < I2C_TRACE_SIZE; i++) {
+    i2c_write(I2C_IF, DS1307_ADDRESS, &reg, 1, 1);
+  }
+  if (i2c_trace_dropped() == 0) {
+    fprintf(stderr, "full buffer: no dropped events\n");
+    failures++;
+  }
+  i2c_trace_event last;
+  size_t n = 0;
+  while (i2c_trace_read(&last, 1) == 1) {
+    n++;
+  }
+  if (n != I2C_TRACE_SIZE) {
+    fprintf(stderr, "full buffer: %u events\n", (unsigned)n);
+    failures++;
+  }
+  printf("I2C_TRACE DROPPED %u\n", (unsigned)i2c_trace_dropped());
+  i2c_end(I2C_IF);
+  fprintf(stderr, "%s\n", failures ? "FAILED" : "PASSED");
+  return failures ? 1 : 0;
+}
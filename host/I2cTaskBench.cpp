@@ -0,0 +1,199 @@
+/* Particle I2cMaster Library
+ * Copyright (C) 2016 by William Greiman
+ *
+ * This file is part of the Particle I2cMaster Library
+ *
+ * This Library is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This Library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with the Particle I2cMaster Library.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+// I2cTask coroutines compared with a hand written I2cFuture polling loop.
+// Three periodic reads share the simulated bus: DS1307 time every 10 ms,
+// DS1307 RAM every 5 ms and an MPU6050 sample every 1 ms.  Each scheme
+// runs for the same simulated time.  The table shows completed reads,
+// the worst start lateness, and host time per pass of the main loop.
+#include <stdio.h>
+#include <string.h>
+#include <chrono>
+#include "I2cTask.h"
+#if !defined(__cpp_impl_coroutine) || __cpp_impl_coroutine < 201902L
+#error I2cTaskBench needs C++20 coroutines
+#endif
+
+const uint8_t DS1307_ADDRESS = 0X68;
+const uint8_t MPU6050_ADDRESS = 0X69;
+const uint32_t RUN_MICROS = 100000;
+// CPU time of other work in each pass of the main loop.
+const uint32_t LOOP_NANOS = 2000;
+
+Ds1307Sim ds1307;
+Mpu6050Sim mpu6050;
+I2cMaster i2c;
+int failures;
+//-----------------------------------------------------------------------------
+/** A periodic register read and its results. */
+struct Job {
+  const char* name;
+  uint8_t address;
+  uint8_t reg;
+  uint8_t count;
+  uint32_t periodMicros;
+  uint8_t* regs;
+  // Results.
+  uint32_t done;
+  uint32_t errors;
+  uint32_t maxLateMicros;
+};
+Job jobs[] = {
+  {"clock", DS1307_ADDRESS, 0, 7, 10000, ds1307.reg, 0, 0, 0},
+  {"ram", DS1307_ADDRESS, 8, 56, 5000, ds1307.reg, 0, 0, 0},
+  {"mpu6050", MPU6050_ADDRESS, 0X3B, 14, 1000, mpu6050.reg, 0, 0, 0},
+};
+const size_t JOB_COUNT = sizeof(jobs)/sizeof(jobs[0]);
+//-----------------------------------------------------------------------------
+void check(const char* name, bool ok) {
+  printf("%-32s %s\n", name, ok ? "ok" : "FAIL");
+  if (!ok) {
+    failures++;
+  }
+}
+//-----------------------------------------------------------------------------
+// Record lateness of a start due at wake.
+void started(Job* job, uint32_t wake) {
+  uint32_t late = micros() - wake;
+  if (late > job->maxLateMicros) {
+    job->maxLateMicros = late;
+  }
+}
+//-----------------------------------------------------------------------------
+void finished(Job* job, const uint8_t* data, int rtn) {
+  if (rtn == job->count && memcmp(data, &job->regs[job->reg], job->count) == 0) {
+    job->done++;
+  } else {
+    job->errors++;
+  }
+}
+//-----------------------------------------------------------------------------
+I2cTask jobTask(Job* job, uint32_t start) {
+  uint8_t data[64];
+  uint32_t wake = start;
+  for (;;) {
+    co_await I2cTaskScheduler::delayUntil(wake);
+    started(job, wake);
+    i2c.writeAsync(job->address, &job->reg, 1, false);
+    int rtn = co_await i2c.readAsync(job->address, data, job->count);
+    finished(job, data, rtn);
+    wake += job->periodMicros;
+  }
+}
+//-----------------------------------------------------------------------------
+// Run the jobs as coroutines.
+uint32_t runTasks(uint32_t start) {
+  I2cTaskScheduler scheduler;
+  for (size_t i = 0; i < JOB_COUNT; i++) {
+    scheduler.spawn(jobTask(&jobs[i], start));
+  }
+  uint32_t passes = 0;
+  while ((int32_t)(micros() - (start + RUN_MICROS)) < 0) {
+    scheduler.poll();
+    i2cSim.cpu(LOOP_NANOS);
+    passes++;
+  }
+  /* Let the last reads finish before the scheduler and its tasks go. */
+  while (!i2c.isDone()) {
+    i2cSim.cpu(LOOP_NANOS);
+  }
+  return passes;
+}
+//-----------------------------------------------------------------------------
+// Run the jobs as a state machine that polls futures.
+uint32_t runPolled(uint32_t start) {
+  uint8_t data[JOB_COUNT][64];
+  uint32_t wake[JOB_COUNT];
+  bool busy[JOB_COUNT];
+  I2cFuture read[JOB_COUNT];
+  for (size_t i = 0; i < JOB_COUNT; i++) {
+    wake[i] = start;
+    busy[i] = false;
+  }
+  uint32_t passes = 0;
+  while ((int32_t)(micros() - (start + RUN_MICROS)) < 0) {
+    for (size_t i = 0; i < JOB_COUNT; i++) {
+      Job* job = &jobs[i];
+      if (busy[i]) {
+        if (read[i].ready()) {
+          finished(job, data[i], read[i].result());
+          wake[i] += job->periodMicros;
+          busy[i] = false;
+        }
+      } else if ((int32_t)(micros() - wake[i]) >= 0) {
+        started(job, wake[i]);
+        i2c.writeAsync(job->address, &job->reg, 1, false);
+        read[i] = i2c.readAsync(job->address, data[i], job->count);
+        busy[i] = true;
+      }
+    }
+    i2cSim.cpu(LOOP_NANOS);
+    passes++;
+  }
+  for (size_t i = 0; i < JOB_COUNT; i++) {
+    if (busy[i]) {
+      read[i].wait();
+    }
+  }
+  return passes;
+}
+//-----------------------------------------------------------------------------
+void run(const char* name, uint32_t (*scheme)(uint32_t)) {
+  for (size_t i = 0; i < JOB_COUNT; i++) {
+    jobs[i].done = 0;
+    jobs[i].errors = 0;
+    jobs[i].maxLateMicros = 0;
+  }
+  uint32_t start = micros() + 1000;
+  std::chrono::steady_clock::time_point t = std::chrono::steady_clock::now();
+  uint32_t passes = scheme(start);
+  double hostNanos = std::chrono::duration<double, std::nano>(
+                       std::chrono::steady_clock::now() - t).count();
+  printf("%s: %u passes, %.1f host ns/pass\n", name, passes, hostNanos/passes);
+  printf("%-10s %6s %6s %8s\n", "job", "done", "errors", "late us");
+  bool ok = true;
+  for (size_t i = 0; i < JOB_COUNT; i++) {
+    Job* job = &jobs[i];
+    printf("%-10s %6u %6u %8u\n", job->name, job->done, job->errors,
+           job->maxLateMicros);
+    /* Every period in the run except the last gets a read. */
+    ok = ok && job->errors == 0 &&
+         job->done + 1 >= RUN_MICROS/job->periodMicros;
+  }
+  printf("\n");
+  check(name, ok);
+  printf("\n");
+}
+//-----------------------------------------------------------------------------
+int main() {
+  i2cSim.i2c1.attach(&ds1307);
+  i2cSim.i2c1.attach(&mpu6050);
+  if (!i2c.begin(400000)) {
+    printf("begin failed\n");
+    return 1;
+  }
+  for (size_t i = 0; i < sizeof(ds1307.reg); i++) {
+    ds1307.reg[i] = i;
+  }
+  run("coroutine tasks", runTasks);
+  run("polled futures", runPolled);
+  i2c.end();
+  printf("%s\n", failures ? "FAILED" : "PASSED");
+  return failures ? 1 : 0;
+}
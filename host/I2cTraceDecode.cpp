@@ -0,0 +1,117 @@
+/* Particle I2cMaster Library
+ * Copyright (C) 2016 by William Greiman
+ *
+ * This file is part of the Particle I2cMaster Library
+ *
+ * This Library is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This Library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with the Particle I2cMaster Library.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+// Decode a trace dump into a timeline.
+//
+// Usage: I2cTraceDecode [file]
+//
+// Reads the dump from file or standard input.  Lines that do not start
+// with I2C_TRACE are ignored so a serial log can be decoded directly.
+//
+//   I2C_TRACE HZ <cpu clock>
+//   I2C_TRACE <cycles hex> <type> <bus> <data hex>
+//   I2C_TRACE DROPPED <count>
+//
+// Each event is printed with the time since the first event and since
+// the previous event.  The duration of each transaction, from START to
+// STOP or ERROR, is printed when it ends.
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "i2c_lld.h"
+
+static const char* const name[] = {"?", "START", "ADDR ACK", "ADDR NACK",
+  "ADDR TIMEOUT", "DATA", "STOP", "ERROR"};
+
+struct BusState {
+  bool active;
+  uint32_t start;
+};
+//-----------------------------------------------------------------------------
+int main(int argc, char* argv[]) {
+  FILE* in = stdin;
+  if (argc > 1 && !(in = fopen(argv[1], "r"))) {
+    perror(argv[1]);
+    return 1;
+  }
+  char line[128];
+  double cyclesPerMicro = 120;
+  bool first = true;
+  uint32_t origin = 0;
+  uint32_t last = 0;
+  uint32_t events = 0;
+  int errors = 0;
+  BusState bus[4];
+  memset(bus, 0, sizeof(bus));
+  printf("%12s %10s %-5s %-13s %s\n", "time us", "delta us", "bus", "event", "data");
+  while (fgets(line, sizeof(line), in)) {
+    char* p = strstr(line, "I2C_TRACE ");
+    if (!p) {
+      continue;
+    }
+    p += strlen("I2C_TRACE ");
+    unsigned long value;
+    unsigned cycles, type, n, data;
+    if (sscanf(p, "HZ %lu", &value) == 1) {
+      cyclesPerMicro = value/1e6;
+      continue;
+    }
+    if (sscanf(p, "DROPPED %lu", &value) == 1) {
+      printf("dropped events: %lu\n", value);
+      continue;
+    }
+    if (sscanf(p, "%x %u %u %x", &cycles, &type, &n, &data) != 4) {
+      fprintf(stderr, "bad line: %s", line);
+      errors++;
+      continue;
+    }
+    if (first) {
+      origin = last = cycles;
+      first = false;
+    }
+    events++;
+    printf("%12.1f %10.1f I2C%-2u %-13s", (uint32_t)(cycles - origin)/cyclesPerMicro,
+           (uint32_t)(cycles - last)/cyclesPerMicro, n,
+           type <= I2C_TRACE_ERROR ? name[type] : name[0]);
+    last = cycles;
+    if (type == I2C_TRACE_ADDR_ACK || type == I2C_TRACE_ADDR_NACK ||
+        type == I2C_TRACE_TIMEOUT) {
+      printf(" 0X%02X %c", data >> 1, data & 1 ? 'R' : 'W');
+    } else if (type == I2C_TRACE_DATA) {
+      printf(" %u bytes", data);
+    } else if (type == I2C_TRACE_ERROR) {
+      printf(" rtn: -%u", data);
+    }
+    printf("\n");
+    BusState* b = &bus[n & 3];
+    if (type == I2C_TRACE_START && !b->active) {
+      b->active = true;
+      b->start = cycles;
+    } else if ((type == I2C_TRACE_STOP || type == I2C_TRACE_ERROR) && b->active) {
+      b->active = false;
+      printf("%12s %10s I2C%-2u transaction %.1f us\n", "", "", n,
+             (uint32_t)(cycles - b->start)/cyclesPerMicro);
+    }
+  }
+  printf("%u events\n", (unsigned)events);
+  if (in != stdin) {
+    fclose(in);
+  }
+  return errors ? 1 : 0;
+}
@@ -0,0 +1,200 @@
+/* Particle I2cMaster Library
+ * Copyright (C) 2016 by William Greiman
+ *
+ * This file is part of the Particle I2cMaster Library
+ *
+ * This Library is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This Library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with the Particle I2cMaster Library.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+// Cost of I2Cdev calls through one bus backend.  The same source is built
+// with I2CDEV_BUS set to I2cMaster, WireMaster and MockBus.  Host time per
+// call for MockBus is the overhead of the I2Cdev layer alone.  The
+// simulated backends also report simulated time and bus bytes per call.
+// A sweep times readWords() and writeWords() of 1 to 64 words.
+#include <stdio.h>
+#include <string.h>
+#include <chrono>
+#include "I2Cdev.h"
+#include "MockBus.h"
+
+#define BACKEND_NAME(bus) BACKEND_STRING(bus)
+#define BACKEND_STRING(bus) #bus
+
+const uint8_t MPU6050_ADDRESS = 0X69;
+const uint8_t GYRO_CONFIG = 0X1B;
+const uint8_t ACCEL_XOUT_H = 0X3B;
+const uint8_t XG_OFFS_USRH = 0X13;
+const uint32_t NUM_CALLS = 1000;
+// Word transfer sweep at register zero.  64 words cover the register file.
+const uint8_t SWEEP_MAX_WORDS = 64;
+const uint32_t SWEEP_CALLS = 10;
+
+I2CDEV_BUS I2C;
+Mpu6050Sim mpu6050;
+I2Cdev dev(I2C);
+// Register file of the device, in the simulator or the mock.
+uint8_t* regs = mpu6050.reg;
+int failures;
+uint8_t sweepWords;
+//-----------------------------------------------------------------------------
+bool busBegin(I2cMaster& bus) {
+  i2cSim.i2c1.attach(&mpu6050);
+  return bus.begin(400000);
+}
+bool busBegin(WireMasterBase& bus) {
+  i2cSim.i2c1.attach(&mpu6050);
+  bus.begin();
+  bus.setClock(400000);
+  return true;
+}
+bool busBegin(MockBus& bus) {
+  regs = bus.reg;
+  return true;
+}
+uint32_t busBytes(I2cMaster&) {return i2cSim.stats().busBytes;}
+uint32_t busBytes(WireMasterBase&) {return i2cSim.stats().busBytes;}
+uint32_t busBytes(MockBus& bus) {return bus.busBytes;}
+//-----------------------------------------------------------------------------
+bool readByte() {
+  uint8_t b;
+  return dev.readByte(MPU6050_ADDRESS, GYRO_CONFIG, &b) == 1 &&
+         b == regs[GYRO_CONFIG];
+}
+//-----------------------------------------------------------------------------
+bool readBytes() {
+  uint8_t b[14];
+  return dev.readBytes(MPU6050_ADDRESS, ACCEL_XOUT_H, sizeof(b), b) == 14 &&
+         memcmp(b, &regs[ACCEL_XOUT_H], sizeof(b)) == 0;
+}
+//-----------------------------------------------------------------------------
+bool readWords() {
+  uint16_t w[3];
+  return dev.readWords(MPU6050_ADDRESS, XG_OFFS_USRH, 3, w) == 3 &&
+         w[2] == (regs[XG_OFFS_USRH + 4] << 8 | regs[XG_OFFS_USRH + 5]);
+}
+//-----------------------------------------------------------------------------
+bool writeByte() {
+  return dev.writeByte(MPU6050_ADDRESS, GYRO_CONFIG, 0X18) &&
+         regs[GYRO_CONFIG] == 0X18;
+}
+//-----------------------------------------------------------------------------
+// Read-modify-write of FS_SEL.
+bool writeBits() {
+  return dev.writeBits(MPU6050_ADDRESS, GYRO_CONFIG, 4, 2, 1) &&
+         (regs[GYRO_CONFIG] & 0X18) == 0X08;
+}
+//-----------------------------------------------------------------------------
+bool writeWords() {
+  uint16_t w[3] = {0X0102, 0X0304, 0X0506};
+  return dev.writeWords(MPU6050_ADDRESS, XG_OFFS_USRH, 3, w) &&
+         regs[XG_OFFS_USRH] == 0X01 && regs[XG_OFFS_USRH + 5] == 0X06;
+}
+//-----------------------------------------------------------------------------
+bool readWordsSweep() {
+  uint16_t w[SWEEP_MAX_WORDS];
+  if (dev.readWords(MPU6050_ADDRESS, 0, sweepWords, w) != sweepWords) {
+    return false;
+  }
+  for (uint8_t i = 0; i < sweepWords; i++) {
+    if (w[i] != (regs[2*i] << 8 | regs[2*i + 1])) {
+      return false;
+    }
+  }
+  return true;
+}
+//-----------------------------------------------------------------------------
+bool writeWordsSweep() {
+  uint16_t w[SWEEP_MAX_WORDS];
+  for (uint8_t i = 0; i < sweepWords; i++) {
+    w[i] = 0X0102*(i + sweepWords);
+  }
+  if (!dev.writeWords(MPU6050_ADDRESS, 0, sweepWords, w)) {
+    return false;
+  }
+  for (uint8_t i = 0; i < sweepWords; i++) {
+    if (regs[2*i] != (w[i] >> 8) || regs[2*i + 1] != (w[i] & 0XFF)) {
+      return false;
+    }
+  }
+  return true;
+}
+//-----------------------------------------------------------------------------
+// Per call host nanoseconds, simulated microseconds and bus bytes.
+struct Cost {
+  double hostNanos;
+  double simMicros;
+  double bytes;
+};
+//-----------------------------------------------------------------------------
+bool measure(bool (*op)(), uint32_t calls, Cost* cost) {
+  bool ok = true;
+  uint64_t simNanos = i2cSim.nanos();
+  uint32_t bytes = busBytes(I2C);
+  std::chrono::steady_clock::time_point t = std::chrono::steady_clock::now();
+  for (uint32_t i = 0; i < calls; i++) {
+    ok = op() && ok;
+  }
+  cost->hostNanos = std::chrono::duration<double, std::nano>(
+                      std::chrono::steady_clock::now() - t).count()/calls;
+  cost->simMicros = (i2cSim.nanos() - simNanos)/1000.0/calls;
+  cost->bytes = (double)(busBytes(I2C) - bytes)/calls;
+  if (!ok) {
+    failures++;
+  }
+  return ok;
+}
+//-----------------------------------------------------------------------------
+void run(const char* name, bool (*op)()) {
+  Cost c;
+  bool ok = measure(op, NUM_CALLS, &c);
+  printf("%-20s %10.1f %10.2f %8.1f%s\n", name, c.hostNanos, c.simMicros,
+         c.bytes, ok ? "" : "  FAIL");
+}
+//-----------------------------------------------------------------------------
+// readWords() and writeWords() of 1 to SWEEP_MAX_WORDS words.
+void sweep() {
+  printf("\n%-6s %10s %10s %10s %10s\n", "words", "read ns",
+         "read us", "write ns", "write us");
+  for (sweepWords = 1; sweepWords <= SWEEP_MAX_WORDS; sweepWords++) {
+    Cost r;
+    Cost w;
+    bool ok = measure(readWordsSweep, SWEEP_CALLS, &r);
+    ok = measure(writeWordsSweep, SWEEP_CALLS, &w) && ok;
+    printf("%-6u %10.1f %10.2f %10.1f %10.2f%s\n", sweepWords, r.hostNanos,
+           r.simMicros, w.hostNanos, w.simMicros, ok ? "" : "  FAIL");
+  }
+}
+//-----------------------------------------------------------------------------
+int main() {
+  if (!busBegin(I2C)) {
+    printf("begin failed\n");
+    return 1;
+  }
+  printf("Backend: %s\n\n", BACKEND_NAME(I2CDEV_BUS));
+  printf("%-20s %10s %10s %8s\n", "call", "host ns", "sim us", "bytes");
+  run("readByte", readByte);
+  run("readBytes 14", readBytes);
+  run("readWords 3", readWords);
+  run("writeByte", writeByte);
+  run("writeBits", writeBits);
+  run("writeWords 3", writeWords);
+  if (!dev.shadowEnable(MPU6050_ADDRESS)) {
+    printf("shadowEnable failed\n");
+    return 1;
+  }
+  run("writeBits cached", writeBits);
+  sweep();
+  printf("\n%s\n", failures ? "FAILED" : "PASSED");
+  return failures ? 1 : 0;
+}
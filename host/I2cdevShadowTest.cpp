@@ -0,0 +1,140 @@
+/* Particle I2cMaster Library
+ * Copyright (C) 2016 by William Greiman
+ *
+ * This file is part of the Particle I2cMaster Library
+ *
+ * This Library is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This Library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with the Particle I2cMaster Library.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+// I2Cdev register shadow cache on a simulated MPU6050: hits and misses,
+// volatile registers, invalidation and long word writes.
+#include <stdio.h>
+#include "MPU6050.h"
+
+I2cMaster I2C;
+Mpu6050Sim mpu6050;
+MPU6050 mpu(I2C, MPU6050_ADDRESS_AD0_HIGH);
+int failures;
+//-----------------------------------------------------------------------------
+void check(const char* name, bool ok) {
+  printf("%-32s %s\n", name, ok ? "ok" : "FAIL");
+  if (!ok) {
+    failures++;
+  }
+}
+//-----------------------------------------------------------------------------
+uint32_t busBytes() {
+  return i2cSim.stats().busBytes;
+}
+//-----------------------------------------------------------------------------
+// The first update reads the bus, later updates only write.
+void hitMiss() {
+  I2Cdev::shadowHits = 0;
+  I2Cdev::shadowMisses = 0;
+  mpu.setFullScaleGyroRange(MPU6050_GYRO_FS_2000);
+  check("first update misses", I2Cdev::shadowHits == 0 &&
+        I2Cdev::shadowMisses == 1 && mpu6050.reg[MPU6050_RA_GYRO_CONFIG] == 0X18);
+  uint32_t n = busBytes();
+  mpu.setFullScaleGyroRange(MPU6050_GYRO_FS_500);
+  /* Address, register and data. */
+  check("cached update hits", I2Cdev::shadowHits == 1 &&
+        I2Cdev::shadowMisses == 1 && busBytes() - n == 3 &&
+        mpu6050.reg[MPU6050_RA_GYRO_CONFIG] == 0X08);
+  /* A change behind the cache is not seen. */
+  mpu6050.reg[MPU6050_RA_GYRO_CONFIG] = 0X88;
+  mpu.setFullScaleGyroRange(MPU6050_GYRO_FS_1000);
+  check("update uses cached value", I2Cdev::shadowHits == 2 &&
+        mpu6050.reg[MPU6050_RA_GYRO_CONFIG] == 0X10);
+}
+//-----------------------------------------------------------------------------
+// USER_CTRL is volatile so every update reads it.
+void volatileRegister() {
+  uint32_t hits = I2Cdev::shadowHits;
+  uint32_t misses = I2Cdev::shadowMisses;
+  mpu6050.reg[MPU6050_RA_USER_CTRL] = 0X40;
+  mpu.setI2CMasterModeEnabled(true);
+  bool ok = mpu6050.reg[MPU6050_RA_USER_CTRL] == 0X60;
+  mpu6050.reg[MPU6050_RA_USER_CTRL] = 0X44;
+  mpu.setI2CMasterModeEnabled(false);
+  ok = ok && mpu6050.reg[MPU6050_RA_USER_CTRL] == 0X44;
+  check("volatile register reads", ok && I2Cdev::shadowHits == hits &&
+        I2Cdev::shadowMisses == misses + 2);
+}
+//-----------------------------------------------------------------------------
+// reset() and disabling the cache drop cached values.
+void invalidate() {
+  mpu.reset();
+  uint32_t misses = I2Cdev::shadowMisses;
+  mpu6050.reg[MPU6050_RA_GYRO_CONFIG] = 0X80;
+  mpu.setFullScaleGyroRange(MPU6050_GYRO_FS_250);
+  check("reset invalidates", I2Cdev::shadowMisses == misses + 1 &&
+        mpu6050.reg[MPU6050_RA_GYRO_CONFIG] == 0X80);
+
+  mpu.setShadowCacheEnabled(false);
+  uint32_t hits = I2Cdev::shadowHits;
+  misses = I2Cdev::shadowMisses;
+  mpu.setFullScaleGyroRange(MPU6050_GYRO_FS_500);
+  check("disabled cache not counted", I2Cdev::shadowHits == hits &&
+        I2Cdev::shadowMisses == misses &&
+        mpu6050.reg[MPU6050_RA_GYRO_CONFIG] == 0X88);
+
+  mpu.setShadowCacheEnabled(true);
+  mpu6050.reg[MPU6050_RA_GYRO_CONFIG] = 0XE0;
+  mpu.setFullScaleGyroRange(MPU6050_GYRO_FS_2000);
+  check("enable starts empty", I2Cdev::shadowMisses == misses + 1 &&
+        mpu6050.reg[MPU6050_RA_GYRO_CONFIG] == 0XF8);
+}
+//-----------------------------------------------------------------------------
+// A long word write is one transaction and leaves the caller's words as
+// they were.
+void writeWords() {
+  const uint8_t N = 40;
+  uint16_t words[N];
+  for (uint8_t i = 0; i < N; i++) {
+    words[i] = 0X1234 + 0X0101*i;
+  }
+  uint32_t n = busBytes();
+  bool ok = mpu.writeWords(MPU6050_ADDRESS_AD0_HIGH, 0, N, words);
+  for (uint8_t i = 0; i < N; i++) {
+    ok = ok && mpu6050.reg[2*i] == (words[i] >> 8) &&
+         mpu6050.reg[2*i + 1] == (words[i] & 0XFF);
+  }
+  check("writeWords data", ok);
+  /* Address, register and data. */
+  check("writeWords one transaction", busBytes() - n == 2 + 2*N);
+  ok = true;
+  for (uint8_t i = 0; i < N; i++) {
+    ok = ok && words[i] == 0X1234 + 0X0101*i;
+  }
+  check("writeWords restores data", ok);
+}
+//-----------------------------------------------------------------------------
+int main() {
+  i2cSim.i2c1.attach(&mpu6050);
+  if (!I2C.begin(400000)) {
+    printf("begin failed\n");
+    return 1;
+  }
+  if (!mpu.setShadowCacheEnabled(true)) {
+    printf("setShadowCacheEnabled failed\n");
+    return 1;
+  }
+  hitMiss();
+  volatileRegister();
+  invalidate();
+  writeWords();
+  I2C.end();
+  printf("\n%s\n", failures ? "FAILED" : "PASSED");
+  return failures ? 1 : 0;
+}
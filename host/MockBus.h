@@ -0,0 +1,103 @@
+/* Particle I2cMaster Library
+ * Copyright (C) 2016 by William Greiman
+ *
+ * This file is part of the Particle I2cMaster Library
+ *
+ * This Library is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This Library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with the Particle I2cMaster Library.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+#ifndef MockBus_h
+#define MockBus_h
+/*
+ * Host mock bus for I2Cdev.  One register slave with an auto incrementing
+ * pointer, no simulated time.  Build I2Cdev.cpp with I2CDEV_BUS=MockBus and
+ * I2CDEV_BACKEND_HEADER="MockBus.h" to measure the cost of the I2Cdev layer
+ * without a bus.
+ */
+#include <string.h>
+#include "I2cdevBackend.h"
+
+/**
+ * @class MockBus
+ * @brief Runs i2c_segment lists against a register file in memory.
+ */
+class MockBus {
+ public:
+  explicit MockBus(uint8_t address = 0X69)
+    : address(address), transfers(0), busBytes(0), m_pointer(0) {
+    memset(reg, 0, sizeof(reg));
+  }
+
+  /** Run a segment list.  See i2c_transfer().
+   *
+   * @return false if a segment is addressed to another device.
+   */
+  bool transfer(const i2c_segment* seg, size_t count) {
+    bool first = false;
+    transfers++;
+    for (size_t i = 0; i < count; i++) {
+      uint8_t* buf = (uint8_t*)seg[i].buf;
+      if (!(seg[i].flags & I2C_SEG_NOSTART)) {
+        busBytes++;
+        if (seg[i].addr != address) {
+          return false;
+        }
+        first = true;
+      }
+      busBytes += seg[i].len;
+      for (size_t j = 0; j < seg[i].len; j++) {
+        if (seg[i].flags & I2C_SEG_READ) {
+          buf[j] = reg[m_pointer];
+          m_pointer = (m_pointer + 1) % sizeof(reg);
+        } else if (first) {
+          m_pointer = buf[j] % sizeof(reg);
+          first = false;
+        } else {
+          reg[m_pointer] = buf[j];
+          m_pointer = (m_pointer + 1) % sizeof(reg);
+        }
+      }
+    }
+    return true;
+  }
+
+  /** Right justified 7-bit address of the slave. */
+  uint8_t address;
+  /** Register file. */
+  uint8_t reg[128];
+  /** Number of transfer() calls. */
+  uint32_t transfers;
+  /** Bytes a real bus would carry, including addresses. */
+  uint32_t busBytes;
+
+ private:
+  size_t m_pointer;
+};
+
+template<> struct I2cdevBackend<MockBus> {
+  static bool write(MockBus &bus, uint8_t devAddr, uint8_t regAddr, const void *data, size_t length) {
+    i2c_segment seg[2] = {{devAddr, 0, &regAddr, 1},
+                          {devAddr, I2C_SEG_NOSTART, (void*)data, length}};
+    return bus.transfer(seg, 2);
+  }
+  static bool writeRead(MockBus &bus, uint8_t devAddr, uint8_t regAddr, void *data, size_t length) {
+    i2c_segment seg[2] = {{devAddr, 0, &regAddr, 1},
+                          {devAddr, I2C_SEG_READ, data, length}};
+    return bus.transfer(seg, 2);
+  }
+  static bool scatter(MockBus &bus, const i2c_segment *seg, size_t count) {
+    return bus.transfer(seg, count);
+  }
+};
+#endif  // MockBus_h
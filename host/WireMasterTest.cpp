@@ -0,0 +1,149 @@
+/* Particle I2cMaster Library
+ * Copyright (C) 2016 by William Greiman
+ *
+ * This file is part of the Particle I2cMaster Library
+ *
+ * This Library is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This Library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with the Particle I2cMaster Library.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+// WireMaster requestFrom() with an internal address, readFrom() and block
+// readBytes() with a DS1307 on the simulator.
+#include <stdio.h>
+#include <string.h>
+// User code may forward declare WireMaster.
+class WireMaster;
+#include "WireMaster.h"
+#include "I2cSim.h"
+
+const uint8_t DS1307_ADDRESS = 0X68;
+// First RAM register.
+const uint8_t RAM_START = 8;
+
+WireMaster wire;
+Ds1307Sim ds1307;
+int failures;
+
+// requestFrom(address, 0, stop) must resolve to requestFrom(uint8_t, size_t,
+// uint8_t), not to readFrom() with a null buffer.
+static_assert(sizeof(wire.requestFrom(DS1307_ADDRESS, 0, 1)) == sizeof(size_t),
+              "requestFrom(address, 0, stop) is ambiguous");
+//-----------------------------------------------------------------------------
+void check(const char* name, bool ok) {
+  printf("%-32s %s\n", name, ok ? "ok" : "FAIL");
+  if (!ok) {
+    failures++;
+  }
+}
+//-----------------------------------------------------------------------------
+// Fill RAM with a pattern.
+void fillRam() {
+  for (size_t i = RAM_START; i < sizeof(ds1307.reg); i++) {
+    ds1307.reg[i] = 0X80 + i;
+  }
+}
+//-----------------------------------------------------------------------------
+// Set the DS1307 register pointer.
+bool setPointer(uint8_t r) {
+  wire.beginTransmission(DS1307_ADDRESS);
+  wire.write(r);
+  return wire.endTransmission() == 0;
+}
+//-----------------------------------------------------------------------------
+// Remove count bytes with read() and compare to registers at r.
+bool readMatches(uint8_t r, size_t count) {
+  for (size_t i = 0; i < count; i++) {
+    if (wire.read() != ds1307.reg[r + i]) {
+      return false;
+    }
+  }
+  return wire.available() == 0;
+}
+//-----------------------------------------------------------------------------
+void internalAddress() {
+  fillRam();
+  uint32_t bytes = i2cSim.stats().busBytes;
+  bool ok = wire.requestFrom(DS1307_ADDRESS, 6, RAM_START + 4, 1, true) == 6;
+  // Address, register, address, six data bytes.
+  check("isize 1 bus bytes", ok && i2cSim.stats().busBytes - bytes == 9);
+  check("isize 1 data", ok && readMatches(RAM_START + 4, 6));
+
+  // isize 0 reads from the current pointer.
+  ok = setPointer(RAM_START + 20);
+  ok = ok && wire.requestFrom(DS1307_ADDRESS, 3, 0XFF, 0, true) == 3;
+  check("isize 0 current pointer", ok && readMatches(RAM_START + 20, 3));
+
+  // Two bytes, most significant first.  The DS1307 takes the first as the
+  // register and the second as data for that register.
+  fillRam();
+  ok = wire.requestFrom(DS1307_ADDRESS, 2, 0X2055, 2, true) == 2;
+  check("isize 2 msb first", ok && ds1307.reg[0X20] == 0X55 &&
+        readMatches(0X21, 2));
+
+  // isize over four is clamped to the low four bytes of iaddress.
+  fillRam();
+  bytes = i2cSim.stats().busBytes;
+  ok = wire.requestFrom(DS1307_ADDRESS, 4, 0X30AABBCC, 6, true) == 4;
+  check("isize 6 clamped to 4", ok &&
+        i2cSim.stats().busBytes - bytes == 1 + 4 + 1 + 4);
+  check("isize 6 data", ok && ds1307.reg[0X30] == 0XAA &&
+        ds1307.reg[0X31] == 0XBB && ds1307.reg[0X32] == 0XCC &&
+        readMatches(0X33, 4));
+
+  // quantity is clamped to the buffer size.
+  fillRam();
+  ok = wire.requestFrom(DS1307_ADDRESS, 40, RAM_START, 1, true) ==
+       WIRE_MASTER_BUFFER_LENGTH;
+  check("quantity clamped", ok &&
+        readMatches(RAM_START, WIRE_MASTER_BUFFER_LENGTH));
+
+  check("absent device", wire.requestFrom(0X50, 4, 0, 1, true) == 0 &&
+        wire.available() == 0 && wire.rtn() < 0);
+}
+//-----------------------------------------------------------------------------
+void blockRead() {
+  fillRam();
+  char c[4];
+  uint8_t b[16];
+  bool ok = wire.requestFrom(DS1307_ADDRESS, 10, RAM_START, 1, true) == 10;
+  ok = ok && wire.readBytes(c, sizeof(c)) == sizeof(c) &&
+       memcmp(c, &ds1307.reg[RAM_START], sizeof(c)) == 0;
+  check("readBytes char partial", ok && wire.available() == 6);
+  ok = ok && wire.read() == ds1307.reg[RAM_START + 4];
+  ok = ok && wire.readBytes(b, sizeof(b)) == 5 &&
+       memcmp(b, &ds1307.reg[RAM_START + 5], 5) == 0;
+  check("readBytes uint8_t remainder", ok && wire.available() == 0);
+  check("readBytes empty", wire.readBytes(b, sizeof(b)) == 0 &&
+        wire.read() == -1);
+}
+//-----------------------------------------------------------------------------
+void readFrom() {
+  fillRam();
+  uint8_t b[48];
+  bool ok = setPointer(RAM_START);
+  ok = ok && wire.readFrom(DS1307_ADDRESS, b, sizeof(b)) == sizeof(b);
+  check("readFrom over buffer size", ok &&
+        memcmp(b, &ds1307.reg[RAM_START], sizeof(b)) == 0);
+  check("readFrom not buffered", wire.available() == 0);
+}
+//-----------------------------------------------------------------------------
+int main() {
+  i2cSim.i2c1.attach(&ds1307);
+  wire.begin();
+  wire.setClock(400000);
+  internalAddress();
+  blockRead();
+  readFrom();
+  printf("\n%s\n", failures ? "FAILED" : "PASSED");
+  return failures ? 1 : 0;
+}
@@ -0,0 +1,38 @@
+/* Particle I2cMaster Library
+ * Copyright (C) 2016 by William Greiman
+ *
+ * This file is part of the Particle I2cMaster Library
+ *
+ * This Library is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This Library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with the Particle I2cMaster Library.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+#ifndef gpio_hal_h
+#define gpio_hal_h
+// Host shim.  Only the I2C pins of the simulated peripheral are modeled.
+#include <stdint.h>
+
+typedef uint16_t pin_t;
+
+typedef enum PinMode {
+  INPUT, OUTPUT, INPUT_PULLUP, INPUT_PULLDOWN, AF_OUTPUT_PUSHPULL,
+  AF_OUTPUT_DRAIN, AN_INPUT, AN_OUTPUT
+} PinMode;
+
+#define D0 0
+#define D1 1
+
+void HAL_Pin_Mode(pin_t pin, PinMode mode);
+void HAL_GPIO_Write(pin_t pin, uint8_t value);
+int32_t HAL_GPIO_Read(pin_t pin);
+#endif  // gpio_hal_h
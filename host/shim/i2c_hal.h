@@ -0,0 +1,147 @@
+/* Particle I2cMaster Library
+ * Copyright (C) 2016 by William Greiman
+ *
+ * This file is part of the Particle I2cMaster Library
+ *
+ * This Library is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This Library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with the Particle I2cMaster Library.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+#ifndef i2c_hal_h
+#define i2c_hal_h
+/*
+ * Host shim for the Particle HAL and the STM32 device definitions used by
+ * the low level driver.  I2C_TypeDef is the simulated peripheral.
+ */
+#include <stdint.h>
+#include <stddef.h>
+#include "I2cSim.h"
+
+#define __IO volatile
+
+typedef enum HAL_I2C_Interface {
+  HAL_I2C_INTERFACE1 = 0,
+  HAL_I2C_INTERFACE2 = 1,
+  HAL_I2C_INTERFACE3 = 2
+} HAL_I2C_Interface;
+
+typedef I2cSimPeripheral I2C_TypeDef;
+#define I2C1 (&i2cSim.i2c1)
+
+// I2C register bits.
+#define I2C_CR1_PE      0X0001
+#define I2C_CR1_START   0X0100
+#define I2C_CR1_STOP    0X0200
+#define I2C_CR1_ACK     0X0400
+#define I2C_CR1_POS     0X0800
+#define I2C_CR1_SWRST   0X8000
+#define I2C_CR2_ITERREN 0X0100
+#define I2C_CR2_ITEVTEN 0X0200
+#define I2C_CR2_ITBUFEN 0X0400
+#define I2C_CR2_DMAEN   0X0800
+#define I2C_CR2_LAST    0X1000
+#define I2C_SR1_SB      0X0001
+#define I2C_SR1_ADDR    0X0002
+#define I2C_SR1_BTF     0X0004
+#define I2C_SR1_STOPF   0X0010
+#define I2C_SR1_RXNE    0X0040
+#define I2C_SR1_TXE     0X0080
+#define I2C_SR1_BERR    0X0100
+#define I2C_SR1_ARLO    0X0200
+#define I2C_SR1_AF      0X0400
+#define I2C_SR1_OVR     0X0800
+#define I2C_SR1_TIMEOUT 0X4000
+#define I2C_SR2_MSL     0X0001
+#define I2C_SR2_BUSY    0X0002
+#define I2C_SR2_TRA     0X0004
+
+// Clock enable.
+typedef struct {
+  __IO uint32_t APB1ENR;
+  __IO uint32_t AHB1ENR;
+} RCC_TypeDef;
+extern RCC_TypeDef simRcc;
+#define RCC (&simRcc)
+#define RCC_APB1Periph_I2C1 0X00200000
+#define RCC_AHB1Periph_DMA1 0X00200000
+
+// DMA streams for I2C1.  Only used if PLATFORM_ID > 3.
+typedef I2cSimDmaStream DMA_Stream_TypeDef;
+#define DMA1_Stream0 (&i2cSim.dma1Stream0)
+#define DMA1_Stream6 (&i2cSim.dma1Stream6)
+#define DMA_SxCR_EN     0X00000001
+#define DMA_SxCR_MINC   0X00000400
+#define DMA_SxCR_PL_1   0X00020000
+#define DMA_DIR_PeripheralToMemory 0X00000000
+#define DMA_DIR_MemoryToPeripheral 0X00000040
+#define DMA_Channel_1   0X02000000
+#define DMA_FLAG_FEIF0  0X10800001
+#define DMA_FLAG_DMEIF0 0X10800004
+#define DMA_FLAG_TEIF0  0X10000008
+#define DMA_FLAG_HTIF0  0X10000010
+#define DMA_FLAG_TCIF0  0X10000020
+#define DMA_FLAG_FEIF6  0X20010000
+#define DMA_FLAG_DMEIF6 0X20040000
+#define DMA_FLAG_TEIF6  0X20080000
+#define DMA_FLAG_HTIF6  0X20100000
+#define DMA_FLAG_TCIF6  0X20200000
+void DMA_ClearFlag(DMA_Stream_TypeDef* stream, uint32_t flags);
+
+// Standard peripheral library.
+typedef enum {DISABLE = 0, ENABLE = !DISABLE} FunctionalState;
+typedef struct {
+  uint32_t I2C_ClockSpeed;
+  uint16_t I2C_Mode;
+  uint16_t I2C_DutyCycle;
+  uint16_t I2C_OwnAddress1;
+  uint16_t I2C_Ack;
+  uint16_t I2C_AcknowledgedAddress;
+} I2C_InitTypeDef;
+#define I2C_Mode_I2C                 0X0000
+#define I2C_DutyCycle_2              0XBFFF
+#define I2C_Ack_Enable               0X0400
+#define I2C_AcknowledgedAddress_7bit 0X4000
+void I2C_DeInit(I2C_TypeDef* i2c);
+void I2C_Init(I2C_TypeDef* i2c, I2C_InitTypeDef* init);
+void I2C_Cmd(I2C_TypeDef* i2c, FunctionalState state);
+
+// Core.
+typedef enum IRQn_Type {I2C1_EV_IRQn = 31, I2C1_ER_IRQn = 32} IRQn_Type;
+void NVIC_EnableIRQ(IRQn_Type irqn);
+void NVIC_DisableIRQ(IRQn_Type irqn);
+void __disable_irq(void);
+void __enable_irq(void);
+uint32_t __get_PRIMASK(void);
+void __set_PRIMASK(uint32_t primask);
+
+/** CPU clock of a Photon. */
+extern uint32_t SystemCoreClock;
+
+/** Cycle counter at 120 MHz derived from simulated time. */
+struct I2cSimCycles {
+  operator uint32_t() const {return i2cSim.nanos()*120/1000;}
+};
+typedef struct {
+  __IO uint32_t CTRL;
+  I2cSimCycles CYCCNT;
+} DWT_Type;
+typedef struct {
+  __IO uint32_t DEMCR;
+} CoreDebug_Type;
+extern DWT_Type simDwt;
+extern CoreDebug_Type simCoreDebug;
+#define DWT (&simDwt)
+#define CoreDebug (&simCoreDebug)
+#define CoreDebug_DEMCR_TRCENA_Msk (1UL << 24)
+#define DWT_CTRL_CYCCNTENA_Msk 1UL
+#endif  // i2c_hal_h
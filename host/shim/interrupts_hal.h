@@ -0,0 +1,35 @@
+/* Particle I2cMaster Library
+ * Copyright (C) 2016 by William Greiman
+ *
+ * This file is part of the Particle I2cMaster Library
+ *
+ * This Library is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This Library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with the Particle I2cMaster Library.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+#ifndef interrupts_hal_h
+#define interrupts_hal_h
+// Host shim.  Handlers run from the simulator between register accesses.
+#include "i2c_hal.h"
+
+typedef void (*HAL_Direct_Interrupt_Handler)(void);
+
+typedef enum HAL_Direct_Interrupt_Flags {
+  HAL_DIRECT_INTERRUPT_FLAG_NONE    = 0,
+  HAL_DIRECT_INTERRUPT_FLAG_RESTORE = 1
+} HAL_Direct_Interrupt_Flags;
+
+int HAL_Set_Direct_Interrupt_Handler(IRQn_Type irqn,
+                                     HAL_Direct_Interrupt_Handler handler,
+                                     uint32_t flags, void* reserved);
+#endif  // interrupts_hal_h
@@ -0,0 +1,34 @@
+/* Particle I2cMaster Library
+ * Copyright (C) 2016 by William Greiman
+ *
+ * This file is part of the Particle I2cMaster Library
+ *
+ * This Library is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This Library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with the Particle I2cMaster Library.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+#ifndef pinmap_impl_h
+#define pinmap_impl_h
+// Host shim.  Alternate function setup is ignored by the simulator.
+#include "gpio_hal.h"
+
+typedef struct STM32_Pin_Info {
+  void*   gpio_peripheral;
+  uint8_t gpio_pin_source;
+} STM32_Pin_Info;
+
+#define GPIO_AF_I2C1 0X04
+
+STM32_Pin_Info* HAL_Pin_Map(void);
+void GPIO_PinAFConfig(void* gpio, uint16_t source, uint8_t af);
+#endif  // pinmap_impl_h
@@ -89,9 +89,184 @@ THE SOFTWARE.
 
 #endif
 
+#if (I2CDEV_IMPLEMENTATION == I2CDEV_PARTICLE_I2CMASTER)
+    // Bulk operations of the I2CDEV_BUS class
+    typedef I2cdevBackend<I2CDEV_BUS> Backend;
+    // Shadow cache entries belong to a bus and a device address
+    #define I2CDEV_KEY getBus()
+#else
+    #define I2CDEV_KEY 0
+#endif
+
 /** Default constructor.
+ * Without I2CDEV_SINGLE_BUS the device uses the global I2C object.
  */
 I2Cdev::I2Cdev() {
+#if !I2CDEV_SINGLE_BUS
+    bus = &I2C;
+#endif
+}
+
+#if !I2CDEV_SINGLE_BUS
+/** Bus specific constructor.
+ * @param bus I2CDEV_BUS object for the bus the device is on
+ */
+I2Cdev::I2Cdev(I2CDEV_BUS &bus) {
+    this->bus = &bus;
+}
+#endif
+
+// Convert between big-endian device words and little-endian host words.
+// dst may equal src.  On Cortex-M one REV16 swaps two words, elsewhere the
+// plain loop is left for the compiler to vectorise.
+static void swapWords(uint16_t *dst, const uint16_t *src, uint8_t length) {
+    uint8_t i = 0;
+#ifdef __CORTEX_M
+    for (; i + 1 < length; i += 2) {
+        uint32_t w;
+        memcpy(&w, &src[i], 4);
+        w = __REV16(w);
+        memcpy(&dst[i], &w, 4);
+    }
+#endif  // __CORTEX_M
+    for (; i < length; i++) {
+        dst[i] = (uint16_t)((src[i] << 8) | (src[i] >> 8));
+    }
+}
+
+#if I2CDEV_SHADOW_DEVICES
+// Write-through copy of the registers of a device.  Only the
+// read-modify-write bit functions read from the copy.
+struct I2cdevShadow {
+    const void *bus;
+    uint8_t devAddr;            // zero if the entry is free
+    uint32_t valid[4];          // bit set if reg[] holds the register value
+    uint32_t volatileMask[4];   // bit set if the register is never cached
+    uint8_t reg[128];
+};
+static I2cdevShadow shadow[I2CDEV_SHADOW_DEVICES];
+
+static I2cdevShadow* shadowFind(const void *bus, uint8_t devAddr) {
+    for (uint8_t i = 0; i < I2CDEV_SHADOW_DEVICES; i++) {
+        if (shadow[i].devAddr == devAddr && devAddr != 0 && shadow[i].bus == bus) {
+            return &shadow[i];
+        }
+    }
+    return 0;
+}
+
+static bool shadowCached(I2cdevShadow *s, uint8_t regAddr) {
+    return regAddr < 128 && (s->valid[regAddr >> 5] & (1UL << (regAddr & 31)));
+}
+#endif  // I2CDEV_SHADOW_DEVICES
+
+// Record bytes written to or read from a device.
+static void shadowWrite(const void *bus, uint8_t devAddr, uint8_t regAddr, uint8_t length, const uint8_t *data) {
+#if I2CDEV_SHADOW_DEVICES
+    I2cdevShadow *s = shadowFind(bus, devAddr);
+    if (!s) return;
+    for (uint8_t i = 0; i < length && regAddr + i < 128; i++) {
+        uint8_t r = regAddr + i;
+        uint32_t bit = 1UL << (r & 31);
+        if (!(s->volatileMask[r >> 5] & bit)) {
+            s->reg[r] = data[i];
+            s->valid[r >> 5] |= bit;
+        }
+    }
+#else  // I2CDEV_SHADOW_DEVICES
+    (void)bus;
+    (void)devAddr;
+    (void)regAddr;
+    (void)length;
+    (void)data;
+#endif  // I2CDEV_SHADOW_DEVICES
+}
+
+// Record big-endian words written to a device.
+static void shadowWriteWords(const void *bus, uint8_t devAddr, uint8_t regAddr, uint8_t length, const uint16_t *data) {
+    for (uint8_t i = 0; i < length; i++) {
+        uint8_t b[2] = {(uint8_t)(data[i] >> 8), (uint8_t)data[i]};
+        shadowWrite(bus, devAddr, regAddr + 2*i, 2, b);
+    }
+}
+
+// Read registers for a read-modify-write from the shadow cache if possible.
+int8_t I2Cdev::shadowRead(uint8_t devAddr, uint8_t regAddr, uint8_t length, uint8_t *data) {
+#if I2CDEV_SHADOW_DEVICES
+    I2cdevShadow *s = shadowFind(I2CDEV_KEY, devAddr);
+    if (s) {
+        uint8_t i;
+        for (i = 0; i < length && shadowCached(s, regAddr + i); i++) {}
+        if (i == length) {
+            memcpy(data, &s->reg[regAddr], length);
+            shadowHits++;
+            return length;
+        }
+        shadowMisses++;
+    }
+#endif  // I2CDEV_SHADOW_DEVICES
+    int8_t count = readBytes(devAddr, regAddr, length, data);
+    if (count == length) {
+        shadowWrite(I2CDEV_KEY, devAddr, regAddr, length, data);
+    }
+    return count;
+}
+
+/** Enable the register shadow cache for a device.
+ * writeBit(), writeBits(), writeBitW() and writeBitsW() then read the
+ * register from the cache instead of the bus once it has been read or
+ * written.  Registers the device changes on its own, status, data and
+ * self-clearing bits, must be excluded with volatileMask.
+ * @param devAddr I2C slave device address
+ * @param volatileMask 128 bit mask, bit (r & 31) of word (r >> 5) set to
+ * never cache register r (0 to cache all registers)
+ * @return Status of operation (false if I2CDEV_SHADOW_DEVICES are in use)
+ */
+bool I2Cdev::shadowEnable(uint8_t devAddr, const uint32_t *volatileMask) {
+#if I2CDEV_SHADOW_DEVICES
+    I2cdevShadow *s = shadowFind(I2CDEV_KEY, devAddr);
+    for (uint8_t i = 0; !s && i < I2CDEV_SHADOW_DEVICES; i++) {
+        if (shadow[i].devAddr == 0) s = &shadow[i];
+    }
+    if (!s || devAddr == 0) return false;
+    s->bus = I2CDEV_KEY;
+    s->devAddr = devAddr;
+    for (uint8_t i = 0; i < 4; i++) {
+        s->valid[i] = 0;
+        s->volatileMask[i] = volatileMask ? volatileMask[i] : 0;
+    }
+    return true;
+#else  // I2CDEV_SHADOW_DEVICES
+    (void)devAddr;
+    (void)volatileMask;
+    return false;
+#endif  // I2CDEV_SHADOW_DEVICES
+}
+
+/** Disable the register shadow cache for a device.
+ * @param devAddr I2C slave device address
+ */
+void I2Cdev::shadowDisable(uint8_t devAddr) {
+#if I2CDEV_SHADOW_DEVICES
+    I2cdevShadow *s = shadowFind(I2CDEV_KEY, devAddr);
+    if (s) s->devAddr = 0;
+#else  // I2CDEV_SHADOW_DEVICES
+    (void)devAddr;
+#endif  // I2CDEV_SHADOW_DEVICES
+}
+
+/** Discard all cached registers of a device, for example after a reset.
+ * @param devAddr I2C slave device address
+ */
+void I2Cdev::shadowInvalidate(uint8_t devAddr) {
+#if I2CDEV_SHADOW_DEVICES
+    I2cdevShadow *s = shadowFind(I2CDEV_KEY, devAddr);
+    if (s) {
+        for (uint8_t i = 0; i < 4; i++) s->valid[i] = 0;
+    }
+#else  // I2CDEV_SHADOW_DEVICES
+    (void)devAddr;
+#endif  // I2CDEV_SHADOW_DEVICES
 }
 
 /** Read a single bit from an 8-bit device register.
@@ -324,7 +499,8 @@ int8_t I2Cdev::readBytes(uint8_t devAddr, uint8_t regAddr, uint8_t length, uint8
             count = -1; // error
         }
     #elif (I2CDEV_IMPLEMENTATION == I2CDEV_PARTICLE_I2CMASTER)
-        if (I2C.write(devAddr, &regAddr, 1, true) && I2C.read(devAddr, data, length)) {
+        // Repeated start between register address and data.
+        if (Backend::writeRead(*getBus(), devAddr, regAddr, data, length)) {
           count = length;
         } else {
           count = -1;
@@ -513,12 +689,9 @@ int8_t I2Cdev::readWords(uint8_t devAddr, uint8_t regAddr, uint8_t length, uint1
             count = -1; // error
         }
     #elif (I2CDEV_IMPLEMENTATION == I2CDEV_PARTICLE_I2CMASTER)
-        if (I2C.write(devAddr, &regAddr, 1, true) && I2C.write(data, 2*length, true)) {
-          // STM32 so this is a byte swap.
-          uint8_t* u8 = (uint8_t*)data;
-          for (uint8_t i = 0; i < length; i++) {
-            data[i] = (u8[2*i] << 8) | u8[2*i + 1];
-          }
+        // Read straight into data then swap in place.
+        if (Backend::writeRead(*getBus(), devAddr, regAddr, data, 2*length)) {
+          swapWords(data, data, length);
           count = length;
         } else {
           count = -1;
@@ -546,7 +719,7 @@ int8_t I2Cdev::readWords(uint8_t devAddr, uint8_t regAddr, uint8_t length, uint1
  */
 bool I2Cdev::writeBit(uint8_t devAddr, uint8_t regAddr, uint8_t bitNum, uint8_t data) {
     uint8_t b;
-    readByte(devAddr, regAddr, &b);
+    shadowRead(devAddr, regAddr, 1, &b);
     b = (data != 0) ? (b | (1 << bitNum)) : (b & ~(1 << bitNum));
     return writeByte(devAddr, regAddr, b);
 }
@@ -559,8 +732,9 @@ bool I2Cdev::writeBit(uint8_t devAddr, uint8_t regAddr, uint8_t bitNum, uint8_t
  * @return Status of operation (true = success)
  */
 bool I2Cdev::writeBitW(uint8_t devAddr, uint8_t regAddr, uint8_t bitNum, uint16_t data) {
-    uint16_t w;
-    readWord(devAddr, regAddr, &w);
+    uint8_t b[2];
+    shadowRead(devAddr, regAddr, 2, b);
+    uint16_t w = (b[0] << 8) | b[1];
     w = (data != 0) ? (w | (1 << bitNum)) : (w & ~(1 << bitNum));
     return writeWord(devAddr, regAddr, w);
 }
@@ -582,7 +756,7 @@ bool I2Cdev::writeBits(uint8_t devAddr, uint8_t regAddr, uint8_t bitStart, uint8
     // 10100011 original & ~mask
     // 10101011 masked | value
     uint8_t b;
-    if (readByte(devAddr, regAddr, &b) != 0) {
+    if (shadowRead(devAddr, regAddr, 1, &b) != 0) {
         uint8_t mask = ((1 << length) - 1) << (bitStart - length + 1);
         data <<= (bitStart - length + 1); // shift data into correct position
         data &= mask; // zero all non-important bits in data
@@ -610,8 +784,9 @@ bool I2Cdev::writeBitsW(uint8_t devAddr, uint8_t regAddr, uint8_t bitStart, uint
     // 1010111110010110 original value (sample)
     // 1010001110010110 original & ~mask
     // 1010101110010110 masked | value
-    uint16_t w;
-    if (readWord(devAddr, regAddr, &w) != 0) {
+    uint8_t b[2];
+    if (shadowRead(devAddr, regAddr, 2, b) == 2) {
+        uint16_t w = (b[0] << 8) | b[1];
         uint16_t mask = ((1 << length) - 1) << (bitStart - length + 1);
         data <<= (bitStart - length + 1); // shift data into correct position
         data &= mask; // zero all non-important bits in data
@@ -661,7 +836,12 @@ bool I2Cdev::writeBytes(uint8_t devAddr, uint8_t regAddr, uint8_t length, uint8_
         Serial.print("...");
     #endif
 #if (I2CDEV_IMPLEMENTATION == I2CDEV_PARTICLE_I2CMASTER)
-        return I2C.write(devAddr, &regAddr, 1, false) && I2C.write(data, length, true);
+        // Register address and data in one transfer without a copy.
+        if (!Backend::write(*getBus(), devAddr, regAddr, data, length)) {
+            return false;
+        }
+        shadowWrite(I2CDEV_KEY, devAddr, regAddr, length, data);
+        return true;
 #else  //  I2CDEV_PARTICLE_I2CMASTER
     uint8_t status = 0;
 	#if defined (SPARK)
@@ -705,6 +885,7 @@ bool I2Cdev::writeBytes(uint8_t devAddr, uint8_t regAddr, uint8_t length, uint8_
     #ifdef I2CDEV_SERIAL_DEBUG
         Serial.println(". Done.");
     #endif
+    if (status == 0) shadowWrite(I2CDEV_KEY, devAddr, regAddr, length, data);
     return status == 0;
 #endif  // I2CDEV_PARTICLE_I2CMASTER    
 }
@@ -713,7 +894,8 @@ bool I2Cdev::writeBytes(uint8_t devAddr, uint8_t regAddr, uint8_t length, uint8_
  * @param devAddr I2C slave device address
  * @param regAddr First register address to write to
  * @param length Number of words to write
- * @param data Buffer to copy new data from
+ * @param data Buffer to copy new data from, byte swapped in place during
+ *             the transfer and restored before return
  * @return Status of operation (true = success)
  */
 bool I2Cdev::writeWords(uint8_t devAddr, uint8_t regAddr, uint8_t length, uint16_t* data) {
@@ -727,18 +909,14 @@ bool I2Cdev::writeWords(uint8_t devAddr, uint8_t regAddr, uint8_t length, uint16
         Serial.print("...");
     #endif
 #if (I2CDEV_IMPLEMENTATION == I2CDEV_PARTICLE_I2CMASTER)
-      if (!I2C.write(devAddr, &regAddr, 1, false)) {
-        return false;
-      }
-      // Need loop to swap bytes for STM32.
-      for (uint8_t i = 0; i < length; i++) {
-        if (!I2C.write(data[i] << 8, false) || !I2C.write(data[i] >> 8, false)) {
-          I2C.stop();
-          return false;
-        }
-      }
-      I2C.stop();
-      return true;
+      // Swap to MSB first in place so the register byte and all data go
+      // in one transaction, then restore the caller's words.  Registers
+      // that do not auto increment, like FIFO_R_W, see one burst.
+      swapWords(data, data, length);
+      bool ok = Backend::write(*getBus(), devAddr, regAddr, data, 2*length);
+      swapWords(data, data, length);
+      if (ok) shadowWriteWords(I2CDEV_KEY, devAddr, regAddr, length, data);
+      return ok;
 #else  //  I2CDEV_PARTICLE_I2CMASTER
     uint8_t status = 0;
 	#if defined (SPARK)
@@ -787,15 +965,100 @@ bool I2Cdev::writeWords(uint8_t devAddr, uint8_t regAddr, uint8_t length, uint16
     #ifdef I2CDEV_SERIAL_DEBUG
         Serial.println(". Done.");
     #endif
+    if (status == 0) shadowWriteWords(I2CDEV_KEY, devAddr, regAddr, length, data);
     return status == 0;
 #endif //  I2CDEV_PARTICLE_I2CMASTER    
 }
 
+/** Create an empty write batch for a device.
+ * @param dev I2Cdev object for the bus the device is on
+ * @param devAddr I2C slave device address
+ */
+I2cWriteBatch::I2cWriteBatch(I2Cdev &dev, uint8_t devAddr) {
+    this->dev = &dev;
+    this->devAddr = devAddr;
+    count = 0;
+}
+
+/** Add a register write to the batch.
+ * A second write to the same register replaces the first.  Writes are
+ * sent in register order, not in the order they were added, so use
+ * separate batches when the device requires a particular order.
+ * @param regAddr Register address to write to
+ * @param data New byte value to write
+ * @return Status of operation (false if the batch is full)
+ */
+bool I2cWriteBatch::set(uint8_t regAddr, uint8_t data) {
+    uint8_t i = 0;
+    while (i < count && reg[i] < regAddr) i++;
+    if (i < count && reg[i] == regAddr) {
+        value[i] = data;
+        return true;
+    }
+    if (count == I2CDEV_BATCH_SIZE) return false;
+    for (uint8_t j = count; j > i; j--) {
+        reg[j] = reg[j - 1];
+        value[j] = value[j - 1];
+    }
+    reg[i] = regAddr;
+    value[i] = data;
+    count++;
+    return true;
+}
+
+/** Send the batch.
+ * Writes to adjacent registers are merged into one auto-increment burst.
+ * With I2CDEV_PARTICLE_I2CMASTER all bursts are sent in a single transfer with a repeated
+ * start between bursts.  The batch is empty after a successful commit.
+ * @return Status of operation (true = success)
+ */
+bool I2cWriteBatch::commit() {
+    uint8_t start, n;
+#if (I2CDEV_IMPLEMENTATION == I2CDEV_PARTICLE_I2CMASTER)
+    i2c_segment seg[2*I2CDEV_BATCH_SIZE];
+    size_t nseg = 0;
+    for (start = 0; start < count; start += n) {
+        for (n = 1; start + n < count && reg[start + n] == reg[start] + n; n++) {}
+        seg[nseg].addr = devAddr;
+        seg[nseg].flags = 0;
+        seg[nseg].buf = &reg[start];
+        seg[nseg++].len = 1;
+        seg[nseg].addr = devAddr;
+        seg[nseg].flags = I2C_SEG_NOSTART;
+        seg[nseg].buf = &value[start];
+        seg[nseg++].len = n;
+    }
+    if (nseg) {
+        if (!Backend::scatter(*dev->getBus(), seg, nseg)) return false;
+        for (start = 0; start < count; start += n) {
+            for (n = 1; start + n < count && reg[start + n] == reg[start] + n; n++) {}
+            shadowWrite(dev->getBus(), devAddr, reg[start], n, &value[start]);
+        }
+    }
+#else  // I2CDEV_PARTICLE_I2CMASTER
+    for (start = 0; start < count; start += n) {
+        for (n = 1; start + n < count && reg[start + n] == reg[start] + n; n++) {}
+        if (!dev->writeBytes(devAddr, reg[start], n, &value[start])) return false;
+    }
+#endif  // I2CDEV_PARTICLE_I2CMASTER
+    count = 0;
+    return true;
+}
+
 /** Default timeout value for read operations.
  * Set this to 0 to disable timeout detection.
  */
 uint16_t I2Cdev::readTimeout = I2CDEV_DEFAULT_READ_TIMEOUT;
 
+/** Number of read-modify-write register reads served by the shadow cache.
+ */
+uint32_t I2Cdev::shadowHits = 0;
+
+/** Number of read-modify-write register reads of enabled devices that
+ * went to the bus.
+ */
+uint32_t I2Cdev::shadowMisses = 0;
+
 #if I2CDEV_IMPLEMENTATION == I2CDEV_BUILTIN_FASTWIRE
     // I2C library
     //////////////////////
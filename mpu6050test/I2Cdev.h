@@ -72,11 +72,45 @@ THE SOFTWARE.
 // -----------------------------------------------------------------------------
 //#define I2CDEV_SERIAL_DEBUG
 
+// -----------------------------------------------------------------------------
+// Register shadow cache for read-modify-write bit operations.  Number of
+// devices that may call I2Cdev::shadowEnable(), zero removes the cache.
+// -----------------------------------------------------------------------------
+#ifndef I2CDEV_SHADOW_DEVICES
+#define I2CDEV_SHADOW_DEVICES 1
+#endif
+
+// -----------------------------------------------------------------------------
+// Bus class for I2CDEV_PARTICLE_I2CMASTER, I2cMaster or WireMaster.  Calls
+// go through I2cdevBackend<I2CDEV_BUS>, see I2cdevBackend.h.
+// -----------------------------------------------------------------------------
+#ifndef I2CDEV_BUS
+#define I2CDEV_BUS I2cMaster
+#endif
+
+// -----------------------------------------------------------------------------
+// Bus binding.  Nonzero makes the I2Cdev methods static on the global I2C
+// object, zero gives each I2Cdev instance its own I2CDEV_BUS object.
+// -----------------------------------------------------------------------------
+#ifndef I2CDEV_SINGLE_BUS
+#define I2CDEV_SINGLE_BUS 0
+#endif
+#if I2CDEV_IMPLEMENTATION != I2CDEV_PARTICLE_I2CMASTER
+    // Other implementations use a global Wire or Fastwire object
+    #undef I2CDEV_SINGLE_BUS
+    #define I2CDEV_SINGLE_BUS 1
+#endif
+#if I2CDEV_SINGLE_BUS
+    #define I2CDEV_METHOD static
+#else
+    #define I2CDEV_METHOD
+#endif
+
 #if defined (SPARK)
 	#include "application.h"
 #if I2CDEV_IMPLEMENTATION == I2CDEV_PARTICLE_I2CMASTER
-  #include "I2cMaster/I2cMaster.h"
-  extern I2cMaster I2C;
+  #include "I2cdevBackend.h"
+  extern I2CDEV_BUS I2C;
 #endif
 #endif
 
@@ -101,26 +135,67 @@ THE SOFTWARE.
 class I2Cdev {
     public:
         I2Cdev();
+#if !I2CDEV_SINGLE_BUS
+        I2Cdev(I2CDEV_BUS &bus);
+        I2CDEV_BUS *getBus() { return bus; }
+#elif I2CDEV_IMPLEMENTATION == I2CDEV_PARTICLE_I2CMASTER
+        static I2CDEV_BUS *getBus() { return &I2C; }
+#endif
         
-        static int8_t readBit(uint8_t devAddr, uint8_t regAddr, uint8_t bitNum, uint8_t *data, uint16_t timeout=I2Cdev::readTimeout);
-        static int8_t readBitW(uint8_t devAddr, uint8_t regAddr, uint8_t bitNum, uint16_t *data, uint16_t timeout=I2Cdev::readTimeout);
-        static int8_t readBits(uint8_t devAddr, uint8_t regAddr, uint8_t bitStart, uint8_t length, uint8_t *data, uint16_t timeout=I2Cdev::readTimeout);
-        static int8_t readBitsW(uint8_t devAddr, uint8_t regAddr, uint8_t bitStart, uint8_t length, uint16_t *data, uint16_t timeout=I2Cdev::readTimeout);
-        static int8_t readByte(uint8_t devAddr, uint8_t regAddr, uint8_t *data, uint16_t timeout=I2Cdev::readTimeout);
-        static int8_t readWord(uint8_t devAddr, uint8_t regAddr, uint16_t *data, uint16_t timeout=I2Cdev::readTimeout);
-        static int8_t readBytes(uint8_t devAddr, uint8_t regAddr, uint8_t length, uint8_t *data, uint16_t timeout=I2Cdev::readTimeout);
-        static int8_t readWords(uint8_t devAddr, uint8_t regAddr, uint8_t length, uint16_t *data, uint16_t timeout=I2Cdev::readTimeout);
-
-        static bool writeBit(uint8_t devAddr, uint8_t regAddr, uint8_t bitNum, uint8_t data);
-        static bool writeBitW(uint8_t devAddr, uint8_t regAddr, uint8_t bitNum, uint16_t data);
-        static bool writeBits(uint8_t devAddr, uint8_t regAddr, uint8_t bitStart, uint8_t length, uint8_t data);
-        static bool writeBitsW(uint8_t devAddr, uint8_t regAddr, uint8_t bitStart, uint8_t length, uint16_t data);
-        static bool writeByte(uint8_t devAddr, uint8_t regAddr, uint8_t data);
-        static bool writeWord(uint8_t devAddr, uint8_t regAddr, uint16_t data);
-        static bool writeBytes(uint8_t devAddr, uint8_t regAddr, uint8_t length, uint8_t *data);
-        static bool writeWords(uint8_t devAddr, uint8_t regAddr, uint8_t length, uint16_t *data);
+        I2CDEV_METHOD int8_t readBit(uint8_t devAddr, uint8_t regAddr, uint8_t bitNum, uint8_t *data, uint16_t timeout=I2Cdev::readTimeout);
+        I2CDEV_METHOD int8_t readBitW(uint8_t devAddr, uint8_t regAddr, uint8_t bitNum, uint16_t *data, uint16_t timeout=I2Cdev::readTimeout);
+        I2CDEV_METHOD int8_t readBits(uint8_t devAddr, uint8_t regAddr, uint8_t bitStart, uint8_t length, uint8_t *data, uint16_t timeout=I2Cdev::readTimeout);
+        I2CDEV_METHOD int8_t readBitsW(uint8_t devAddr, uint8_t regAddr, uint8_t bitStart, uint8_t length, uint16_t *data, uint16_t timeout=I2Cdev::readTimeout);
+        I2CDEV_METHOD int8_t readByte(uint8_t devAddr, uint8_t regAddr, uint8_t *data, uint16_t timeout=I2Cdev::readTimeout);
+        I2CDEV_METHOD int8_t readWord(uint8_t devAddr, uint8_t regAddr, uint16_t *data, uint16_t timeout=I2Cdev::readTimeout);
+        I2CDEV_METHOD int8_t readBytes(uint8_t devAddr, uint8_t regAddr, uint8_t length, uint8_t *data, uint16_t timeout=I2Cdev::readTimeout);
+        I2CDEV_METHOD int8_t readWords(uint8_t devAddr, uint8_t regAddr, uint8_t length, uint16_t *data, uint16_t timeout=I2Cdev::readTimeout);
+
+        I2CDEV_METHOD bool writeBit(uint8_t devAddr, uint8_t regAddr, uint8_t bitNum, uint8_t data);
+        I2CDEV_METHOD bool writeBitW(uint8_t devAddr, uint8_t regAddr, uint8_t bitNum, uint16_t data);
+        I2CDEV_METHOD bool writeBits(uint8_t devAddr, uint8_t regAddr, uint8_t bitStart, uint8_t length, uint8_t data);
+        I2CDEV_METHOD bool writeBitsW(uint8_t devAddr, uint8_t regAddr, uint8_t bitStart, uint8_t length, uint16_t data);
+        I2CDEV_METHOD bool writeByte(uint8_t devAddr, uint8_t regAddr, uint8_t data);
+        I2CDEV_METHOD bool writeWord(uint8_t devAddr, uint8_t regAddr, uint16_t data);
+        I2CDEV_METHOD bool writeBytes(uint8_t devAddr, uint8_t regAddr, uint8_t length, uint8_t *data);
+        I2CDEV_METHOD bool writeWords(uint8_t devAddr, uint8_t regAddr, uint8_t length, uint16_t *data);
+
+        I2CDEV_METHOD bool shadowEnable(uint8_t devAddr, const uint32_t *volatileMask=0);
+        I2CDEV_METHOD void shadowDisable(uint8_t devAddr);
+        I2CDEV_METHOD void shadowInvalidate(uint8_t devAddr);
 
         static uint16_t readTimeout;
+        static uint32_t shadowHits;
+        static uint32_t shadowMisses;
+
+    private:
+        I2CDEV_METHOD int8_t shadowRead(uint8_t devAddr, uint8_t regAddr, uint8_t length, uint8_t *data);
+#if !I2CDEV_SINGLE_BUS
+        I2CDEV_BUS *bus;
+#endif
+};
+
+// -----------------------------------------------------------------------------
+// Maximum number of registers in one I2cWriteBatch
+// -----------------------------------------------------------------------------
+#ifndef I2CDEV_BATCH_SIZE
+#define I2CDEV_BATCH_SIZE 16
+#endif
+
+class I2cWriteBatch {
+    public:
+        I2cWriteBatch(I2Cdev &dev, uint8_t devAddr);
+
+        bool set(uint8_t regAddr, uint8_t data);
+        bool commit();
+        uint8_t size() { return count; }
+
+    private:
+        I2Cdev *dev;
+        uint8_t devAddr;
+        uint8_t count;
+        uint8_t reg[I2CDEV_BATCH_SIZE];     // sorted register addresses
+        uint8_t value[I2CDEV_BATCH_SIZE];
 };
 
 #if I2CDEV_IMPLEMENTATION == I2CDEV_BUILTIN_FASTWIRE
@@ -0,0 +1,64 @@
+// I2Cdev bus backends for the I2CDEV_PARTICLE_I2CMASTER implementation.
+//
+// I2cdevBackend<Bus> supplies the bulk operations I2Cdev needs for one bus
+// class.  The bus class is selected at compile time with I2CDEV_BUS so each
+// call inlines to the best transfer the bus offers.  Every register access
+// in the I2CDEV_PARTICLE_I2CMASTER paths of I2Cdev.cpp goes through one of
+// these.  All operations return true for success.
+//
+//   write(bus, devAddr, regAddr, data, length)     register address and data
+//                                                  in one write, no copy
+//   writeRead(bus, devAddr, regAddr, data, length) register address write,
+//                                                  repeated start, read
+//   scatter(bus, seg, count)                       segment list, see
+//                                                  i2c_transfer()
+
+#ifndef _I2CDEV_BACKEND_H_
+#define _I2CDEV_BACKEND_H_
+
+#include "I2cMaster/I2cMaster.h"
+
+template<class Bus> struct I2cdevBackend;
+
+// I2cMaster, polled transfers with no buffering.
+template<> struct I2cdevBackend<I2cMaster> {
+    static bool write(I2cMaster &bus, uint8_t devAddr, uint8_t regAddr, const void *data, size_t length) {
+        i2c_segment seg[2] = {{devAddr, 0, &regAddr, 1},
+                              {devAddr, I2C_SEG_NOSTART, (void*)data, length}};
+        return bus.transfer(seg, 2);
+    }
+    static bool writeRead(I2cMaster &bus, uint8_t devAddr, uint8_t regAddr, void *data, size_t length) {
+        return bus.transfer(devAddr, &regAddr, 1, data, length);
+    }
+    static bool scatter(I2cMaster &bus, const i2c_segment *seg, size_t count) {
+        return bus.transfer(seg, count);
+    }
+};
+
+// WireMaster, bypasses the Wire buffers so there is no 32 byte chunking.
+struct I2cdevWireBackend {
+    static bool write(WireMasterBase &bus, uint8_t devAddr, uint8_t regAddr, const void *data, size_t length) {
+        bus.beginTransmission(devAddr);
+        bus.write(regAddr);
+        return bus.endTransmission(data, length) == 0;
+    }
+    static bool writeRead(WireMasterBase &bus, uint8_t devAddr, uint8_t regAddr, void *data, size_t length) {
+        i2c_segment seg[2] = {{devAddr, 0, &regAddr, 1},
+                              {devAddr, I2C_SEG_READ, data, length}};
+        return bus.transfer(seg, 2) == 0;
+    }
+    static bool scatter(WireMasterBase &bus, const i2c_segment *seg, size_t count) {
+        return bus.transfer(seg, count) == 0;
+    }
+};
+template<> struct I2cdevBackend<WireMasterBase> : I2cdevWireBackend {};
+template<size_t N> struct I2cdevBackend<WireMasterT<N> > : I2cdevWireBackend {};
+template<> struct I2cdevBackend<WireMaster> : I2cdevWireBackend {};
+
+// Other bus classes.  Define I2CDEV_BACKEND_HEADER as a header that declares
+// the class and its I2cdevBackend specialisation, see host/MockBus.h.
+#ifdef I2CDEV_BACKEND_HEADER
+#include I2CDEV_BACKEND_HEADER
+#endif
+
+#endif /* _I2CDEV_BACKEND_H_ */
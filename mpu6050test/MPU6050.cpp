@@ -53,6 +53,17 @@ MPU6050::MPU6050(uint8_t address) {
     devAddr = address;
 }
 
+#if !I2CDEV_SINGLE_BUS
+/** Bus and address specific constructor.
+ * @param bus I2CDEV_BUS object for the bus the device is on
+ * @param address I2C address
+ * @see MPU6050_DEFAULT_ADDRESS
+ */
+MPU6050::MPU6050(I2CDEV_BUS &bus, uint8_t address) : I2Cdev(bus) {
+    devAddr = address;
+}
+#endif
+
 /** Power on and prepare for general usage.
  * This will activate the device and take it out of sleep mode (which must be done
  * after start-up). This function also sets both the accelerometer and the gyroscope
@@ -67,6 +78,29 @@ void MPU6050::initialize() {
     setSleepEnabled(false); // thanks to Jack Elston for pointing this one out!
 }
 
+/** Registers excluded from the I2Cdev shadow cache: I2C_SLV4_CTRL through
+ * I2C_MST_STATUS, INT_STATUS through MOT_DETECT_STATUS, SIGNAL_PATH_RESET,
+ * USER_CTRL, the DMP memory registers and the FIFO registers.
+ */
+static const uint32_t MPU6050_SHADOW_VOLATILE[4] = {
+    0x00000000, 0xFC700000, 0xFFFFFFFF, 0x001CE503
+};
+
+/** Enable or disable the I2Cdev register shadow cache for this device.
+ * With the cache enabled bit updates to configuration registers cost one
+ * bus write instead of a read and a write.
+ * @param enabled New cache enabled status
+ * @return Status of operation (true = success)
+ * @see I2Cdev::shadowEnable()
+ */
+bool MPU6050::setShadowCacheEnabled(bool enabled) {
+    if (!enabled) {
+        I2Cdev::shadowDisable(devAddr);
+        return true;
+    }
+    return I2Cdev::shadowEnable(devAddr, MPU6050_SHADOW_VOLATILE);
+}
+
 /** Verify the I2C connection.
  * Make sure the device is connected and responds as expected.
  * @return True if connection is valid, false otherwise
@@ -2366,6 +2400,7 @@ void MPU6050::resetSensors() {
  */
 void MPU6050::reset() {
     I2Cdev::writeBit(devAddr, MPU6050_RA_PWR_MGMT_1, MPU6050_PWR1_DEVICE_RESET_BIT, true);
+    I2Cdev::shadowInvalidate(devAddr);
 }
 /** Get sleep mode status.
  * Setting the SLEEP bit in the register puts the device into very low power
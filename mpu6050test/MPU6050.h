@@ -410,13 +410,17 @@ THE SOFTWARE.
 
 // note: DMP code memory blocks defined at end of header file
 
-class MPU6050 {
+class MPU6050 : public I2Cdev {
     public:
         MPU6050();
         MPU6050(uint8_t address);
+#if !I2CDEV_SINGLE_BUS
+        MPU6050(I2CDEV_BUS &bus, uint8_t address=MPU6050_DEFAULT_ADDRESS);
+#endif
 
         void initialize();
         bool testConnection();
+        bool setShadowCacheEnabled(bool enabled);
 
         // AUX_VDDIO register
         uint8_t getAuxVDDIOLevel();
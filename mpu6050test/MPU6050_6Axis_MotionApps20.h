@@ -456,17 +456,17 @@ uint8_t MPU6050::dmpInitialize() {
             DEBUG_PRINTLN(fifoCount);
             getFIFOBytes(fifoBuffer, fifoCount);
 
+            // MOT_THR through ZRMOT_DUR are adjacent so one burst writes all four
             DEBUG_PRINTLN(F("Setting motion detection threshold to 2..."));
-            setMotionDetectionThreshold(2);
-
             DEBUG_PRINTLN(F("Setting zero-motion detection threshold to 156..."));
-            setZeroMotionDetectionThreshold(156);
-
             DEBUG_PRINTLN(F("Setting motion detection duration to 80..."));
-            setMotionDetectionDuration(80);
-
             DEBUG_PRINTLN(F("Setting zero-motion detection duration to 0..."));
-            setZeroMotionDetectionDuration(0);
+            I2cWriteBatch motion(*this, devAddr);
+            motion.set(MPU6050_RA_MOT_THR, 2);
+            motion.set(MPU6050_RA_ZRMOT_THR, 156);
+            motion.set(MPU6050_RA_MOT_DUR, 80);
+            motion.set(MPU6050_RA_ZRMOT_DUR, 0);
+            motion.commit();
 
             DEBUG_PRINTLN(F("Resetting FIFO..."));
             resetFIFO();
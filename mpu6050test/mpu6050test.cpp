@@ -5,15 +5,50 @@
 // This #include statement was automatically added by the Spark IDE.
 #include "MPU6050.h"
 #if I2CDEV_IMPLEMENTATION == I2CDEV_PARTICLE_I2CMASTER
-I2cMaster I2C;
+I2CDEV_BUS I2C;
 #endif
 int ledPin = D7;
 
 // MPU variables:
+#if I2CDEV_SINGLE_BUS
 MPU6050 accelgyro;
+#else
+MPU6050 accelgyro(I2C);
+#endif
 int16_t ax, ay, az;
 int16_t gx, gy, gz;
 
+// Set to one to time word transfers in setup().  The benchmark rewrites
+// the gyro offsets with the values read from the device.
+#define BENCH_WORDS 0
+
+#if BENCH_WORDS
+// Time word reads of 1 to 32 words and rewrites of the gyro offsets.
+// Reads stop below the FIFO registers so no FIFO data is consumed.
+void benchWords() {
+    uint16_t words[32];
+    const uint16_t NUM_CALLS = 100;
+    for (uint8_t n = 1; n <= 32; n *= 2) {
+        uint32_t t = micros();
+        for (uint16_t i = 0; i < NUM_CALLS; i++) {
+            accelgyro.readWords(MPU6050_DEFAULT_ADDRESS, 0, n, words);
+        }
+        t = micros() - t;
+        Serial.print("readWords "); Serial.print(n);
+        Serial.print(": "); Serial.print(t/NUM_CALLS); Serial.println(" usec");
+    }
+    for (uint8_t n = 1; n <= 3; n++) {
+        accelgyro.readWords(MPU6050_DEFAULT_ADDRESS, MPU6050_RA_XG_OFFS_USRH, n, words);
+        uint32_t t = micros();
+        for (uint16_t i = 0; i < NUM_CALLS; i++) {
+            accelgyro.writeWords(MPU6050_DEFAULT_ADDRESS, MPU6050_RA_XG_OFFS_USRH, n, words);
+        }
+        t = micros() - t;
+        Serial.print("writeWords "); Serial.print(n);
+        Serial.print(": "); Serial.print(t/NUM_CALLS); Serial.println(" usec");
+    }
+}
+#endif  // BENCH_WORDS
 
 bool ledState = false;
 void toggleLed() {
@@ -39,11 +74,19 @@ void setup() {
     while(!Serial.available()) Particle.process();
 
     Serial.println("Initializing I2C devices...");
+    accelgyro.setShadowCacheEnabled(true);
     accelgyro.initialize();
+    Serial.print("Shadow cache hits: ");
+    Serial.print(I2Cdev::shadowHits);
+    Serial.print(", misses: ");
+    Serial.println(I2Cdev::shadowMisses);
 
     // Cerify the connection:
     Serial.println("Testing device connections...");
     Serial.println(accelgyro.testConnection() ? "MPU6050 connection successful" : "MPU6050 connection failed");
+#if BENCH_WORDS
+    benchWords();
+#endif  // BENCH_WORDS
     
 }
 